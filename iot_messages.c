@@ -0,0 +1,214 @@
+/* Generated by tools/jsongen from iot_messages.schema. Do not edit. */
+
+#include <string.h>
+#include "iot_messages.h"
+
+static int iot_command_packet_decoder_fail(iot_command_packet_decoder_t *o, int status)
+{
+    o->status = status;
+    o->inObject = false;
+    return status;
+}
+
+static int iot_command_packet_decoder_service(JParserIntf *super, JParserVal *v, int recLevel)
+{
+    iot_command_packet_decoder_t *o = (iot_command_packet_decoder_t *)super;
+    iot_command_packet_t *d = o->dest;
+    const char *name = v->memberName;
+    U32 bit;
+    (void)recLevel;
+    if (!o->inObject)
+    {
+        if (v->t != JParserT_BeginObject)
+            goto formatErr;
+        o->inObject = true;
+        o->received = 0;
+        o->status = JDecoderS_OK;
+        return 0;
+    }
+    if (v->t == JParserT_EndObject)
+    {
+        if (o->received != 0x00000001UL)
+            return iot_command_packet_decoder_fail(o, JDecoderS_Overflow);
+        o->inObject = false;
+        return 0;
+    }
+    switch (name[0])
+    {
+    case 'l':
+        if (!strcmp(name, "led"))
+        {
+            if (v->t != JParserT_Boolean)
+                goto formatErr;
+            d->led = v->v.b ? true : false;
+            bit = 0x00000001UL;
+        }
+        else
+            goto nameNotFound;
+        break;
+    default:
+        goto nameNotFound;
+    }
+    if (o->received & bit) /* Duplicate member name */
+        goto nameNotFound;
+    o->received |= bit;
+    return 0;
+
+nameNotFound:
+    return iot_command_packet_decoder_fail(o, JDecoderS_NameNotFound);
+formatErr:
+    return iot_command_packet_decoder_fail(o, JDecoderS_FormatErr);
+}
+
+void iot_command_packet_decoder_constructor(iot_command_packet_decoder_t *o, iot_command_packet_t *dest)
+{
+    JParserIntf_constructor((JParserIntf *)o, iot_command_packet_decoder_service);
+    o->dest = dest;
+    o->received = 0;
+    o->status = JDecoderS_OK;
+    o->inObject = false;
+}
+
+int iot_command_packet_encode(BufPrint *out, const iot_command_packet_t *v)
+{
+    if (BufPrint_write(out, "{\"led\":", 7) < 0 ||
+        BufPrint_write(out, v->led ? "true" : "false", v->led ? 4 : 5) < 0 ||
+        BufPrint_putc(out, '}') < 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int iot_command_packet_set(JEncoder *e, const iot_command_packet_t *v)
+{
+    JEncoder_beginObject(e);
+    JEncoder_setName(e, "led");
+    JEncoder_setBoolean(e, v->led);
+    JEncoder_endObject(e);
+    return JErr_isError(JEncoder_getErr(e)) ? -1 : 0;
+}
+
+int iot_command_packet_template(JTemplate *t)
+{
+    JEncoder *e = JTemplate_getEncoder(t);
+    JEncoder_beginObject(e);
+    JEncoder_setName(e, "led");
+    JTemplate_slot(t, JParserT_Boolean, 0);
+    JEncoder_endObject(e);
+    return JTemplate_end(t);
+}
+
+int iot_command_packet_patch(JTemplate *t, const iot_command_packet_t *v)
+{
+    if (JTemplate_setBoolean(t, 0, v->led))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int iot_telemetry_decoder_fail(iot_telemetry_decoder_t *o, int status)
+{
+    o->status = status;
+    o->inObject = false;
+    return status;
+}
+
+static int iot_telemetry_decoder_service(JParserIntf *super, JParserVal *v, int recLevel)
+{
+    iot_telemetry_decoder_t *o = (iot_telemetry_decoder_t *)super;
+    iot_telemetry_t *d = o->dest;
+    const char *name = v->memberName;
+    U32 bit;
+    (void)recLevel;
+    if (!o->inObject)
+    {
+        if (v->t != JParserT_BeginObject)
+            goto formatErr;
+        o->inObject = true;
+        o->received = 0;
+        o->status = JDecoderS_OK;
+        return 0;
+    }
+    if (v->t == JParserT_EndObject)
+    {
+        if (o->received != 0x00000001UL)
+            return iot_telemetry_decoder_fail(o, JDecoderS_Overflow);
+        o->inObject = false;
+        return 0;
+    }
+    switch (name[0])
+    {
+    case 'l':
+        if (!strcmp(name, "led"))
+        {
+            if (v->t != JParserT_Boolean)
+                goto formatErr;
+            d->led = v->v.b ? true : false;
+            bit = 0x00000001UL;
+        }
+        else
+            goto nameNotFound;
+        break;
+    default:
+        goto nameNotFound;
+    }
+    if (o->received & bit) /* Duplicate member name */
+        goto nameNotFound;
+    o->received |= bit;
+    return 0;
+
+nameNotFound:
+    return iot_telemetry_decoder_fail(o, JDecoderS_NameNotFound);
+formatErr:
+    return iot_telemetry_decoder_fail(o, JDecoderS_FormatErr);
+}
+
+void iot_telemetry_decoder_constructor(iot_telemetry_decoder_t *o, iot_telemetry_t *dest)
+{
+    JParserIntf_constructor((JParserIntf *)o, iot_telemetry_decoder_service);
+    o->dest = dest;
+    o->received = 0;
+    o->status = JDecoderS_OK;
+    o->inObject = false;
+}
+
+int iot_telemetry_encode(BufPrint *out, const iot_telemetry_t *v)
+{
+    if (BufPrint_write(out, "{\"led\":", 7) < 0 ||
+        BufPrint_write(out, v->led ? "true" : "false", v->led ? 4 : 5) < 0 ||
+        BufPrint_putc(out, '}') < 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int iot_telemetry_set(JEncoder *e, const iot_telemetry_t *v)
+{
+    JEncoder_beginObject(e);
+    JEncoder_setName(e, "led");
+    JEncoder_setBoolean(e, v->led);
+    JEncoder_endObject(e);
+    return JErr_isError(JEncoder_getErr(e)) ? -1 : 0;
+}
+
+int iot_telemetry_template(JTemplate *t)
+{
+    JEncoder *e = JTemplate_getEncoder(t);
+    JEncoder_beginObject(e);
+    JEncoder_setName(e, "led");
+    JTemplate_slot(t, JParserT_Boolean, 0);
+    JEncoder_endObject(e);
+    return JTemplate_end(t);
+}
+
+int iot_telemetry_patch(JTemplate *t, const iot_telemetry_t *v)
+{
+    if (JTemplate_setBoolean(t, 0, v->led))
+    {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+/* Generated by tools/jsongen from iot_messages.schema. Do not edit. */
+
+#ifndef _IOT_MESSAGES_H
+#define _IOT_MESSAGES_H
+
+#include <stdbool.h>
+#include "lib/json/JDecoder.h"
+#include "lib/json/JTemplate.h"
+
+typedef struct iot_command_packet
+{
+    bool led;
+} iot_command_packet_t;
+
+/** JParserIntf decoding one JSON object at a time into 'dest'.
+    'status' is a JDecoderS_xxx code. The decoder re-arms itself
+    at the start of each object.
+ */
+typedef struct
+{
+    JParserIntf super;
+    iot_command_packet_t *dest;
+    U32 received; /* One bit per member */
+    int status;
+    bool inObject;
+} iot_command_packet_decoder_t;
+
+void iot_command_packet_decoder_constructor(iot_command_packet_decoder_t *o, iot_command_packet_t *dest);
+int iot_command_packet_encode(BufPrint *out, const iot_command_packet_t *v);
+int iot_command_packet_set(JEncoder *e, const iot_command_packet_t *v);
+int iot_command_packet_template(JTemplate *t);
+int iot_command_packet_patch(JTemplate *t, const iot_command_packet_t *v);
+
+typedef struct iot_telemetry
+{
+    bool led;
+} iot_telemetry_t;
+
+/** JParserIntf decoding one JSON object at a time into 'dest'.
+    'status' is a JDecoderS_xxx code. The decoder re-arms itself
+    at the start of each object.
+ */
+typedef struct
+{
+    JParserIntf super;
+    iot_telemetry_t *dest;
+    U32 received; /* One bit per member */
+    int status;
+    bool inObject;
+} iot_telemetry_decoder_t;
+
+void iot_telemetry_decoder_constructor(iot_telemetry_decoder_t *o, iot_telemetry_t *dest);
+int iot_telemetry_encode(BufPrint *out, const iot_telemetry_t *v);
+int iot_telemetry_set(JEncoder *e, const iot_telemetry_t *v);
+int iot_telemetry_template(JTemplate *t);
+int iot_telemetry_patch(JTemplate *t, const iot_telemetry_t *v);
+
+#endif
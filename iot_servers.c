@@ -0,0 +1,289 @@
+#include "framework.h"
+#include "utils/debug.h"
+#include <lwip/dns.h>
+#include <lwip/tcpip.h>
+#include "iot_servers.h"
+
+void IOT_serverList_constructor(iot_server_list_t *o)
+{
+    I_START("IOT_serverList_constructor");
+    memset(o, 0, sizeof(iot_server_list_t));
+    o->current = -1;
+    o->dnsDone = xSemaphoreCreateBinary();
+    I_END("IOT_serverList_constructor");
+}
+
+int IOT_serverList_parse(iot_server_list_t *o, const char *list)
+{
+    I_START("IOT_serverList_parse");
+    iot_server_t servers[IOT_MAX_SERVERS];
+    int count = 0;
+    while (*list)
+    {
+        const char *end = strchr(list, ',');
+        const char *colon = 0;
+        const char *ptr;
+        U32 port = 0;
+        if (!end)
+            end = list + strlen(list);
+        while (list < end && *list == ' ')
+            list++;
+        for (ptr = list; ptr < end; ptr++)
+        {
+            if (*ptr == ':')
+                colon = ptr;
+        }
+        if (!colon || colon == list || colon - list >= IOT_MAX_HOST_LEN ||
+            colon + 1 == end || count == IOT_MAX_SERVERS)
+        {
+            I_RETURNV("IOT_serverList_parse", -1);
+        }
+        for (ptr = colon + 1; ptr < end && *ptr != ' '; ptr++)
+        {
+            if (*ptr < '0' || *ptr > '9' || (port = port * 10 + (U32)(*ptr - '0')) > 0xFFFF)
+                I_RETURNV("IOT_serverList_parse", -1);
+        }
+        if (!port)
+            I_RETURNV("IOT_serverList_parse", -1);
+        memset(&servers[count], 0, sizeof(iot_server_t));
+        memcpy(servers[count].host, list, colon - list);
+        servers[count].port = (u16_t)port;
+        count++;
+        list = *end ? end + 1 : end;
+    }
+    if (!count)
+        I_RETURNV("IOT_serverList_parse", -1);
+    memcpy(o->servers, servers, count * sizeof(iot_server_t));
+    o->count = count;
+    o->current = -1;
+    I_RETURNV("IOT_serverList_parse", count);
+}
+
+/* Runs in the tcpip thread. A lookup the caller gave up on, or the
+   late answer for a previous host, is ignored.
+ */
+static void IOT_serverList_dnsFound(const char *name, const ip_addr_t *addr, void *arg)
+{
+    iot_server_list_t *o = (iot_server_list_t *)arg;
+    if (o->dnsPending && !strcmp(name, o->dnsHost))
+    {
+        o->dnsPending = false;
+        o->dnsFound = addr != 0;
+        if (addr)
+            o->dnsAddr = *addr;
+        xSemaphoreGive(o->dnsDone);
+    }
+}
+
+/* Resolve server 'ix'. The cached address is used while it is fresh,
+   and in place of a failed lookup.
+ */
+static bool IOT_serverList_resolve(iot_server_list_t *o, int ix)
+{
+    F_START("IOT_serverList_resolve");
+    iot_server_t *s = &o->servers[ix];
+    TickType_t now = xTaskGetTickCount();
+    err_t err;
+    if (s->resolved && now - s->resolvedAt < pdMS_TO_TICKS(IOT_DNS_CACHE_MS))
+        F_RETURNV("IOT_serverList_resolve", true);
+    if (ipaddr_aton(s->host, &s->addr))
+    {
+        s->resolved = true;
+        s->resolvedAt = now;
+        F_RETURNV("IOT_serverList_resolve", true);
+    }
+    o->dnsHost = s->host;
+    xSemaphoreTake(o->dnsDone, 0);
+    LOCK_TCPIP_CORE();
+    o->dnsPending = true;
+    err = dns_gethostbyname(s->host, &o->dnsAddr, IOT_serverList_dnsFound, o);
+    if (err != ERR_INPROGRESS)
+        o->dnsPending = false;
+    UNLOCK_TCPIP_CORE();
+    if (err == ERR_INPROGRESS)
+    {
+        if (xSemaphoreTake(o->dnsDone, pdMS_TO_TICKS(IOT_DNS_TMO_MS)))
+            err = o->dnsFound ? ERR_OK : ERR_VAL;
+        else
+        {
+            LOCK_TCPIP_CORE();
+            o->dnsPending = false;
+            UNLOCK_TCPIP_CORE();
+            err = ERR_TIMEOUT;
+        }
+    }
+    if (err == ERR_OK)
+    {
+        s->addr = o->dnsAddr;
+        s->resolved = true;
+        s->resolvedAt = now;
+        F_RETURNV("IOT_serverList_resolve", true);
+    }
+    printf("[DNS] Lookup of %s failed: %d%s\n", s->host, err,
+           s->resolved ? ", using the cached address" : "");
+    F_RETURNV("IOT_serverList_resolve", s->resolved);
+}
+
+/* Reset the connection: no FIN exchange and no TIME_WAIT */
+void IOT_abortSocket(int sock)
+{
+    struct linger l = {1, 0};
+    setsockopt(sock, SOL_SOCKET, SO_LINGER, &l, sizeof(l));
+    closesocket(sock);
+}
+
+/* Start a non-blocking connect to the server */
+static int IOT_serverList_open(const iot_server_t *s, u16_t localPort)
+{
+    struct sockaddr_in addr = {};
+    int opt = 1;
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (sock < 0)
+        return -1;
+    /* The racing sockets share the local port */
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (localPort)
+    {
+        addr.sin_len = sizeof(struct sockaddr_in);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(localPort);
+        if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            closesocket(sock);
+            return -1;
+        }
+    }
+    ioctlsocket(sock, FIONBIO, &opt);
+    addr.sin_len = sizeof(struct sockaddr_in);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(s->port);
+    addr.sin_addr.s_addr = ip4_addr_get_u32(ip_2_ip4(&s->addr));
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS)
+    {
+        closesocket(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/* Connect states during the race */
+#define IOT_RACE_NONE 0
+#define IOT_RACE_PENDING 1
+#define IOT_RACE_UP 2
+
+int IOT_serverList_connect(iot_server_list_t *o, u16_t localPort)
+{
+    C_START("IOT_serverList_connect");
+    int socks[IOT_MAX_SERVERS];
+    U8 state[IOT_MAX_SERVERS];
+    bool resolved[IOT_MAX_SERVERS];
+    TickType_t started, deadline;
+    int i, pending = 0, best = -1;
+    bool grace = false, healthy = false, retry;
+    for (i = 0; i < o->count; i++)
+        healthy |= o->servers[i].failures < IOT_SERVER_MAX_FAILURES;
+    /* Failing servers sit out, but retry every IOT_SERVER_RETRY_ROUNDS
+       rounds, and join every round if no server is healthy */
+    retry = !healthy || o->rounds++ % IOT_SERVER_RETRY_ROUNDS == 0;
+    /* All lookups first: a slow lookup must not count in the RTT of a
+       server whose connect is already under way */
+    for (i = 0; i < o->count; i++)
+    {
+        state[i] = IOT_RACE_NONE;
+        resolved[i] = false;
+        if (o->servers[i].failures >= IOT_SERVER_MAX_FAILURES && !retry)
+            continue;
+        if (!(resolved[i] = IOT_serverList_resolve(o, i)))
+            o->servers[i].failures++;
+    }
+    /* The connects start together, see 'rtt' below */
+    started = xTaskGetTickCount();
+    for (i = 0; i < o->count; i++)
+    {
+        if (!resolved[i])
+            continue;
+        if ((socks[i] = IOT_serverList_open(&o->servers[i], localPort)) >= 0)
+        {
+            state[i] = IOT_RACE_PENDING;
+            pending++;
+        }
+        else
+            o->servers[i].failures++;
+    }
+    deadline = xTaskGetTickCount() + pdMS_TO_TICKS(IOT_CONNECT_TMO_MS);
+    while (pending)
+    {
+        TickType_t now = xTaskGetTickCount();
+        TickType_t left = deadline - now;
+        struct timeval tv;
+        fd_set wr;
+        int maxfd = -1;
+        if ((S32)left <= 0)
+            break;
+        FD_ZERO(&wr);
+        for (i = 0; i < o->count; i++)
+        {
+            if (state[i] == IOT_RACE_PENDING)
+            {
+                FD_SET(socks[i], &wr);
+                maxfd = socks[i] > maxfd ? socks[i] : maxfd;
+            }
+        }
+        tv.tv_sec = left / configTICK_RATE_HZ;
+        tv.tv_usec = (left % configTICK_RATE_HZ) * (1000000 / configTICK_RATE_HZ);
+        if (select(maxfd + 1, NULL, &wr, NULL, &tv) < 0)
+            break;
+        now = xTaskGetTickCount();
+        for (i = 0; i < o->count; i++)
+        {
+            iot_server_t *s = &o->servers[i];
+            int err = 0;
+            socklen_t len = sizeof(err);
+            U32 rtt;
+            if (state[i] != IOT_RACE_PENDING || !FD_ISSET(socks[i], &wr))
+                continue;
+            pending--;
+            getsockopt(socks[i], SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err)
+            {
+                closesocket(socks[i]);
+                state[i] = IOT_RACE_NONE;
+                s->failures++;
+                continue;
+            }
+            state[i] = IOT_RACE_UP;
+            s->failures = 0;
+            rtt = (now - started) * portTICK_PERIOD_MS;
+            if (!rtt)
+                rtt = 1;
+            /* Smoothed as TCP does: srtt += (rtt - srtt) / 8 */
+            s->srtt = s->srtt ? (7 * s->srtt + rtt) / 8 : rtt;
+            if (!grace)
+            {
+                /* Give the servers close behind a chance to be measured,
+                   but within IOT_CONNECT_TMO_MS */
+                TickType_t end = now + pdMS_TO_TICKS(min(2 * rtt, IOT_RACE_GRACE_MS));
+                grace = true;
+                if ((S32)(end - deadline) < 0)
+                    deadline = end;
+            }
+            if (best < 0 || s->srtt < o->servers[best].srtt)
+                best = i;
+        }
+    }
+    for (i = 0; i < o->count; i++)
+    {
+        if (state[i] == IOT_RACE_NONE || i == best)
+            continue;
+        /* Slow servers are not failed ones, unless nobody answered */
+        if (best < 0)
+            o->servers[i].failures++;
+        IOT_abortSocket(socks[i]);
+    }
+    o->current = best;
+    if (best < 0)
+        C_RETURNV("IOT_serverList_connect", -1);
+    i = 0;
+    ioctlsocket(socks[best], FIONBIO, &i);
+    C_RETURNV("IOT_serverList_connect", socks[best]);
+}
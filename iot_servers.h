@@ -0,0 +1,77 @@
+#ifndef _IOT_SERVERS_H
+#define _IOT_SERVERS_H
+
+#include <lwip/ip_addr.h>
+
+#define IOT_MAX_SERVERS 4
+#define IOT_MAX_HOST_LEN 32
+/* Size of a server list: "host:port" entries separated by ',' */
+#define IOT_SERVER_LIST_LEN 128
+
+#define IOT_DNS_TMO_MS 5000
+/* A resolved address is used this long before it is looked up again.
+   lwIP caches by the record's TTL as well; this cache also bridges a
+   failed lookup with the last known address.
+ */
+#define IOT_DNS_CACHE_MS (10 * 60 * 1000)
+#define IOT_CONNECT_TMO_MS 5000
+/* After the first connect completes, servers completing within twice
+   its time, but at most this long, are also measured.
+ */
+#define IOT_RACE_GRACE_MS 200
+/* A server failing this many rounds in a row only joins every
+   IOT_SERVER_RETRY_ROUNDS round, which spares the connect timeout
+   and the DNS timeout of a server that is down.
+ */
+#define IOT_SERVER_MAX_FAILURES 3
+#define IOT_SERVER_RETRY_ROUNDS 4
+
+typedef struct
+{
+    char host[IOT_MAX_HOST_LEN];
+    u16_t port;
+    bool resolved; /* 'addr' holds the last resolved address */
+    ip_addr_t addr;
+    TickType_t resolvedAt;
+    U32 srtt;     /* Smoothed connect RTT in ms, 0 until measured */
+    U32 failures; /* Consecutive rounds the server did not connect */
+} iot_server_t;
+
+typedef struct
+{
+    iot_server_t servers[IOT_MAX_SERVERS];
+    int count;
+    int current; /* Server of the last connection, or -1 */
+    U32 rounds;  /* Connect rounds, see IOT_SERVER_RETRY_ROUNDS */
+    /* DNS lookup in progress, completed by the tcpip thread */
+    SemaphoreHandle_t dnsDone;
+    const char *dnsHost;
+    ip_addr_t dnsAddr;
+    bool dnsPending;
+    bool dnsFound;
+} iot_server_list_t;
+
+void IOT_serverList_constructor(iot_server_list_t *o);
+/** Set the servers from a list such as "iot.example.com:23,10.0.0.5:23".
+    \returns the number of servers, or -1 if an entry is malformed, in
+    which case the list is unchanged.
+ */
+int IOT_serverList_parse(iot_server_list_t *o, const char *list);
+/** Connect to the fastest reachable server. All servers are resolved
+    and connected in parallel; among those completing the handshake,
+    the one with the lowest smoothed connect RTT is kept and the others
+    are reset. A server that is down simply loses the race, so calling
+    this again after a connection is lost fails over. A server that
+    keeps failing sits out most rounds, see IOT_SERVER_MAX_FAILURES.
+    \param localPort the port to bind, or 0 for any port.
+    \returns a blocking socket, or -1 if no server could be reached.
+ */
+int IOT_serverList_connect(iot_server_list_t *o, u16_t localPort);
+/** Close 'sock' with a reset, which leaves no TIME_WAIT state behind
+    that would block reconnecting from the same local port.
+ */
+void IOT_abortSocket(int sock);
+/** The server of the last successful connect. */
+#define IOT_serverList_current(o) ((o)->current < 0 ? 0 : &(o)->servers[(o)->current])
+
+#endif
@@ -13,6 +13,7 @@ int send_buffer(iot_tcp_client_t *o, char *buf, int size)
         int done_now = send(*(o->sock), buf + done, size - done, 0);
         if (done_now <= 0)
         {
+            o->sockErr = true;
             o->statusCallback(false);
             I_RETURNV("send_buffer", done_now);
         }
@@ -35,6 +36,9 @@ int readtmo(int sock, U32 tmo)
     F_RETURNV("readtmo", select(sock + 1, &recSet, 0, 0, &tv) > 0 ? 0 : -1);
 }
 
+/* With TCP_INFINITE_TMO, the calling task sleeps in recv() until data
+   arrives or the socket is shut down; there are no periodic wakeups.
+ */
 int receive_buffer(int sock, void *buf, U32 len, U32 timeout)
 {
     F_START("receive_buffer");
@@ -53,39 +57,18 @@ int receive_buffer(int sock, void *buf, U32 len, U32 timeout)
     F_RETURNV("receive_buffer", recLen);
 }
 
-#define IOT_JParserAllocator_constructor(o)                 \
-    AllocatorIntf_constructor((AllocatorIntf *)o,           \
-                              IOT_JParserAllocator_malloc,  \
-                              IOT_JParserAllocator_realloc, \
-                              IOT_JParserAllocator_free)
-
-void *
-IOT_JParserAllocator_malloc(AllocatorIntf *super, size_t *size)
-{
-    IOT_JParserAllocator *o = (IOT_JParserAllocator *)super;
-    return *size <= TCP_MAX_STRING_LEN ? o->buf : 0;
-}
-
-void *
-IOT_JParserAllocator_realloc(AllocatorIntf *super, void *memblock, size_t *size)
-{
-    IOT_JParserAllocator *o = (IOT_JParserAllocator *)super;
-    baAssert(memblock == o->buf);
-    return *size <= TCP_MAX_STRING_LEN ? o->buf : 0;
-}
-
-void IOT_JParserAllocator_free(AllocatorIntf *super, void *memblock)
-{
-    /* Do nothing */
-    (void)super;
-    (void)memblock;
-}
-
 int BufPrint_sockWrite(BufPrint *o, int sizeRequired)
 {
     I_START("BufPrint_sockWrite");
     int status;
-    (void)sizeRequired; /* Not used */
+    iot_tcp_client_t *client = (iot_tcp_client_t *)(o->userData);
+    /* The length prefix is patched in when the message is complete */
+    if (client->frameOpen && sizeRequired)
+    {
+        /* outBuf is left as is; the writer drops the message */
+        printf("Message too large for a frame\n");
+        F_RETURNV("BufPrint_sockWrite", -1);
+    }
     /* Send JSON data to server */
     status = send_buffer((iot_tcp_client_t *)(o->userData), o->buf, o->cursor);
     o->cursor = 0; /* Data flushed */
@@ -97,6 +80,49 @@ int BufPrint_sockWrite(BufPrint *o, int sizeRequired)
     F_RETURNV("BufPrint_sockWrite", 0);
 }
 
+/* Large writes: hand the buffered data and the caller's data to lwIP
+   in one call, without staging the latter in outBuf */
+int BufPrint_sockWriteV(BufPrint *o, const BufPrintSeg *seg, int segLen)
+{
+    I_START("BufPrint_sockWriteV");
+    iot_tcp_client_t *client = (iot_tcp_client_t *)(o->userData);
+    struct iovec iov[2];
+    int i;
+    if (client->frameOpen)
+    {
+        printf("Message too large for a frame\n");
+        I_RETURNV("BufPrint_sockWriteV", -1);
+    }
+    for (i = 0; i < segLen; i++)
+    {
+        iov[i].iov_base = (void *)seg[i].data;
+        iov[i].iov_len = (size_t)seg[i].len;
+    }
+    client->statusCallback(true);
+    i = 0;
+    while (i < segLen)
+    {
+        int done = writev(*(client->sock), iov + i, segLen - i);
+        if (done <= 0)
+        {
+            client->sockErr = true;
+            client->statusCallback(false);
+            printf("Socket closed on write\n");
+            I_RETURNV("BufPrint_sockWriteV", -1);
+        }
+        /* Skip what was sent; a partial write leaves the rest for the next round */
+        while (i < segLen && (size_t)done >= iov[i].iov_len)
+            done -= (int)iov[i++].iov_len;
+        if (i < segLen)
+        {
+            iov[i].iov_base = (char *)iov[i].iov_base + done;
+            iov[i].iov_len -= (size_t)done;
+        }
+    }
+    client->statusCallback(false);
+    I_RETURNV("BufPrint_sockWriteV", 0);
+}
+
 int TCP_parserCallback(JParserIntf *super, JParserVal *v, int nLevel)
 {
     F_START("TCP_parserCallback");
@@ -104,18 +130,52 @@ int TCP_parserCallback(JParserIntf *super, JParserVal *v, int nLevel)
     F_RETURNV("TCP_parserCallback", JParserIntf_serviceCB((JParserIntf *)&o->decoder, v, nLevel));
 }
 
+/* Status of the parser for the selected wire format */
+static JParsStat TCP_parserStatus(iot_tcp_client_t *o)
+{
+    return o->cbor ? CBORParser_getStatus(&o->cborParser) : JParser_getStatus(&o->parser);
+}
+
+/* Discard a partial or malformed message */
+static void TCP_resetParser(iot_tcp_client_t *o)
+{
+    if (o->cbor)
+        CBORParser_reset(&o->cborParser);
+    else
+        JParser_reset(&o->parser);
+    iot_command_packet_decoder_constructor(&o->decoder, &o->packet);
+}
+
+/* Parse one whole message received by the framer */
+static int TCP_frameCallback(JFramer *framer, const U8 *frame, U32 len)
+{
+    iot_tcp_client_t *o = (iot_tcp_client_t *)framer->userData;
+    int status = o->cbor ? CBORParser_parse(&o->cborParser, frame, len)
+                         : JParser_parse(&o->parser, frame, len);
+    /* The frame must hold exactly one message */
+    if (status > 0 && TCP_parserStatus(o) == JParsStat_DoneEOS)
+    {
+        cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, o->packet.led);
+        return 0;
+    }
+    printf("Skipping malformed frame: %d\n", TCP_parserStatus(o));
+    o->badFrames++;
+    TCP_resetParser(o);
+    return 0;
+}
+
 int TCP_manage(iot_tcp_client_t *o, U8 *data, U32 dsize)
 {
     F_START("TCP_manage");
     int status;
+    if (o->framing != IOT_FRAMING_NONE)
+    {
+        F_RETURNV("TCP_manage", JFramer_feed(&o->framer, data, dsize));
+    }
     do
     {
-        if (JDecoder_get(&o->decoder, "{b}",
-                         JD_MNUM(&(o->packet), led)))
-        {
-            F_RETURNV("TCP_manage", 1);
-        }
-        status = JParser_parse(&o->parser, data, dsize);
+        status = o->cbor ? CBORParser_parse(&o->cborParser, data, dsize)
+                         : JParser_parse(&o->parser, data, dsize);
         if (status)
         {
             if (status > 0)
@@ -125,10 +185,10 @@ int TCP_manage(iot_tcp_client_t *o, U8 *data, U32 dsize)
             }
             else
             {
-                printf("JParser or parser callback error: %d\n", JParser_getStatus(&o->parser));
+                printf("Parser or parser callback error: %d\n", TCP_parserStatus(o));
             }
         }
-    } while (status == 0 && JParser_getStatus(&o->parser) == JParsStat_Done);
+    } while (status == 0 && TCP_parserStatus(o) == JParsStat_Done);
     F_RETURNV("TCP_manage", status);
 }
 
@@ -137,60 +197,462 @@ void IOT_constructor(iot_tcp_client_t *o, int *sock, IOTTcpClient_Status statusC
     I_START("IOT_constructor");
     JParserIntf_constructor((JParserIntf *)o, TCP_parserCallback);
     BufPrint_constructor2(&o->out, o->outBuf, TCP_IN_OUT_BUF_SIZE, o, BufPrint_sockWrite);
+    BufPrint_setWriteV(&o->out, BufPrint_sockWriteV);
     JErr_constructor(&o->err);
     JEncoder_constructor(&o->encoder, &o->err, &o->out);
-    JDecoder_constructor(&o->decoder, o->inBuf, TCP_IN_OUT_BUF_SIZE, 0);
-    IOT_JParserAllocator_constructor(&o->pAlloc);
+    /* Generated from iot_messages.schema, re-arms itself per message */
+    iot_command_packet_decoder_constructor(&o->decoder, &o->packet);
+    ArenaAllocator_constructor(&o->pAlloc, o->pAllocBuf, sizeof(o->pAllocBuf));
     JParser_constructor(&o->parser, (JParserIntf *)o, o->memberName,
                         TCP_MAX_MEMBER_NAME_LEN, (AllocatorIntf *)&o->pAlloc, 0);
+    /* pAlloc is only used for tokens split between two recv() chunks */
+    JParser_setZeroCopy(&o->parser, TRUE);
+    CBORParser_constructor(&o->cborParser, (JParserIntf *)o, o->memberName,
+                           TCP_MAX_MEMBER_NAME_LEN, (AllocatorIntf *)&o->pAlloc, 0);
+    CBORParser_setZeroCopy(&o->cborParser, TRUE);
+    o->cbor = false;
+    o->framing = IOT_FRAMING_NONE;
+    o->frameOpen = false;
+    o->badFrames = 0;
+    o->badMessages = 0;
+    o->telemetryBuilt = false;
+    o->outQueue = xQueueCreate(TCP_OUT_QUEUE_LEN, sizeof(iot_out_msg_t));
+    o->writerTask = 0;
+    o->outDropped = 0;
+    o->unsentHead = 0;
+    o->unsentLen = 0;
+    o->outOpen = o->outQueue != 0;
+    o->connected = false;
+    o->noDelay = false;
+    o->running = true;
     o->sock = sock;
     o->statusCallback = statusCallback;
     I_END("IOT_constructor");
 }
 
-int IOT_Send(iot_tcp_client_t *o, const char *fmt, ...)
+void IOT_setCBOR(iot_tcp_client_t *o, bool enable)
 {
-    I_START("IOT_Send");
-    if (JParser_getStatus(&o->parser) != JParsStat_NeedMoreData)
+    I_START("IOT_setCBOR");
+    o->cbor = enable;
+    JEncoder_setCBOR(&o->encoder, enable);
+    o->telemetryBuilt = false;
+    I_END("IOT_setCBOR");
+}
+
+int IOT_setFraming(iot_tcp_client_t *o, int framing)
+{
+    I_START("IOT_setFraming");
+    if (framing == IOT_FRAMING_NEWLINE && o->cbor)
     {
-        int retVal;
-        va_list varg;
-        va_start(varg, fmt);
-        retVal = JEncoder_vSetJV(&o->encoder, &fmt, &varg);
-        if (retVal) /* Can only set error once. Just in case not set */
-            JErr_setError((&o->encoder)->err, JErrT_FmtValErr, "?");
-        va_end(varg);
-        I_RETURNV("IOT_Send", JErr_isError(&o->err) || JEncoder_commit(&o->encoder) ? -1 : 0);
+        I_RETURNV("IOT_setFraming", -1);
     }
-    I_RETURNV("IOT_Send", 0);
+    o->framing = framing;
+    if (framing != IOT_FRAMING_NONE)
+    {
+        JFramer_constructor(&o->framer,
+                            framing == IOT_FRAMING_LENGTH ? JFramerT_Length : JFramerT_Newline,
+                            o->frameBuf, TCP_MAX_FRAME_SIZE, o, TCP_frameCallback);
+    }
+    o->telemetryBuilt = false;
+    I_RETURNV("IOT_setFraming", 0);
 }
 
-int sendError(iot_tcp_client_t *o, int error)
+/* Start a message in outBuf. A message is never split between two
+   flushes, see TCP_MAX_MSG_SIZE, thus the length prefix is patched in
+   by TCP_endFrame.
+ */
+static void TCP_beginFrame(iot_tcp_client_t *o)
 {
-    I_START("sendError");
-    if (JParser_getStatus(&o->parser) != JParsStat_NeedMoreData)
+    if (o->framing == IOT_FRAMING_LENGTH)
     {
-        JEncoder_beginObject(&o->encoder);
+        o->frameStart = o->out.cursor;
+        BufPrint_write(&o->out, "\0\0\0\0", JFRAMER_HDR_SIZE);
+        o->frameOpen = true;
+    }
+}
 
-        JEncoder_setName(&o->encoder, "message");
-        JEncoder_setString(&o->encoder, "Server does not follow strict API rules.");
+/* Terminate the message in outBuf */
+static int TCP_endFrame(iot_tcp_client_t *o)
+{
+    if (o->framing == IOT_FRAMING_NEWLINE)
+        return BufPrint_putc(&o->out, '\n') < 0 ? -1 : 0;
+    if (o->framing == IOT_FRAMING_LENGTH)
+    {
+        o->frameOpen = false;
+        JFramer_setHeader((U8 *)o->outBuf + o->frameStart,
+                          o->out.cursor - o->frameStart - JFRAMER_HDR_SIZE);
+    }
+    return 0;
+}
 
-        JEncoder_setName(&o->encoder, "error");
-        JEncoder_setInt(&o->encoder, error);
+/* Build the telemetry template on first use. The template is built
+   after room for the length prefix; the frame around it never changes
+   since the slots have a fixed width.
+ */
+static bool TCP_telemetryTemplate(iot_tcp_client_t *o)
+{
+    if (!o->telemetryBuilt)
+    {
+        char *msg = o->telemetryBuf + JFRAMER_HDR_SIZE;
+        JTemplate_constructor(&o->telemetry, msg, TCP_TEMPLATE_BUF_SIZE, o->cbor);
+        o->telemetryValid = iot_telemetry_template(&o->telemetry) == 0;
+        o->telemetryBuilt = true;
+        o->telemetryMsg = msg;
+        o->telemetryLen = JTemplate_getLen(&o->telemetry);
+        if (o->framing == IOT_FRAMING_NEWLINE)
+            msg[o->telemetryLen++] = '\n';
+        else if (o->framing == IOT_FRAMING_LENGTH)
+        {
+            JFramer_setHeader((U8 *)o->telemetryBuf, o->telemetryLen);
+            o->telemetryMsg = o->telemetryBuf;
+            o->telemetryLen += JFRAMER_HDR_SIZE;
+        }
+    }
+    return o->telemetryValid;
+}
 
-        JEncoder_endObject(&o->encoder);
-        I_RETURNV("sendError", JErr_isError(&o->err) || JEncoder_commit(&o->encoder) ? -1 : 0);
+/* The encode functions below run in the writer task and leave the
+   message in outBuf; the writer flushes once per batch.
+ */
+
+/* Patch the template; use the encoder for values not fitting a slot.
+   With 'last' set, a patched template is not copied to outBuf and 1 is
+   returned: the writer hands it to lwIP directly, see TCP_flush.
+ */
+static int TCP_encodeTelemetry(iot_tcp_client_t *o, const iot_telemetry_t *telemetry, bool last)
+{
+    if (TCP_telemetryTemplate(o) && iot_telemetry_patch(&o->telemetry, telemetry) == 0)
+    {
+        if (last)
+            return 1;
+        return BufPrint_write(&o->out, o->telemetryMsg, o->telemetryLen) < 0 ? -1 : 0;
+    }
+    TCP_beginFrame(o);
+    if (o->cbor)
+    {
+        if (iot_telemetry_set(&o->encoder, telemetry))
+            return -1;
+        JEncoder_endMessage(&o->encoder);
+        return TCP_endFrame(o);
+    }
+    return iot_telemetry_encode(&o->out, telemetry) || TCP_endFrame(o) ? -1 : 0;
+}
+
+static int TCP_encodeError(iot_tcp_client_t *o, int error)
+{
+    TCP_beginFrame(o);
+    JEncoder_beginObject(&o->encoder);
+
+    JEncoder_setName(&o->encoder, "message");
+    JEncoder_setString(&o->encoder, "Server does not follow strict API rules.");
+
+    JEncoder_setName(&o->encoder, "error");
+    JEncoder_setInt(&o->encoder, error);
+
+    JEncoder_endObject(&o->encoder);
+    JEncoder_endMessage(&o->encoder);
+    return JErr_isError(&o->err) || TCP_endFrame(o) ? -1 : 0;
+}
+
+static int TCP_encodeSend(iot_tcp_client_t *o, const char *fmt, va_list *args)
+{
+    TCP_beginFrame(o);
+    if (JEncoder_vSetJV(&o->encoder, &fmt, args)) /* Can only set error once. Just in case not set */
+        JErr_setError((&o->encoder)->err, JErrT_FmtValErr, "?");
+    JEncoder_endMessage(&o->encoder);
+    return JErr_isError(&o->err) || TCP_endFrame(o) ? -1 : 0;
+}
+
+/* Let lwIP hold back a partial segment (Nagle) while more messages are
+   queued, and push the segment out when the queue is drained.
+ */
+static void TCP_setNoDelay(iot_tcp_client_t *o, bool noDelay)
+{
+    if (o->noDelay != noDelay)
+    {
+        int on = noDelay ? 1 : 0;
+        setsockopt(*o->sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        o->noDelay = noDelay;
     }
-    I_RETURNV("sendError", 0);
+}
+
+/* Send outBuf followed by the patched telemetry template, if 'inPlace'.
+   lwIP's socket layer copies the data into its own pbufs, so the
+   template goes to lwIP by reference rather than through outBuf.
+ */
+static int TCP_flush(iot_tcp_client_t *o, bool inPlace)
+{
+    BufPrintSeg seg[2];
+    int segLen = 0;
+    int status;
+    if (!inPlace)
+        return BufPrint_flush(&o->out);
+    if (o->out.cursor)
+    {
+        seg[0].data = o->out.buf;
+        seg[0].len = o->out.cursor;
+        segLen = 1;
+    }
+    seg[segLen].data = o->telemetryMsg;
+    seg[segLen].len = o->telemetryLen;
+    status = BufPrint_sockWriteV(&o->out, seg, segLen + 1);
+    o->out.cursor = 0;
+    return status;
+}
+
+/* Counted by the writer task and by the tasks queuing telemetry */
+static void TCP_countDropped(iot_tcp_client_t *o)
+{
+    taskENTER_CRITICAL();
+    o->outDropped++;
+    taskEXIT_CRITICAL();
+}
+
+/* Keep a telemetry or error record until lwIP has accepted it. The
+   oldest record is dropped when the session is full.
+ */
+static void TCP_keep(iot_tcp_client_t *o, const iot_out_msg_t *msg)
+{
+    if (o->unsentLen == TCP_SESSION_LEN)
+    {
+        o->unsentHead = (o->unsentHead + 1) % TCP_SESSION_LEN;
+        o->unsentLen--;
+        TCP_countDropped(o);
+    }
+    o->unsent[(o->unsentHead + o->unsentLen++) % TCP_SESSION_LEN] = *msg;
+}
+
+#define TCP_unsent(o, i) (&(o)->unsent[((o)->unsentHead + (i)) % TCP_SESSION_LEN])
+
+/* The connection failed: stop using the socket and wake the message
+   loop, which hands the socket back with IOT_MSG_DISCONNECT.
+ */
+static void TCP_lost(iot_tcp_client_t *o)
+{
+    printf("Writer lost the connection\n");
+    o->connected = false;
+    shutdown(*o->sock, SHUT_RD);
+}
+
+/* Start over with a clean encoder */
+static void TCP_resetEncoder(iot_tcp_client_t *o)
+{
+    JErr_constructor(&o->err);
+    JEncoder_constructor(&o->encoder, &o->err, &o->out);
+    JEncoder_setCBOR(&o->encoder, o->cbor);
+}
+
+/* A message that failed to encode for other reasons than a socket
+   error is dropped, and the connection stays up. Removes what the
+   message left in outBuf after 'mark', or all of outBuf if a large
+   message was flushed in part.
+ */
+static void TCP_dropMessage(iot_tcp_client_t *o, int mark)
+{
+    printf("Dropped a message that could not be encoded\n");
+    o->out.cursor = mark <= o->out.cursor ? mark : 0;
+    o->frameOpen = false;
+    TCP_resetEncoder(o);
+    o->badMessages++;
+}
+
+/* Send the kept records, one flush per outBuf full. Records are
+   released once sent or dropped; on a socket error the rest wait for
+   the next connection.
+ */
+static int TCP_sendUnsent(iot_tcp_client_t *o)
+{
+    int status = 0;
+    while (!status && o->unsentLen)
+    {
+        bool inPlace = false;
+        int n = 0;
+        while (!status && n < o->unsentLen &&
+               o->out.cursor + TCP_MAX_MSG_SIZE <= TCP_IN_OUT_BUF_SIZE)
+        {
+            iot_out_msg_t *msg = TCP_unsent(o, n++);
+            int mark = o->out.cursor;
+            if (msg->type == IOT_MSG_TELEMETRY)
+            {
+                /* Telemetry ending the batch is sent from the template */
+                status = TCP_encodeTelemetry(o, &msg->u.telemetry, n == o->unsentLen);
+                if (status == 1)
+                {
+                    inPlace = true;
+                    status = 0;
+                }
+            }
+            else
+                status = TCP_encodeError(o, msg->u.error);
+            if (status && !o->sockErr)
+            {
+                TCP_dropMessage(o, mark);
+                status = 0;
+            }
+        }
+        if (!status)
+        {
+            TCP_setNoDelay(o, n == o->unsentLen && uxQueueMessagesWaiting(o->outQueue) == 0);
+            status = TCP_flush(o, inPlace);
+        }
+        if (!status)
+        {
+            o->unsentHead = (o->unsentHead + n) % TCP_SESSION_LEN;
+            o->unsentLen -= n;
+        }
+    }
+    if (status)
+        TCP_lost(o);
+    return status;
+}
+
+/* Start a connection with a clean outBuf and encoder */
+static void TCP_resetWriter(iot_tcp_client_t *o)
+{
+    o->out.cursor = 0;
+    o->frameOpen = false;
+    o->noDelay = false;
+    o->sockErr = false;
+    TCP_resetEncoder(o);
+    o->connected = true;
+}
+
+/* Encodes the queued messages in batches, one outBuf flush per batch.
+   Records accumulate in 'unsent' while more are queued, or while
+   there is no connection, and are sent when the queue is drained.
+ */
+static void TCP_writerTask(void *params)
+{
+    I_START("TCP_writerTask");
+    iot_tcp_client_t *o = (iot_tcp_client_t *)params;
+    iot_out_msg_t msg;
+    lwip_socket_thread_init();
+    for (;;)
+    {
+        if (xQueueReceive(o->outQueue, &msg, portMAX_DELAY) != pdTRUE)
+            continue;
+        if (msg.type == IOT_MSG_SEND)
+        {
+            /* Goes after the kept records, and the caller waits for the result */
+            int status = -1;
+            if (o->connected && !TCP_sendUnsent(o))
+            {
+                status = TCP_encodeSend(o, msg.u.send.fmt, msg.u.send.args);
+                if (!status)
+                {
+                    TCP_setNoDelay(o, uxQueueMessagesWaiting(o->outQueue) == 0);
+                    status = BufPrint_flush(&o->out);
+                }
+                if (status && !o->sockErr)
+                    TCP_dropMessage(o, 0);
+                else if (status)
+                    TCP_lost(o);
+            }
+            *msg.u.send.status = status;
+            xTaskNotifyGive(msg.u.send.caller);
+        }
+        else if (msg.type == IOT_MSG_CONNECT)
+            TCP_resetWriter(o);
+        else if (msg.type == IOT_MSG_DISCONNECT)
+        {
+            /* Try to send what is kept, the connection may still be up */
+            if (o->connected)
+                TCP_sendUnsent(o);
+            o->connected = false;
+            xTaskNotifyGive(o->loopTask);
+        }
+        else
+            TCP_keep(o, &msg);
+        if (o->connected && o->unsentLen &&
+            (o->unsentLen == TCP_SESSION_LEN || uxQueueMessagesWaiting(o->outQueue) == 0))
+        {
+            TCP_sendUnsent(o);
+        }
+    }
+    I_END("TCP_writerTask");
+}
+
+/* Post a record to the writer task */
+static int TCP_post(iot_tcp_client_t *o, const iot_out_msg_t *msg, TickType_t wait)
+{
+    if (!o->outOpen)
+        return -1;
+    return xQueueSend(o->outQueue, msg, wait) == pdTRUE ? 0 : 1;
+}
+
+int IOT_Send(iot_tcp_client_t *o, const char *fmt, ...)
+{
+    I_START("IOT_Send");
+    int status = -1;
+    iot_out_msg_t msg;
+    va_list varg;
+    va_start(varg, fmt);
+    msg.type = IOT_MSG_SEND;
+    msg.u.send.fmt = fmt;
+    msg.u.send.args = &varg;
+    msg.u.send.caller = xTaskGetCurrentTaskHandle();
+    msg.u.send.status = &status;
+    /* The writer reads 'varg' and 'status' on this stack, so wait for
+       its answer, which it gives to every IOT_MSG_SEND, connected or
+       not. The writer task is never deleted once started.
+     */
+    if (TCP_post(o, &msg, portMAX_DELAY) == 0)
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    va_end(varg);
+    I_RETURNV("IOT_Send", status ? -1 : 0);
+}
+
+int IOT_sendTelemetry(iot_tcp_client_t *o, const iot_telemetry_t *telemetry)
+{
+    I_START("IOT_sendTelemetry");
+    iot_out_msg_t msg;
+    int status;
+    msg.type = IOT_MSG_TELEMETRY;
+    msg.u.telemetry = *telemetry;
+    status = TCP_post(o, &msg, 0);
+    if (status > 0)
+    {
+        TCP_countDropped(o);
+        status = 0;
+    }
+    I_RETURNV("IOT_sendTelemetry", status);
+}
+
+int sendError(iot_tcp_client_t *o, int error)
+{
+    I_START("sendError");
+    iot_out_msg_t msg;
+    msg.type = IOT_MSG_ERROR;
+    msg.u.error = error;
+    I_RETURNV("sendError", TCP_post(o, &msg, pdMS_TO_TICKS(100)) ? -1 : 0);
 }
 
 int IOT_startMessageLoop(iot_tcp_client_t *o)
 {
     C_START("IOT_startMessageLoop");
-    o->running = true;
     int rc, status = -1;
+    iot_out_msg_t msg;
+    o->loopTask = xTaskGetCurrentTaskHandle();
+    /* The writer outlives the connection and keeps what it has not sent */
+    if (!o->writerTask &&
+        (!o->outQueue ||
+         xTaskCreate(TCP_writerTask, "TCPWriter", configMINIMAL_STACK_SIZE, o, (tskIDLE_PRIORITY + 2UL), &o->writerTask) != pdPASS))
+    {
+        o->writerTask = 0;
+        o->outOpen = false;
+        C_RETURNV("IOT_startMessageLoop", -1);
+    }
     U8 *buf = pvPortMalloc(TCP_IN_OUT_BUF_SIZE);
-    while ((rc = receive_buffer(*o->sock, buf, TCP_IN_OUT_BUF_SIZE, 50)) >= 0 && o->running)
+    if (!buf)
+        C_RETURNV("IOT_startMessageLoop", -1);
+    /* Nothing of the previous connection's input is left over */
+    TCP_resetParser(o);
+    if (o->framing != IOT_FRAMING_NONE)
+        JFramer_reset(&o->framer);
+    msg.type = IOT_MSG_CONNECT;
+    xQueueSend(o->outQueue, &msg, portMAX_DELAY);
+    /* Block until data arrives; IOT_stopMessageLoop ends the wait */
+    while (o->running && (rc = receive_buffer(*o->sock, buf, TCP_IN_OUT_BUF_SIZE, TCP_INFINITE_TMO)) >= 0)
     {
         if (rc)
         {
@@ -203,6 +665,10 @@ int IOT_startMessageLoop(iot_tcp_client_t *o)
     }
 
     vPortFree(buf);
+    /* Let the writer send what is queued and release the socket */
+    msg.type = IOT_MSG_DISCONNECT;
+    xQueueSend(o->outQueue, &msg, portMAX_DELAY);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
     C_RETURNV("IOT_startMessageLoop", status);
 }
 
@@ -210,5 +676,8 @@ void IOT_stopMessageLoop(iot_tcp_client_t *o)
 {
     C_START("IOT_stopMessageLoop");
     o->running = false;
+    /* Make recv() in the message loop return */
+    if (*o->sock >= 0)
+        shutdown(*o->sock, SHUT_RD);
     C_END("IOT_stopMessageLoop");
-}
\ No newline at end of file
+}
@@ -1,6 +1,10 @@
 #ifndef _IOT_TCPCLIENT_H
 #define _IOT_TCPCLIENT_H
 
+#include "iot_messages.h"
+#include "lib/json/CBORParser.h"
+#include "lib/json/JFramer.h"
+
 #define TCP_MAX_STRING_LEN (256)
 
 #define TCP_INFINITE_TMO (~((U32)0))
@@ -8,22 +12,54 @@
 #define TCP_MAX_MEMBER_NAME_LEN (10 + 1)
 #define TCP_IN_OUT_BUF_SIZE 256
 #define TCP_MAX_PACKET_COUNT 5
+#define TCP_TEMPLATE_BUF_SIZE 64
+#define TCP_MAX_FRAME_SIZE 128
+#define TCP_OUT_QUEUE_LEN 8
+/* Largest queued telemetry or error message, including framing. A
+   batch ends when less than this is left in outBuf.
+ */
+#define TCP_MAX_MSG_SIZE 96
+/* Telemetry and error messages kept until lwIP has accepted them, and
+   replayed on the next connection if the connection is lost first.
+ */
+#define TCP_SESSION_LEN 8
+
+/* Message framing on the TCP stream, see IOT_setFraming */
+#define IOT_FRAMING_NONE 0    /* The parser finds the message boundaries */
+#define IOT_FRAMING_NEWLINE 1 /* NDJSON, JSON text only */
+#define IOT_FRAMING_LENGTH 2  /* 4 byte big endian length prefix */
 
 /** Status callback function.
     \param data, show/hide data icon
  */
 typedef void (*IOTTcpClient_Status)(bool data);
 
-typedef struct iot_command_packet
-{
-    bool led;
-} iot_command_packet_t;
+/* Outbound message record types */
+#define IOT_MSG_TELEMETRY 0
+#define IOT_MSG_ERROR 1
+#define IOT_MSG_SEND 2       /* IOT_Send, the caller waits for the writer */
+#define IOT_MSG_CONNECT 3    /* The message loop has a new connection */
+#define IOT_MSG_DISCONNECT 4 /* The message loop is closing the connection */
 
+/* A message posted to the writer task. Records are copied into the
+   queue, so the producer's data need not outlive the call.
+ */
 typedef struct
 {
-    AllocatorIntf super;
-    U8 buf[TCP_MAX_STRING_LEN];
-} IOT_JParserAllocator;
+    U8 type; /* IOT_MSG_xxx */
+    union
+    {
+        iot_telemetry_t telemetry;
+        int error;
+        struct
+        {
+            const char *fmt;
+            va_list *args;
+            TaskHandle_t caller;
+            int *status;
+        } send;
+    } u;
+} iot_out_msg_t;
 
 typedef struct iot_tcp_client
 {
@@ -31,21 +67,87 @@ typedef struct iot_tcp_client
     BufPrint out;
     JErr err;
     JEncoder encoder;
-    JDecoder decoder;
-    IOT_JParserAllocator pAlloc;
+    iot_command_packet_decoder_t decoder;
+    ArenaAllocator pAlloc;
+    /* Room for one TCP_MAX_STRING_LEN token in the parsers */
+    U64 pAllocBuf[ArenaAllocator_blockSize(TCP_MAX_STRING_LEN) / sizeof(U64)];
     JParser parser;
+    CBORParser cborParser;
+    JFramer framer;
     int *sock;
-    U8 inBuf[TCP_IN_OUT_BUF_SIZE];
     iot_command_packet_t packet;
     char outBuf[TCP_IN_OUT_BUF_SIZE];
     char memberName[TCP_MAX_MEMBER_NAME_LEN];
+    U8 frameBuf[TCP_MAX_FRAME_SIZE];
     IOTTcpClient_Status statusCallback;
+    /* Telemetry encoded once, only the values are rewritten per send */
+    JTemplate telemetry;
+    char telemetryBuf[JFRAMER_HDR_SIZE + TCP_TEMPLATE_BUF_SIZE + 1];
+    char *telemetryMsg; /* The framed template in telemetryBuf */
+    int telemetryLen;
+    U32 badFrames; /* Malformed frames skipped */
+    U32 badMessages; /* Outbound messages dropped as they could not be encoded */
+    int framing;   /* IOT_FRAMING_xxx */
+    int frameStart; /* Position of the open frame in outBuf */
+    /* Outbound messages, encoded and sent by the writer task */
+    QueueHandle_t outQueue;
+    TaskHandle_t loopTask;
+    TaskHandle_t writerTask;
+    U32 outDropped; /* Telemetry dropped on a full queue or session */
+    /* Messages not yet sent, oldest first, see TCP_SESSION_LEN */
+    iot_out_msg_t unsent[TCP_SESSION_LEN];
+    int unsentHead;
+    int unsentLen;
+    volatile bool outOpen; /* The writer accepts messages */
+    bool connected; /* The writer may use the socket */
+    bool sockErr; /* Sending failed, the connection is lost */
+    bool noDelay; /* TCP_NODELAY is set on the socket */
     bool running;
+    bool cbor; /* CBOR instead of JSON text in both directions */
+    bool telemetryBuilt;
+    bool telemetryValid;
+    bool frameOpen; /* A length prefixed message is in outBuf */
 } iot_tcp_client_t;
 
 void IOT_constructor(iot_tcp_client_t *o, int *sock, IOTTcpClient_Status statusCallback);
+/** Select the wire format for the connection: JSON text (default) or
+    CBOR. Must be called before IOT_startMessageLoop.
+ */
+void IOT_setCBOR(iot_tcp_client_t *o, bool enable);
+/** Select the message framing in both directions. With framing, the
+    receive loop hands whole messages to the parser and skips
+    malformed and oversized messages instead of closing the
+    connection. Newline framing requires JSON text. Must be called
+    after IOT_setCBOR and before IOT_startMessageLoop.
+    \returns 0 or -1 if the framing cannot be used.
+ */
+int IOT_setFraming(iot_tcp_client_t *o, int framing);
+/** Encode and send a message with the JEncoder format 'fmt'. The
+    message is encoded by the writer task; the caller blocks until it
+    is sent.
+ */
 int IOT_Send(iot_tcp_client_t *o, const char *fmt, ...);
+/** Queue telemetry for the writer task without blocking. Telemetry
+    is dropped if the queue is full.
+    \returns 0, or -1 if the writer has stopped.
+ */
+int IOT_sendTelemetry(iot_tcp_client_t *o, const iot_telemetry_t *telemetry);
+/** Receive and handle commands until the connection closes or
+    IOT_stopMessageLoop is called. The calling task sleeps while no
+    data arrives. Also starts the writer task, which sends all
+    outbound messages.
+
+    May be called again with a new socket in 'sock' after the
+    connection is lost. The client keeps its buffers and its queue;
+    telemetry and error messages not sent on the old connection are
+    sent first on the new one. IOT_Send fails while disconnected.
+    Returns after the writer has released the socket, which the caller
+    then closes.
+ */
 int IOT_startMessageLoop(iot_tcp_client_t *o);
+/** Stop the message loop for good and clear 'running'; may be called
+    from any task.
+ */
 void IOT_stopMessageLoop(iot_tcp_client_t *o);
 
 #endif
\ No newline at end of file
@@ -85,3 +85,105 @@ baStrdup2(struct AllocatorIntf *a, const char *str)
       strcpy(dup, str);
    return dup;
 }
+
+
+/* Each allocation is preceded by a header holding the allocation size,
+   needed by realloc.
+*/
+#define ArenaAllocator_hdr(o, offset) ((size_t *)((o)->buf + (offset)))
+
+static void *
+ArenaAllocator_malloc(AllocatorIntf *super, size_t *size)
+{
+   ArenaAllocator *o = (ArenaAllocator *)super;
+   size_t asize = ArenaAllocator_align(*size);
+   if (asize < *size || o->cursor + ARENA_HDR_SIZE > o->size ||
+       asize > o->size - o->cursor - ARENA_HDR_SIZE)
+   {
+      return 0;
+   }
+   o->last = o->cursor;
+   *ArenaAllocator_hdr(o, o->last) = asize;
+   o->cursor += ARENA_HDR_SIZE + asize;
+   if (o->cursor > o->peak)
+      o->peak = o->cursor;
+   *size = asize;
+   return o->buf + o->last + ARENA_HDR_SIZE;
+}
+
+static void *
+ArenaAllocator_realloc(AllocatorIntf *super, void *memblock, size_t *size)
+{
+   ArenaAllocator *o = (ArenaAllocator *)super;
+   size_t offset, oldSize;
+   void *ptr;
+   if (!memblock)
+      return ArenaAllocator_malloc(super, size);
+   offset = (size_t)((U8 *)memblock - o->buf) - ARENA_HDR_SIZE;
+   oldSize = *ArenaAllocator_hdr(o, offset);
+   if (offset == o->last && o->cursor == offset + ARENA_HDR_SIZE + oldSize)
+   {
+      /* Most recent allocation: grow or shrink in place */
+      size_t asize = ArenaAllocator_align(*size);
+      if (asize < *size || asize > o->size - offset - ARENA_HDR_SIZE)
+         return 0;
+      *ArenaAllocator_hdr(o, offset) = asize;
+      o->cursor = offset + ARENA_HDR_SIZE + asize;
+      if (o->cursor > o->peak)
+         o->peak = o->cursor;
+      *size = asize;
+      return memblock;
+   }
+   if (*size <= oldSize)
+      return memblock;
+   ptr = ArenaAllocator_malloc(super, size);
+   if (ptr)
+      memcpy(ptr, memblock, oldSize);
+   return ptr;
+}
+
+static void
+ArenaAllocator_free(AllocatorIntf *super, void *memblock)
+{
+   ArenaAllocator *o = (ArenaAllocator *)super;
+   /* Only the most recent allocation can be returned to the arena */
+   if (memblock && (U8 *)memblock == o->buf + o->last + ARENA_HDR_SIZE &&
+       o->cursor == o->last + ARENA_HDR_SIZE + *ArenaAllocator_hdr(o, o->last))
+   {
+      o->cursor = o->last;
+   }
+}
+
+BA_API void
+ArenaAllocator_constructor(ArenaAllocator *o, void *buf, size_t size)
+{
+   AllocatorIntf_constructor((AllocatorIntf *)o,
+                             ArenaAllocator_malloc,
+                             ArenaAllocator_realloc,
+                             ArenaAllocator_free);
+   o->buf = (U8 *)buf;
+   o->pool = 0;
+   o->size = buf ? size : 0;
+   o->cursor = o->last = o->peak = 0;
+}
+
+BA_API void
+ArenaAllocator_constructor2(ArenaAllocator *o, AllocatorIntf *pool, size_t size)
+{
+   void *buf = AllocatorIntf_malloc(pool, &size);
+   ArenaAllocator_constructor(o, buf, size);
+   if (buf)
+      o->pool = pool;
+}
+
+BA_API void
+ArenaAllocator_destructor(ArenaAllocator *o)
+{
+   if (o->pool)
+   {
+      AllocatorIntf_free(o->pool, o->buf);
+      o->pool = 0;
+   }
+   o->buf = 0;
+   o->size = o->cursor = o->last = 0;
+}
@@ -140,6 +140,86 @@ typedef struct AllocatorIntf
    ((o)->reallocCB ? (o)->reallocCB(o, memblock, size) : 0)
 #define AllocatorIntf_free(o, memblock) (o)->freeCB(o, memblock)
 
+/** Bump pointer allocator drawing from one block of memory.
+
+    ArenaAllocator implements AllocatorIntf for data with a common
+    lifetime, such as the values created while parsing one JSON
+    message. An allocation is a pointer increment and free is a no-op
+    except for the most recent allocation, which is returned to the
+    arena. All memory is released in one O(1) call to
+    ArenaAllocator::reset. Realloc of the most recent allocation grows
+    it in place.
+
+    The block is either supplied by the caller or allocated from a
+    pool allocator by ArenaAllocator_constructor2. The arena does not
+    grow; malloc returns NULL when the block is exhausted.
+
+    The arena tracks the highest number of bytes in use since
+    construction, see ArenaAllocator::getPeak, which can be used for
+    sizing the block.
+*/
+typedef struct ArenaAllocator
+{
+#ifdef __cplusplus
+   /** Create an arena using a caller supplied block.
+       \param buf the block. Must be aligned for the data stored.
+       \param size size of buf.
+   */
+   ArenaAllocator(void *buf, size_t size);
+
+   /** Create an arena using a block allocated from 'pool'.
+       Method getSize returns 0 if the allocation failed.
+   */
+   ArenaAllocator(AllocatorIntf *pool, size_t size);
+
+   ~ArenaAllocator();
+
+   /** Release all allocations.
+    */
+   void reset();
+
+   /** Returns the number of bytes in use, including headers.
+    */
+   size_t getUsed();
+
+   /** Returns the highest number of bytes in use since construction.
+    */
+   size_t getPeak();
+
+   /** Returns the size of the block.
+    */
+   size_t getSize();
+#endif
+   AllocatorIntf super;
+   U8 *buf;
+   AllocatorIntf *pool; /* Set if buf was allocated from pool */
+   size_t size;
+   size_t cursor;
+   size_t last; /* Offset of most recent allocation */
+   size_t peak;
+} ArenaAllocator;
+
+/* Header and data are aligned to ARENA_ALIGN */
+#define ARENA_ALIGN 8
+#define ArenaAllocator_align(size) \
+   (((size) + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1))
+#define ARENA_HDR_SIZE ArenaAllocator_align(sizeof(size_t))
+/** Arena bytes used by an allocation of 'size' bytes, for sizing a
+    caller supplied block.
+*/
+#define ArenaAllocator_blockSize(size) \
+   (ARENA_HDR_SIZE + ArenaAllocator_align(size))
+
+#define ArenaAllocator_reset(o) \
+   do                           \
+   {                            \
+      (o)->cursor = 0;          \
+      (o)->last = 0;            \
+   } while (0)
+#define ArenaAllocator_getUsed(o) (o)->cursor
+#define ArenaAllocator_getPeak(o) (o)->peak
+#define ArenaAllocator_getSize(o) (o)->size
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -151,6 +231,12 @@ extern "C"
     */
    BA_API char *baStrdup2(struct AllocatorIntf *a, const char *str);
 
+   BA_API void ArenaAllocator_constructor(
+       ArenaAllocator *o, void *buf, size_t size);
+   BA_API void ArenaAllocator_constructor2(
+       ArenaAllocator *o, AllocatorIntf *pool, size_t size);
+   BA_API void ArenaAllocator_destructor(ArenaAllocator *o);
+
 #ifdef __cplusplus
 }
 inline AllocatorIntf::AllocatorIntf(AllocatorIntf_Malloc malloc,
@@ -175,6 +261,34 @@ inline void AllocatorIntf::free(void *memblock)
 {
    AllocatorIntf_free(this, memblock);
 }
+inline ArenaAllocator::ArenaAllocator(void *buf, size_t size)
+{
+   ArenaAllocator_constructor(this, buf, size);
+}
+inline ArenaAllocator::ArenaAllocator(AllocatorIntf *pool, size_t size)
+{
+   ArenaAllocator_constructor2(this, pool, size);
+}
+inline ArenaAllocator::~ArenaAllocator()
+{
+   ArenaAllocator_destructor(this);
+}
+inline void ArenaAllocator::reset()
+{
+   ArenaAllocator_reset(this);
+}
+inline size_t ArenaAllocator::getUsed()
+{
+   return ArenaAllocator_getUsed(this);
+}
+inline size_t ArenaAllocator::getPeak()
+{
+   return ArenaAllocator_getPeak(this);
+}
+inline size_t ArenaAllocator::getSize()
+{
+   return ArenaAllocator_getSize(this);
+}
 #endif
 
 #endif
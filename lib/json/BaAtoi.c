@@ -41,6 +41,60 @@
 #include "BaAtoi.h"
 #include <string.h>
 
+#ifndef NO_BAATOI_SWAR
+/* Convert 4 digits at a time using 32 bit arithmetic only, which is
+   cheap on CPUs without a 64 bit multiplier such as the Cortex-M0+.
+   The characters are assembled byte by byte, thus no alignment or
+   endianness requirements.
+*/
+#define BaAtoi_load4(s)                                 \
+   ((U32)(U8)(s)[0] | ((U32)(U8)(s)[1] << 8) |          \
+    ((U32)(U8)(s)[2] << 16) | ((U32)(U8)(s)[3] << 24))
+
+/* Non zero unless all 4 characters in w are '0' to '9' */
+#define BaAtoi_notDigits4(w)                                         \
+   ((((w) & 0xF0F0F0F0UL) |                                          \
+     ((((w) + 0x06060606UL) & 0xF0F0F0F0UL) >> 4)) != 0x33333333UL)
+
+static U32
+BaAtoi_digits4(U32 w)
+{
+   w -= 0x30303030UL;
+   w = w * 10 + (w >> 8); /* Byte 0 = d0d1, byte 2 = d2d3 */
+   return (((w & 0x00FF00FFUL) * (1 + (100UL << 16))) >> 16) & 0xFFFF;
+}
+#endif
+
+/* Convert up to 9 digits, which cannot overflow a U32 */
+static U32
+BaAtoi_u32(const char *s, const char *e)
+{
+   U32 n = 0;
+#ifndef NO_BAATOI_SWAR
+   if (e - s >= 4)
+   {
+      U32 w = BaAtoi_load4(s);
+      if (!BaAtoi_notDigits4(w))
+      {
+         n = BaAtoi_digits4(w);
+         s += 4;
+         if (e - s >= 4)
+         {
+            w = BaAtoi_load4(s);
+            if (!BaAtoi_notDigits4(w))
+            {
+               n = n * 10000 + BaAtoi_digits4(w);
+               s += 4;
+            }
+         }
+      }
+   }
+#endif
+   for (; s < e; ++s)
+      n = 10 * n + (*s - '0');
+   return n;
+}
+
 BA_API U32
 U32_negate(U32 n)
 {
@@ -61,6 +115,16 @@ U32_atoi2(const char *s, const char *e)
    }
    else
       isNegative = FALSE;
+#ifndef NO_BAATOI_SWAR
+   while (e - s >= 4)
+   {
+      U32 w = BaAtoi_load4(s);
+      if (BaAtoi_notDigits4(w))
+         break;
+      n = n * 10000 + BaAtoi_digits4(w);
+      s += 4;
+   }
+#endif
    for (; s < e && *s != '.'; ++s) /* '.' for floating point */
       n = 10 * n + (*s - '0');
    if (*s == '.' && s[1])
@@ -116,11 +180,56 @@ U64_atoll2(const char *s, const char *e)
    }
    else
       isNegative = FALSE;
+#ifndef NO_BAATOI_SWAR
+   while (e - s >= 8)
+   {
+      U32 hi = BaAtoi_load4(s);
+      U32 lo = BaAtoi_load4(s + 4);
+      if (BaAtoi_notDigits4(hi) || BaAtoi_notDigits4(lo))
+         break;
+      n = n * 100000000 + (BaAtoi_digits4(hi) * 10000 + BaAtoi_digits4(lo));
+      s += 8;
+   }
+#endif
    for (; s < e; ++s)
       n = 10 * n + (*s - '0');
    return isNegative ? (U64)(-(S64)n) : n;
 }
 
+BA_API int
+U64_atoll3(const char *s, const char *e, U64 *val)
+{
+   const char *end;
+   U64 n;
+   int len;
+   while (s < e && *s == '0')
+      s++;
+   len = (int)(e - s);
+   if (len > 20)
+      return -1;
+   /* Convert in groups of 9 digits. A 20 digit number is checked for
+      overflow before adding the last digit.
+    */
+   end = e - (len == 20);
+   len = (int)(end - s) % 9;
+   n = BaAtoi_u32(s, s + len);
+   for (s += len; s < end; s += 9)
+      n = n * 1000000000 + BaAtoi_u32(s, s + 9);
+   if (end != e)
+   {
+      /* 18446744073709551615 is the largest U64 */
+      U32 d = (U32)(*end - '0');
+      if (n > 1844674407370955161ULL ||
+          (n == 1844674407370955161ULL && d > 5))
+      {
+         return -1;
+      }
+      n = n * 10 + d;
+   }
+   *val = n;
+   return 0;
+}
+
 BA_API U64
 U64_atoll(const char *s)
 {
@@ -128,3 +237,193 @@ U64_atoll(const char *s)
       return 0;
    return U64_atoll2(s, s + strlen(s));
 }
+
+#ifndef NO_DOUBLE
+
+#define DOUBLE_POW10_MIN -64
+#define DOUBLE_POW10_MAX 64
+
+/* High 64 bits of the normalized 128 bit approximation of 10^q for q =
+   DOUBLE_POW10_MIN..DOUBLE_POW10_MAX. The values are identical to the
+   tables used by the fast_float library.
+*/
+static const U64 pow10Hi[] = {
+   0xA87FEA27A539E9A5ULL, 0xD29FE4B18E88640EULL,
+   0x83A3EEEEF9153E89ULL, 0xA48CEAAAB75A8E2BULL,
+   0xCDB02555653131B6ULL, 0x808E17555F3EBF11ULL,
+   0xA0B19D2AB70E6ED6ULL, 0xC8DE047564D20A8BULL,
+   0xFB158592BE068D2EULL, 0x9CED737BB6C4183DULL,
+   0xC428D05AA4751E4CULL, 0xF53304714D9265DFULL,
+   0x993FE2C6D07B7FABULL, 0xBF8FDB78849A5F96ULL,
+   0xEF73D256A5C0F77CULL, 0x95A8637627989AADULL,
+   0xBB127C53B17EC159ULL, 0xE9D71B689DDE71AFULL,
+   0x9226712162AB070DULL, 0xB6B00D69BB55C8D1ULL,
+   0xE45C10C42A2B3B05ULL, 0x8EB98A7A9A5B04E3ULL,
+   0xB267ED1940F1C61CULL, 0xDF01E85F912E37A3ULL,
+   0x8B61313BBABCE2C6ULL, 0xAE397D8AA96C1B77ULL,
+   0xD9C7DCED53C72255ULL, 0x881CEA14545C7575ULL,
+   0xAA242499697392D2ULL, 0xD4AD2DBFC3D07787ULL,
+   0x84EC3C97DA624AB4ULL, 0xA6274BBDD0FADD61ULL,
+   0xCFB11EAD453994BAULL, 0x81CEB32C4B43FCF4ULL,
+   0xA2425FF75E14FC31ULL, 0xCAD2F7F5359A3B3EULL,
+   0xFD87B5F28300CA0DULL, 0x9E74D1B791E07E48ULL,
+   0xC612062576589DDAULL, 0xF79687AED3EEC551ULL,
+   0x9ABE14CD44753B52ULL, 0xC16D9A0095928A27ULL,
+   0xF1C90080BAF72CB1ULL, 0x971DA05074DA7BEEULL,
+   0xBCE5086492111AEAULL, 0xEC1E4A7DB69561A5ULL,
+   0x9392EE8E921D5D07ULL, 0xB877AA3236A4B449ULL,
+   0xE69594BEC44DE15BULL, 0x901D7CF73AB0ACD9ULL,
+   0xB424DC35095CD80FULL, 0xE12E13424BB40E13ULL,
+   0x8CBCCC096F5088CBULL, 0xAFEBFF0BCB24AAFEULL,
+   0xDBE6FECEBDEDD5BEULL, 0x89705F4136B4A597ULL,
+   0xABCC77118461CEFCULL, 0xD6BF94D5E57A42BCULL,
+   0x8637BD05AF6C69B5ULL, 0xA7C5AC471B478423ULL,
+   0xD1B71758E219652BULL, 0x83126E978D4FDF3BULL,
+   0xA3D70A3D70A3D70AULL, 0xCCCCCCCCCCCCCCCCULL,
+   0x8000000000000000ULL, 0xA000000000000000ULL,
+   0xC800000000000000ULL, 0xFA00000000000000ULL,
+   0x9C40000000000000ULL, 0xC350000000000000ULL,
+   0xF424000000000000ULL, 0x9896800000000000ULL,
+   0xBEBC200000000000ULL, 0xEE6B280000000000ULL,
+   0x9502F90000000000ULL, 0xBA43B74000000000ULL,
+   0xE8D4A51000000000ULL, 0x9184E72A00000000ULL,
+   0xB5E620F480000000ULL, 0xE35FA931A0000000ULL,
+   0x8E1BC9BF04000000ULL, 0xB1A2BC2EC5000000ULL,
+   0xDE0B6B3A76400000ULL, 0x8AC7230489E80000ULL,
+   0xAD78EBC5AC620000ULL, 0xD8D726B7177A8000ULL,
+   0x878678326EAC9000ULL, 0xA968163F0A57B400ULL,
+   0xD3C21BCECCEDA100ULL, 0x84595161401484A0ULL,
+   0xA56FA5B99019A5C8ULL, 0xCECB8F27F4200F3AULL,
+   0x813F3978F8940984ULL, 0xA18F07D736B90BE5ULL,
+   0xC9F2C9CD04674EDEULL, 0xFC6F7C4045812296ULL,
+   0x9DC5ADA82B70B59DULL, 0xC5371912364CE305ULL,
+   0xF684DF56C3E01BC6ULL, 0x9A130B963A6C115CULL,
+   0xC097CE7BC90715B3ULL, 0xF0BDC21ABB48DB20ULL,
+   0x96769950B50D88F4ULL, 0xBC143FA4E250EB31ULL,
+   0xEB194F8E1AE525FDULL, 0x92EFD1B8D0CF37BEULL,
+   0xB7ABC627050305ADULL, 0xE596B7B0C643C719ULL,
+   0x8F7E32CE7BEA5C6FULL, 0xB35DBF821AE4F38BULL,
+   0xE0352F62A19E306EULL, 0x8C213D9DA502DE45ULL,
+   0xAF298D050E4395D6ULL, 0xDAF3F04651D47B4CULL,
+   0x88D8762BF324CD0FULL, 0xAB0E93B6EFEE0053ULL,
+   0xD5D238A4ABE98068ULL, 0x85A36366EB71F041ULL,
+   0xA70C3C40A64E6C51ULL, 0xD0CF4B50CFE20765ULL,
+   0x82818F1281ED449FULL, 0xA321F2D7226895C7ULL,
+   0xCBEA6F8CEB02BB39ULL, 0xFEE50B7025C36A08ULL,
+   0x9F4F2726179A2245ULL, 0xC722F0EF9D80AAD6ULL,
+   0xF8EBAD2B84E0D58BULL, 0x9B934C3B330C8577ULL,
+   0xC2781F49FFCFA6D5ULL,
+};
+
+static const U64 pow10U64[] = {
+   1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+   10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+   100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+   100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+   100000000000000000ULL, 1000000000000000000ULL,
+   10000000000000000000ULL};
+
+/* 64 x 64 -> 128 bit multiplication using 32 bit multiplies */
+static U64
+U64_mul128(U64 a, U64 b, U64 *lo)
+{
+   U64 aLo = (U32)a, aHi = a >> 32;
+   U64 bLo = (U32)b, bHi = b >> 32;
+   U64 ll = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+   U64 mid = (ll >> 32) + (U32)lh + (U32)hl;
+   *lo = (mid << 32) | (U32)ll;
+   return hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+}
+
+/* Eisel-Lemire: m * 10^exp10 correctly rounded. Returns -1 when the
+   result cannot be decided with the 64 bit power table.
+*/
+static int
+Double_eiselLemire(U64 m, int exp10, double *d)
+{
+   union
+   {
+      double d;
+      U64 u;
+   } u;
+   U64 xHi, xLo, mant;
+   int clz = 0, exp2, msb;
+   if (exp10 < DOUBLE_POW10_MIN || exp10 > DOUBLE_POW10_MAX)
+      return -1;
+   while (!(m & 0xFFFFFFFF00000000ULL))
+   {
+      m <<= 32;
+      clz += 32;
+   }
+   while (!(m & 0x8000000000000000ULL))
+   {
+      m <<= 1;
+      clz++;
+   }
+   /* floor(exp10 * log2(10)) + 64 + bias - clz */
+   exp2 = (217706 * exp10 - (exp10 < 0 ? 65535 : 0)) / 65536 +
+          64 + 1023 - clz;
+   xHi = U64_mul128(m, pow10Hi[exp10 - DOUBLE_POW10_MIN], &xLo);
+   /* The low half of the power could carry into the result */
+   if ((xHi & 0x1FF) == 0x1FF && xLo + m < m)
+      return -1;
+   msb = (int)(xHi >> 63);
+   mant = xHi >> (msb + 9);
+   exp2 -= 1 ^ msb;
+   /* Half way between two doubles */
+   if (xLo == 0 && (xHi & 0x1FF) == 0 && (mant & 3) == 1)
+      return -1;
+   mant += mant & 1;
+   mant >>= 1;
+   if (mant >> 53)
+   {
+      mant >>= 1;
+      exp2++;
+   }
+   if (exp2 <= 0 || exp2 >= 0x7FF)
+      return -1;
+   u.u = ((U64)exp2 << 52) | (mant & 0x000FFFFFFFFFFFFFULL);
+   *d = u.d;
+   return 0;
+}
+
+BA_API int
+Double_atof3(const char *s, U32 intDigits, U32 fracDigits, int exp10,
+             double *d)
+{
+   const char *frac = s + intDigits + 1;
+   U64 m;
+   exp10 -= (int)fracDigits;
+   while (intDigits && *s == '0')
+   {
+      s++;
+      intDigits--;
+   }
+   if (!intDigits)
+   {
+      while (fracDigits && *frac == '0')
+      {
+         frac++;
+         fracDigits--;
+      }
+   }
+   if (intDigits + fracDigits > 19)
+      return -1;
+   m = U64_atoll2(s, s + intDigits);
+   if (fracDigits)
+      m = m * pow10U64[fracDigits] + U64_atoll2(frac, frac + fracDigits);
+   if (!m)
+   {
+      *d = 0.0;
+      return 0;
+   }
+   /* Exact when both the mantissa and the exponent are small */
+   if (!exp10 && m <= 0x20000000000000ULL)
+   {
+      *d = (double)m;
+      return 0;
+   }
+   return Double_eiselLemire(m, exp10, d);
+}
+
+#endif /* NO_DOUBLE */
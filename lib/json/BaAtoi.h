@@ -56,6 +56,13 @@ extern "C"
     BA_API U64 U64_atoll(const char *s);
     BA_API U64 U64_atoll2(const char *s, const char *e);
 
+    /** Converts the digits from 's' to end 'e' to type U64 and checks
+        for overflow. The range must contain digits only, without a
+        sign. Returns 0 on success and -1 if the number does not fit
+        in a U64.
+    */
+    BA_API int U64_atoll3(const char *s, const char *e, U64 *val);
+
 #define S64_atoll(s) ((S64)U64_atoll(s))
 
     /** Negates a 32 bit number.
@@ -75,6 +82,18 @@ extern "C"
         Returns 0 if unable to convert or s is NULL.
      */
     BA_API U32 U32_hextoi(const char *s);
+
+#ifndef NO_DOUBLE
+    /** Converts a decimal number to a double without rescanning the
+        digits. The number is the 'intDigits' digits at 's', optionally
+        followed by '.' and 'fracDigits' digits, times 10^exp10.
+        Returns 0 on success and -1 if the number has more than 19
+        significant digits or cannot be rounded exactly by the fast
+        path. Use atof as fallback in that case.
+    */
+    BA_API int Double_atof3(const char *s, U32 intDigits, U32 fracDigits,
+                            int exp10, double *d);
+#endif
 #ifdef __cplusplus
 }
 #endif
@@ -170,6 +170,55 @@ BufPrint_putc(BufPrint *o, int c)
    return 0;
 }
 
+static const char digitPairs[201] =
+   "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+   "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+   "8081828384858687888990919293949596979899";
+
+/* Writes the decimal digits of 'val' backwards, two per division,
+   ending at 'end'. Returns the first digit.
+*/
+static char *
+BufPrint_u32Digits(char *end, U32 val)
+{
+   while (val >= 100)
+   {
+      U32 r = val % 100;
+      val /= 100;
+      end -= 2;
+      end[0] = digitPairs[r * 2];
+      end[1] = digitPairs[r * 2 + 1];
+   }
+   if (val >= 10)
+   {
+      end -= 2;
+      end[0] = digitPairs[val * 2];
+      end[1] = digitPairs[val * 2 + 1];
+   }
+   else
+      *--end = (char)('0' + val);
+   return end;
+}
+
+/* As BufPrint_u32Digits. 64 bit division is a library call on 32 bit
+   CPUs; it is only used for splitting off 9 digit groups of large
+   values.
+*/
+static char *
+BufPrint_u64Digits(char *end, U64 val)
+{
+   while (val > 0xFFFFFFFF)
+   {
+      U32 low = (U32)(val % 1000000000);
+      char *ptr = BufPrint_u32Digits(end, low);
+      val /= 1000000000;
+      end -= 9;
+      while (ptr > end)
+         *--ptr = '0';
+   }
+   return BufPrint_u32Digits(end, (U32)val);
+}
+
 static int
 BufPrint_fmtLongLong(char **bufPtr, int *len, U64 val64,
                      unsigned radix, int fmtAsSigned)
@@ -177,11 +226,18 @@ BufPrint_fmtLongLong(char **bufPtr, int *len, U64 val64,
    int isNegative;
    if (fmtAsSigned && (S64)val64 < 0)
    {
-      val64 = -(S64)val64;
+      val64 = (U64)0 - val64;
       isNegative = TRUE;
    }
    else
       isNegative = FALSE;
+   if (radix == 10)
+   {
+      char *end = *bufPtr;
+      *bufPtr = BufPrint_u64Digits(end, val64);
+      *len += (int)(end - *bufPtr);
+      return isNegative;
+   }
    do
    {
       char r = (U8)(val64 % radix);
@@ -229,6 +285,23 @@ BufPrint_write(BufPrint *o, const void *buf, int len)
       len = (int)strlen((const char *)buf);
    if (len)
    {
+      if ((o->cursor + len) > o->bufSize && o->writevCB)
+      {
+         /* Send the buffered data and 'buf' without copying 'buf' */
+         BufPrintSeg seg[2];
+         int segLen = 0;
+         if (o->cursor)
+         {
+            seg[0].data = o->buf;
+            seg[0].len = o->cursor;
+            segLen = 1;
+         }
+         seg[segLen].data = buf;
+         seg[segLen].len = len;
+         retVal = o->writevCB(o, seg, segLen + 1);
+         o->cursor = 0;
+         return retVal;
+      }
       if ((o->cursor + len) > o->bufSize && o->cursor)
          if ((retVal = o->flushCB(o, o->cursor + len + 1 - o->bufSize)) != 0)
             return retVal;
@@ -257,226 +330,697 @@ BufPrint_write(BufPrint *o, const void *buf, int len)
    return retVal;
 }
 
-BA_API int
-BufPrint_b64Encode(BufPrint *o, const void *source, S32 slen)
-{
-   static const char b64alpha[] = {
-       "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"};
+static const char b64Alpha[] = {
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"};
+static const char b64urlAlpha[] = {
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"};
 
-   const U8 *src = (const U8 *)source;
+#define BufPrint_b64Group(d, alpha, v) \
+   (d)[0] = alpha[(v) >> 18],          \
+   (d)[1] = alpha[((v) >> 12) & 0x3F], \
+   (d)[2] = alpha[((v) >> 6) & 0x3F],  \
+   (d)[3] = alpha[(v) & 0x3F]
 
+/* Encodes whole 3 byte groups directly into the buffer, flushing
+   when full, and ends with a partial group.
+*/
+static int
+BufPrint_b64Enc(BufPrint *o, const U8 *src, S32 slen, const char *alpha,
+                BaBool padding)
+{
+   char tail[4];
    while (slen >= 3)
    {
-      if (BufPrint_putc(o, b64alpha[*src >> 2]) < 0 ||
-          BufPrint_putc(o, b64alpha[(*src & 0x03) << 4 | src[1] >> 4]) < 0 ||
-          BufPrint_putc(o, b64alpha[(src[1] & 0x0F) << 2 | src[2] >> 6]) < 0 ||
-          BufPrint_putc(o, b64alpha[src[2] & 0x3F]) < 0)
+      S32 groups = (o->bufSize - o->cursor) / 4;
+      if (!groups)
       {
-         return -1;
+         if (o->flushCB(o, 4))
+            return -1;
+         groups = (o->bufSize - o->cursor) / 4;
+      }
+      if (groups)
+      {
+         char *d = o->buf + o->cursor;
+         if (groups > slen / 3)
+            groups = slen / 3;
+         o->cursor += groups * 4;
+         slen -= groups * 3;
+         for (; groups; groups--, src += 3, d += 4)
+         {
+            U32 v = (U32)src[0] << 16 | (U32)src[1] << 8 | src[2];
+            BufPrint_b64Group(d, alpha, v);
+         }
+      }
+      else /* Buffer smaller than one group */
+      {
+         U32 v = (U32)src[0] << 16 | (U32)src[1] << 8 | src[2];
+         BufPrint_b64Group(tail, alpha, v);
+         if (BufPrint_write(o, tail, 4) < 0)
+            return -1;
+         src += 3;
+         slen -= 3;
       }
-      src += 3;
-      slen -= 3;
    }
-   switch (slen)
+   if (slen)
    {
-   case 2:
-      if (BufPrint_putc(o, b64alpha[src[0] >> 2]) < 0 ||
-          BufPrint_putc(o, b64alpha[(src[0] & 0x03) << 4 | src[1] >> 4]) < 0 ||
-          BufPrint_putc(o, b64alpha[(src[1] & 0x0F) << 2]) < 0 ||
-          BufPrint_putc(o, (U8)'=') < 0)
+      U32 v = (U32)src[0] << 16 | (slen == 2 ? (U32)src[1] << 8 : 0);
+      BufPrint_b64Group(tail, alpha, v);
+      if (padding)
       {
-         return -1;
+         tail[3] = '=';
+         if (slen == 1)
+            tail[2] = '=';
+         return BufPrint_write(o, tail, 4) < 0 ? -1 : 0;
       }
-      break;
+      return BufPrint_write(o, tail, slen + 1) < 0 ? -1 : 0;
+   }
+   return 0;
+}
+
+BA_API int
+BufPrint_b64Encode(BufPrint *o, const void *source, S32 slen)
+{
+   return BufPrint_b64Enc(o, (const U8 *)source, slen, b64Alpha, TRUE);
+}
+
+BA_API int
+BufPrint_b64urlEncode(BufPrint *o, const void *source, S32 slen, BaBool padding)
+{
+   return BufPrint_b64Enc(o, (const U8 *)source, slen, b64urlAlpha, padding);
+}
 
-   case 1:
-      if (BufPrint_putc(o, b64alpha[src[0] >> 2]) < 0 ||
-          BufPrint_putc(o, b64alpha[(src[0] & 0x03) << 4]) < 0 ||
-          BufPrint_write(o, "==", 2) < 0)
+/* Base64 decode table for both alphabets. 0x80: invalid, 0x40: '=' */
+static const U8 b64DecTab[256] = {
+   0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+   0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+   0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 62, 0x80, 62, 0x80, 63,
+   52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 0x80, 0x80, 0x80, 0x40, 0x80, 0x80,
+   0x80, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+   15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 0x80, 0x80, 0x80, 0x80, 63,
+   0x80, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+   41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 0x80, 0x80, 0x80, 0x80, 0x80,
+   0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+   0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+   0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+   0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+   0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+   0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+   0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+   0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80
+};
+
+BA_API int
+B64Decoder_decode(B64Decoder *o, const void *src, int len, U8 *dest)
+{
+   const U8 *ptr = (const U8 *)src;
+   const U8 *end = ptr + len;
+   U8 *d = dest;
+   while (ptr < end)
+   {
+      U8 v;
+      /* Fast path: whole groups of four valid characters */
+      while (!o->count && end - ptr >= 4)
       {
+         U8 a = b64DecTab[ptr[0]], b = b64DecTab[ptr[1]];
+         U8 c = b64DecTab[ptr[2]], e = b64DecTab[ptr[3]];
+         U32 bits;
+         if ((a | b | c | e) & 0xC0)
+            break;
+         bits = (U32)a << 18 | (U32)b << 12 | (U32)c << 6 | e;
+         d[0] = (U8)(bits >> 16);
+         d[1] = (U8)(bits >> 8);
+         d[2] = (U8)bits;
+         d += 3;
+         ptr += 4;
+      }
+      if (ptr == end)
+         break;
+      v = b64DecTab[*ptr++];
+      if (v & 0x80)
          return -1;
+      if (v & 0x40)
+      {
+         /* One '=' after three characters, two after two */
+         if (o->count < 2 || o->count + o->pad == 4)
+            return -1;
+         o->pad++;
+         continue;
+      }
+      if (o->pad) /* Data after padding */
+         return -1;
+      o->bits = o->bits << 6 | v;
+      if (++o->count == 4)
+      {
+         d[0] = (U8)(o->bits >> 16);
+         d[1] = (U8)(o->bits >> 8);
+         d[2] = (U8)o->bits;
+         d += 3;
+         o->count = 0;
+         o->bits = 0;
       }
-      break;
-
-   default:
-      baAssert(slen == 0);
    }
-   return 0;
+   return (int)(d - dest);
 }
 
 BA_API int
-BufPrint_b64urlEncode(BufPrint *o, const void *source, S32 slen, BaBool padding)
+B64Decoder_end(B64Decoder *o, U8 *dest)
 {
-   static const char b64alpha[] = {
-       "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"};
+   int len;
+   switch (o->count)
+   {
+      case 0:
+         len = 0;
+         break;
+      case 2:
+         len = o->pad == 0 || o->pad == 2 ? 1 : -1;
+         dest[0] = (U8)(o->bits >> 4);
+         break;
+      case 3:
+         len = o->pad < 2 ? 2 : -1;
+         dest[0] = (U8)(o->bits >> 10);
+         dest[1] = (U8)(o->bits >> 2);
+         break;
+      default:
+         len = -1;
+   }
+   B64Decoder_constructor(o);
+   return len;
+}
+
+/* JSON string escape table. 0: copy as is, 'u': \u00XX escape,
+   'U': UTF-8 lead or continuation byte, otherwise the character
+   following the backslash. A single quote is copied as is; \' is
+   not a valid JSON escape.
+*/
+static const char jsonEscTab[256] = {
+   'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+   'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+   0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '/',
+   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 'u',
+   'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U',
+   'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U',
+   'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U',
+   'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U',
+   'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U',
+   'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U',
+   'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U',
+   'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U', 'U'
+};
 
-   const U8 *src = (const U8 *)source;
+static const char hexDigits[] = "0123456789abcdef";
 
-   while (slen >= 3)
+static int
+BufPrint_uEscape(BufPrint *o, unsigned long uc)
+{
+   char buf[6];
+   buf[0] = '\\';
+   buf[1] = 'u';
+   buf[2] = hexDigits[(uc >> 12) & 0xf];
+   buf[3] = hexDigits[(uc >> 8) & 0xf];
+   buf[4] = hexDigits[(uc >> 4) & 0xf];
+   buf[5] = hexDigits[uc & 0xf];
+   return BufPrint_write(o, buf, 6);
+}
+
+/* Escape the UTF-8 sequence at 'str' as \uXXXX and set 'len' to the
+   number of bytes consumed. Invalid sequences are escaped byte by byte.
+*/
+static int
+BufPrint_utf8Escape(BufPrint *o, const U8 *str, int *len)
+{
+   unsigned long uc = str[0];
+   *len = 1;
+   if (uc >= 0xc0 && uc < 0xe0)
    {
-      if (BufPrint_putc(o, b64alpha[*src >> 2]) < 0 ||
-          BufPrint_putc(o, b64alpha[(*src & 0x03) << 4 | src[1] >> 4]) < 0 ||
-          BufPrint_putc(o, b64alpha[(src[1] & 0x0F) << 2 | src[2] >> 6]) < 0 ||
-          BufPrint_putc(o, b64alpha[src[2] & 0x3F]) < 0)
+      if ((str[1] & 0xc0) == 0x80)
       {
-         return -1;
+         uc = ((uc & 0x1f) << 6) | (str[1] & 0x3f);
+         *len = 2;
       }
-      src += 3;
-      slen -= 3;
    }
-   switch (slen)
+   else if (uc >= 0xe0 && uc < 0xf0)
    {
-   case 2:
-      if (BufPrint_putc(o, b64alpha[src[0] >> 2]) < 0 ||
-          BufPrint_putc(o, b64alpha[(src[0] & 0x03) << 4 | src[1] >> 4]) < 0 ||
-          BufPrint_putc(o, b64alpha[(src[1] & 0x0F) << 2]) < 0 ||
-          (padding ? BufPrint_putc(o, (U8)'=') : 0) < 0)
+      if ((str[1] & 0xc0) == 0x80 && (str[2] & 0xc0) == 0x80)
       {
-         return -1;
+         uc = ((uc & 0x0f) << 12) | ((str[1] & 0x3f) << 6) | (str[2] & 0x3f);
+         *len = 3;
       }
-      break;
-
-   case 1:
-      if (BufPrint_putc(o, b64alpha[src[0] >> 2]) < 0 ||
-          BufPrint_putc(o, b64alpha[(src[0] & 0x03) << 4]) < 0 ||
-          (padding ? BufPrint_write(o, "==", 2) : 0) < 0)
+   }
+   else if (uc >= 0xf0 && uc < 0xf8)
+   {
+      if ((str[1] & 0xc0) == 0x80 && (str[2] & 0xc0) == 0x80 &&
+          (str[3] & 0xc0) == 0x80)
       {
-         return -1;
+         uc = ((uc & 0x07) << 18) | ((str[1] & 0x3f) << 12) |
+              ((str[2] & 0x3f) << 6) | (str[3] & 0x3f);
+         *len = 4;
       }
-      break;
-
-   default:
-      baAssert(slen == 0);
    }
-   return 0;
+   if (uc < 0x10000)
+      return BufPrint_uEscape(o, uc);
+   /* UTF-16 surrogate pair */
+   uc -= 0x10000;
+   if (BufPrint_uEscape(o, 0xd800 | ((uc >> 10) & 0x3ff)) < 0)
+      return -1;
+   return BufPrint_uEscape(o, 0xdc00 | (uc & 0x3ff));
 }
 
 BA_API int
 BufPrint_jsonString(BufPrint *o, const char *str)
 {
+   const U8 *ptr = (const U8 *)str;
    BufPrint_putcMacro(o, '"');
-   while (*str)
+   for (;;)
+   {
+      /* Copy the longest run of characters not requiring escaping */
+      const U8 *run = ptr;
+      char esc;
+      int len;
+      while (!(esc = jsonEscTab[*ptr]))
+         ptr++;
+      if (ptr != run && BufPrint_write(o, run, (int)(ptr - run)) < 0)
+         return -1;
+      if (!*ptr)
+         break;
+      if (esc == 'U')
+      {
+         if (BufPrint_utf8Escape(o, ptr, &len) < 0)
+            return -1;
+         ptr += len;
+         continue;
+      }
+      if (esc == 'u')
+      {
+         if (BufPrint_uEscape(o, *ptr) < 0)
+            return -1;
+      }
+      else
+      {
+         char buf[2];
+         buf[0] = '\\';
+         buf[1] = esc;
+         if (BufPrint_write(o, buf, 2) < 0)
+            return -1;
+      }
+      ptr++;
+   }
+   BufPrint_putcMacro(o, '"');
+   return 0;
+}
+
+#ifndef NO_DOUBLE
+
+/* Shortest round-trip double formatting using the Grisu2 algorithm by
+ * Florian Loitsch, "Printing Floating-Point Numbers Quickly and
+ * Accurately with Integers", PLDI 2010. The output parses back to the
+ * same double, and is the shortest such string for all but a few
+ * values.
+ */
+
+typedef struct
+{
+   U64 f;
+   int e;
+} DiyFp;
+
+#define DP_SIGNIFICAND_SIZE 52
+#define DP_EXPONENT_BIAS (0x3FF + DP_SIGNIFICAND_SIZE)
+#define DP_HIDDEN_BIT 0x0010000000000000ULL
+#define DP_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+
+/* Normalized 10^k for k = -348, -340, ..., 340 */
+static const U64 cachedPowersF[] = {
+   0xFA8FD5A0081C0288ULL, 0xBAAEE17FA23EBF76ULL,
+   0x8B16FB203055AC76ULL, 0xCF42894A5DCE35EAULL,
+   0x9A6BB0AA55653B2DULL, 0xE61ACF033D1A45DFULL,
+   0xAB70FE17C79AC6CAULL, 0xFF77B1FCBEBCDC4FULL,
+   0xBE5691EF416BD60CULL, 0x8DD01FAD907FFC3CULL,
+   0xD3515C2831559A83ULL, 0x9D71AC8FADA6C9B5ULL,
+   0xEA9C227723EE8BCBULL, 0xAECC49914078536DULL,
+   0x823C12795DB6CE57ULL, 0xC21094364DFB5637ULL,
+   0x9096EA6F3848984FULL, 0xD77485CB25823AC7ULL,
+   0xA086CFCD97BF97F4ULL, 0xEF340A98172AACE5ULL,
+   0xB23867FB2A35B28EULL, 0x84C8D4DFD2C63F3BULL,
+   0xC5DD44271AD3CDBAULL, 0x936B9FCEBB25C996ULL,
+   0xDBAC6C247D62A584ULL, 0xA3AB66580D5FDAF6ULL,
+   0xF3E2F893DEC3F126ULL, 0xB5B5ADA8AAFF80B8ULL,
+   0x87625F056C7C4A8BULL, 0xC9BCFF6034C13053ULL,
+   0x964E858C91BA2655ULL, 0xDFF9772470297EBDULL,
+   0xA6DFBD9FB8E5B88FULL, 0xF8A95FCF88747D94ULL,
+   0xB94470938FA89BCFULL, 0x8A08F0F8BF0F156BULL,
+   0xCDB02555653131B6ULL, 0x993FE2C6D07B7FACULL,
+   0xE45C10C42A2B3B06ULL, 0xAA242499697392D3ULL,
+   0xFD87B5F28300CA0EULL, 0xBCE5086492111AEBULL,
+   0x8CBCCC096F5088CCULL, 0xD1B71758E219652CULL,
+   0x9C40000000000000ULL, 0xE8D4A51000000000ULL,
+   0xAD78EBC5AC620000ULL, 0x813F3978F8940984ULL,
+   0xC097CE7BC90715B3ULL, 0x8F7E32CE7BEA5C70ULL,
+   0xD5D238A4ABE98068ULL, 0x9F4F2726179A2245ULL,
+   0xED63A231D4C4FB27ULL, 0xB0DE65388CC8ADA8ULL,
+   0x83C7088E1AAB65DBULL, 0xC45D1DF942711D9AULL,
+   0x924D692CA61BE758ULL, 0xDA01EE641A708DEAULL,
+   0xA26DA3999AEF774AULL, 0xF209787BB47D6B85ULL,
+   0xB454E4A179DD1877ULL, 0x865B86925B9BC5C2ULL,
+   0xC83553C5C8965D3DULL, 0x952AB45CFA97A0B3ULL,
+   0xDE469FBD99A05FE3ULL, 0xA59BC234DB398C25ULL,
+   0xF6C69A72A3989F5CULL, 0xB7DCBF5354E9BECEULL,
+   0x88FCF317F22241E2ULL, 0xCC20CE9BD35C78A5ULL,
+   0x98165AF37B2153DFULL, 0xE2A0B5DC971F303AULL,
+   0xA8D9D1535CE3B396ULL, 0xFB9B7CD9A4A7443CULL,
+   0xBB764C4CA7A44410ULL, 0x8BAB8EEFB6409C1AULL,
+   0xD01FEF10A657842CULL, 0x9B10A4E5E9913129ULL,
+   0xE7109BFBA19C0C9DULL, 0xAC2820D9623BF429ULL,
+   0x80444B5E7AA7CF85ULL, 0xBF21E44003ACDD2DULL,
+   0x8E679C2F5E44FF8FULL, 0xD433179D9C8CB841ULL,
+   0x9E19DB92B4E31BA9ULL, 0xEB96BF6EBADF77D9ULL,
+   0xAF87023B9BF0EE6BULL,
+};
+
+static const S16 cachedPowersE[] = {
+   -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+   -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+   -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+   -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+   -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+   109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+   375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+   641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+   907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+static const U32 pow10Tab32[] = {
+   1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+   1000000000};
+
+static DiyFp
+DiyFp_mul(DiyFp x, DiyFp y)
+{
+   DiyFp r;
+   const U64 m32 = 0xFFFFFFFFULL;
+   U64 a = x.f >> 32, b = x.f & m32;
+   U64 c = y.f >> 32, d = y.f & m32;
+   U64 ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+   U64 tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+   tmp += 1U << 31; /* Round */
+   r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+   r.e = x.e + y.e + 64;
+   return r;
+}
+
+static DiyFp
+DiyFp_normalize(DiyFp x)
+{
+   while (!(x.f & 0xFFFFFFFF00000000ULL))
+   {
+      x.f <<= 32;
+      x.e -= 32;
+   }
+   while (!(x.f & 0x8000000000000000ULL))
+   {
+      x.f <<= 1;
+      x.e--;
+   }
+   return x;
+}
+
+static void
+BufPrint_grisuRound(char *buf, int len, U64 delta, U64 rest,
+                    U64 tenKappa, U64 wpW)
+{
+   while (rest < wpW && delta - rest >= tenKappa &&
+          (rest + tenKappa < wpW || wpW - rest > rest + tenKappa - wpW))
+   {
+      buf[len - 1]--;
+      rest += tenKappa;
+   }
+}
+
+/* Generate the shortest digits in [Wm, Wp] and return the number of
+ * digits. The value is buf * 10^K.
+ */
+static int
+BufPrint_digitGen(DiyFp w, DiyFp mp, U64 delta, char *buf, int *K)
+{
+   const int shift = -mp.e;
+   const U64 one = (U64)1 << shift;
+   U64 wpW = mp.f - w.f;
+   U32 p1 = (U32)(mp.f >> shift);
+   U64 p2 = mp.f & (one - 1);
+   U64 unit = 1;
+   int kappa = 10;
+   int len = 0;
+   while (kappa > 1 && p1 < pow10Tab32[kappa - 1])
+      kappa--;
+   while (kappa > 0)
+   {
+      U32 d = p1 / pow10Tab32[kappa - 1];
+      U64 rest;
+      p1 %= pow10Tab32[kappa - 1];
+      if (d || len)
+         buf[len++] = (char)('0' + d);
+      kappa--;
+      rest = ((U64)p1 << shift) + p2;
+      if (rest <= delta)
+      {
+         *K += kappa;
+         BufPrint_grisuRound(
+            buf, len, delta, rest, (U64)pow10Tab32[kappa] << shift, wpW);
+         return len;
+      }
+   }
+   for (;;)
    {
-      if (*str < ' ' || *str == '"')
+      U32 d;
+      p2 *= 10;
+      delta *= 10;
+      unit *= 10;
+      d = (U32)(p2 >> shift);
+      if (d || len)
+         buf[len++] = (char)('0' + d);
+      p2 &= one - 1;
+      kappa--;
+      if (p2 < delta)
       {
-         if (*str > 0)
+         *K += kappa;
+         BufPrint_grisuRound(buf, len, delta, p2, one, wpW * unit);
+         return len;
+      }
+   }
+}
+
+/* Grisu2 for a positive finite 'value' */
+static int
+BufPrint_grisu2(double value, char *buf, int *K)
+{
+   union
+   {
+      double d;
+      U64 u;
+   } u;
+   DiyFp v, w, mPlus, mMinus, cMk;
+   int biasedE, k, ix;
+   u.d = value;
+   biasedE = (int)((u.u >> DP_SIGNIFICAND_SIZE) & 0x7FF);
+   v.f = u.u & DP_SIGNIFICAND_MASK;
+   if (biasedE)
+   {
+      v.f += DP_HIDDEN_BIT;
+      v.e = biasedE - DP_EXPONENT_BIAS;
+   }
+   else
+      v.e = 1 - DP_EXPONENT_BIAS;
+
+   /* Boundaries m+ and m-, with m- using the exponent of m+ */
+   mPlus.f = (v.f << 1) + 1;
+   mPlus.e = v.e - 1;
+   mPlus = DiyFp_normalize(mPlus);
+   if (v.f == DP_HIDDEN_BIT)
+   {
+      mMinus.f = (v.f << 2) - 1;
+      mMinus.e = v.e - 2;
+   }
+   else
+   {
+      mMinus.f = (v.f << 1) - 1;
+      mMinus.e = v.e - 1;
+   }
+   mMinus.f <<= mMinus.e - mPlus.e;
+   mMinus.e = mPlus.e;
+
+   /* Find a cached power 10^-K scaling m+ into [2^-60, 2^-32]. The
+    * fixed point 78913 / 2^18 approximates log10(2).
+    */
+   k = -61 - mPlus.e;
+   k = k * 78913 / (1 << 18) + (k > 0) + 347;
+   ix = (k >> 3) + 1;
+   *K = -(-348 + ix * 8);
+   cMk.f = cachedPowersF[ix];
+   cMk.e = cachedPowersE[ix];
+
+   w = DiyFp_mul(DiyFp_normalize(v), cMk);
+   mPlus = DiyFp_mul(mPlus, cMk);
+   mMinus = DiyFp_mul(mMinus, cMk);
+   mMinus.f++;
+   mPlus.f--;
+   return BufPrint_digitGen(w, mPlus, mPlus.f - mMinus.f, buf, K);
+}
+
+/* Fast path for values with at most 4 decimals such as sensor
+ * readings. Returns the number of digits and sets *K, or 0.
+ */
+static int
+BufPrint_fixedDigits(double value, char *buf, int *K)
+{
+   static const double pow10Dbl[] = {1.0, 10.0, 100.0, 1000.0, 10000.0};
+   int k;
+   if (value >= 1e9 || value < 1e-4)
+      return 0;
+   for (k = 0; k < 5; k++)
+   {
+      U64 m = (U64)(value * pow10Dbl[k] + 0.5);
+      /* Exact when the decimal string parses back to 'value' */
+      if (m && (double)m / pow10Dbl[k] == value)
+      {
+         char tmp[20];
+         int len = 0, i = 0;
+         while (!(m % 10) && k == 0)
          {
-            switch (*str)
-            {
-            case '\b':
-               BufPrint_write(o, "\\b", 2);
-               break;
-            case '\t':
-               BufPrint_write(o, "\\t", 2);
-               break;
-            case '\n':
-               BufPrint_write(o, "\\n", 2);
-               break;
-            case '\v':
-               BufPrint_write(o, "\\v", 2);
-               break;
-            case '\f':
-               BufPrint_write(o, "\\f", 2);
-               break;
-            case '\r':
-               BufPrint_write(o, "\\r", 2);
-               break;
-            case '\"':
-               BufPrint_write(o, "\\\"", 2);
-               break;
-            case '\'':
-               BufPrint_write(o, "\\'", 2);
-               break;
-            default:
-               BufPrint_printf(o, "\\u%04x", (unsigned)*str);
-            }
+            m /= 10;
+            i++;
          }
-         else
+         do
          {
-            unsigned char c = str[0];
-            unsigned long uc = 0;
-            if (c < 0xc0)
-               uc = c;
-            else if (c < 0xe0)
-            {
-               if ((str[1] & 0xc0) == 0x80)
-               {
-                  uc = ((c & 0x1f) << 6) | (str[1] & 0x3f);
-                  ++str;
-               }
-               else
-                  uc = c;
-            }
-            else if (c < 0xf0)
-            {
-               if ((str[1] & 0xc0) == 0x80 &&
-                   (str[2] & 0xc0) == 0x80)
-               {
-                  uc = ((c & 0x0f) << 12) |
-                       ((str[1] & 0x3f) << 6) | (str[2] & 0x3f);
-                  str += 2;
-               }
-               else
-                  uc = c;
-            }
-            else if (c < 0xf8)
-            {
-               if ((str[1] & 0xc0) == 0x80 &&
-                   (str[2] & 0xc0) == 0x80 &&
-                   (str[3] & 0xc0) == 0x80)
-               {
-                  uc = ((c & 0x03) << 18) |
-                       ((str[1] & 0x3f) << 12) |
-                       ((str[2] & 0x3f) << 6) |
-                       (str[4] & 0x3f);
-                  str += 3;
-               }
-               else
-                  uc = c;
-            }
-            else if (c < 0xfc)
-            {
-               if ((str[1] & 0xc0) == 0x80 &&
-                   (str[2] & 0xc0) == 0x80 &&
-                   (str[3] & 0xc0) == 0x80 &&
-                   (str[4] & 0xc0) == 0x80)
-               {
-                  uc = ((c & 0x01) << 24) |
-                       ((str[1] & 0x3f) << 18) |
-                       ((str[2] & 0x3f) << 12) |
-                       ((str[4] & 0x3f) << 6) |
-                       (str[5] & 0x3f);
-                  str += 4;
-               }
-               else
-                  uc = c;
-            }
-            else
-               ++str; /* ignore */
-            if (uc < 0x10000)
-               BufPrint_printf(o, "\\u%04x", uc);
-            else
-            {
-               uc -= 0x10000;
-               BufPrint_printf(o, "\\u%04x", 0xdc00 | ((uc >> 10) & 0x3ff));
-               BufPrint_printf(o, "\\u%04x", 0xd800 | (uc & 0x3ff));
-            }
-         }
+            tmp[len++] = (char)('0' + m % 10);
+            m /= 10;
+         } while (m);
+         *K = i - k;
+         for (i = 0; i < len; i++)
+            buf[i] = tmp[len - 1 - i];
+         return len;
       }
-      else if (*str == '\\')
-         BufPrint_write(o, "\\\\", 2);
-      else if (*str == '/')
-         BufPrint_write(o, "\\/", 2);
-      else if (*str == 0x7f)
-         BufPrint_printf(o, "\\u%04x", (unsigned)*str);
-      else
-         BufPrint_putcMacro(o, *str);
-      str++;
    }
-   BufPrint_putcMacro(o, '"');
    return 0;
 }
 
+/* Format digits * 10^K the way JavaScript's Number.toString does.
+ * Returns the string length.
+ */
+static int
+BufPrint_fmtDigits(char *buf, int len, int K)
+{
+   int kk = len + K; /* Position of the decimal point */
+   int i;
+   if (K >= 0 && kk <= 21)
+   {
+      /* 1234e7 -> 12340000000 */
+      for (i = len; i < kk; i++)
+         buf[i] = '0';
+      return kk;
+   }
+   if (kk > 0 && kk <= 21)
+   {
+      /* 1234e-2 -> 12.34 */
+      memmove(buf + kk + 1, buf + kk, len - kk);
+      buf[kk] = '.';
+      return len + 1;
+   }
+   if (kk > -6 && kk <= 0)
+   {
+      /* 1234e-6 -> 0.001234 */
+      int offset = 2 - kk;
+      memmove(buf + offset, buf, len);
+      buf[0] = '0';
+      buf[1] = '.';
+      for (i = 2; i < offset; i++)
+         buf[i] = '0';
+      return len + offset;
+   }
+   /* 1234e30 -> 1.234e33 */
+   if (len > 1)
+   {
+      memmove(buf + 2, buf + 1, len - 1);
+      buf[1] = '.';
+      len++;
+   }
+   buf[len++] = 'e';
+   kk--;
+   if (kk < 0)
+   {
+      buf[len++] = '-';
+      kk = -kk;
+   }
+   if (kk >= 100)
+   {
+      buf[len++] = (char)('0' + kk / 100);
+      kk %= 100;
+      buf[len++] = (char)('0' + kk / 10);
+   }
+   else if (kk >= 10)
+      buf[len++] = (char)('0' + kk / 10);
+   buf[len++] = (char)('0' + kk % 10);
+   return len;
+}
+
+BA_API int
+BufPrint_dtoa(char *buf, double value)
+{
+   char *ptr = buf;
+   int len, K;
+   if (isNanOrInf((union UIEEE_754 *)&value))
+   {
+      memcpy(buf, "null", 4);
+      return 4;
+   }
+   if (value == 0.0)
+   {
+      *buf = '0';
+      return 1;
+   }
+   if (value < 0.0)
+   {
+      *ptr++ = '-';
+      value = -value;
+   }
+   len = BufPrint_fixedDigits(value, ptr, &K);
+   if (!len)
+      len = BufPrint_grisu2(value, ptr, &K);
+   return (int)(ptr - buf) + BufPrint_fmtDigits(ptr, len, K);
+}
+
+BA_API int
+BufPrint_fmtDouble(BufPrint *o, double value)
+{
+   char buf[BUFPRINT_DTOA_SIZE];
+   return BufPrint_write(o, buf, BufPrint_dtoa(buf, value));
+}
+
+#endif /* NO_DOUBLE */
+
+BA_API int
+BufPrint_itoa(char *buf, S64 value, int zeroPad)
+{
+   char tmp[BUFPRINT_ITOA_SIZE];
+   char *end = tmp + sizeof(tmp);
+   char *ptr = BufPrint_u64Digits(end, value < 0 ? (U64)0 - (U64)value : (U64)value);
+   while (end - ptr < zeroPad && ptr > tmp + 1)
+      *--ptr = '0';
+   if (value < 0)
+      *--ptr = '-';
+   memcpy(buf, ptr, end - ptr);
+   return (int)(end - ptr);
+}
+
+BA_API int
+BufPrint_fmtInt(BufPrint *o, S64 value, int zeroPad)
+{
+   char buf[BUFPRINT_ITOA_SIZE];
+   return BufPrint_write(o, buf, BufPrint_itoa(buf, value, zeroPad));
+}
+
 BA_API int
 BufPrint_vprintf(BufPrint *o, const char *fmt, va_list argList)
 {
@@ -624,8 +1168,10 @@ BufPrint_vprintf(BufPrint *o, const char *fmt, va_list argList)
                   val = (unsigned long)va_arg(argList, int);
                else if (flags & FLAG_LONG)
                   val = (unsigned long)va_arg(argList, long);
-               else
+               else if (*fmt == 'd' || *fmt == 'i')
                   val = (unsigned long)va_arg(argList, int);
+               else /* Do not sign extend where long is 64 bit */
+                  val = va_arg(argList, unsigned int);
                if (precision == 0 && val == 0)
                {
                   fmt++;
@@ -642,7 +1188,7 @@ BufPrint_vprintf(BufPrint *o, const char *fmt, va_list argList)
                }
                else if (!(flags & FLAG_LONG_LONG) && (long)val < 0)
                {
-                  val = -(long)val;
+                  val = (size_t)0 - val;
                   prefix = "-";
                   prefixLen = 1;
                }
@@ -658,13 +1204,9 @@ BufPrint_vprintf(BufPrint *o, const char *fmt, va_list argList)
                }
                if (!(flags & FLAG_LONG_LONG))
                {
-                  do
-                  {
-                     int r = val % 10U;
-                     val /= 10U;
-                     *--bufPtr = (char)('0' + r);
-                     bufLen++;
-                  } while (val);
+                  char *end = bufPtr;
+                  bufPtr = BufPrint_u64Digits(end, val);
+                  bufLen += (int)(end - bufPtr);
                }
             }
             else
@@ -724,12 +1266,21 @@ BufPrint_vprintf(BufPrint *o, const char *fmt, va_list argList)
                                              ? 10U
                                          : (*fmt == 'o') ? 8U
                                                          : 16U;
-                  do
+                  if (radix == 10)
                   {
-                     *--bufPtr = acDigits[val % radix];
-                     val /= radix;
-                     bufLen++;
-                  } while (val);
+                     char *end = bufPtr;
+                     bufPtr = BufPrint_u64Digits(end, val);
+                     bufLen += (int)(end - bufPtr);
+                  }
+                  else
+                  {
+                     do
+                     {
+                        *--bufPtr = acDigits[val % radix];
+                        val /= radix;
+                        bufLen++;
+                     } while (val);
+                  }
                }
 
                if ((flags & FLAG_ALTERNATE) && *bufPtr != '0')
@@ -110,6 +110,31 @@ BufPrint::flush
 */
 typedef int (*BufPrint_Flush)(struct BufPrint *o, int sizeRequired);
 
+/** A data segment passed to the #BufPrint_WriteV callback.
+ */
+typedef struct
+{
+   const void *data;
+   int len;
+} BufPrintSeg;
+
+/** BufPrint scatter-gather callback function.
+
+When installed with #BufPrint::setWriteV, BufPrint::write calls this
+callback instead of the flush callback when the data does not fit in
+the space left in the buffer. The callback receives the buffered data,
+if any, followed by the data passed to write, and must send all
+segments. The data passed to write is thereby never staged in the
+buffer. The buffer is reset when the callback returns.
+
+\param o the object.
+\param seg the segments; one or two.
+\param segLen the number of segments.
+\returns 0 on success or a negative value on error.
+*/
+typedef int (*BufPrint_WriteV)(
+    struct BufPrint *o, const BufPrintSeg *seg, int segLen);
+
 /** The BufPrint class, which implements an ANSI compatible printf
     method, is a base class used by several other classes.
 
@@ -214,14 +239,14 @@ typedef struct BufPrint
    int flush();
 
    /** Encode binary data as Base64.
-       \sa baB64Decode
+       \sa B64Decoder
        \param data binary data or string to be encoded as B64.
        \param slen the data size.
    */
    int b64Encode(const void *data, S32 slen);
 
    /** Encode binary data as Base64url.
-       \sa baB64Decode
+       \sa B64Decoder
        \param data binary data or string to be encoded as B64.
        \param slen the data size.
        \param padding add padding characters.
@@ -240,8 +265,30 @@ typedef struct BufPrint
        \sa BufPrint::printf with format flag j
    */
    int jsonString(const char *str);
+
+   /** Print a double using the shortest representation that parses
+       back to the same value, e.g. 21.5 and not 21.500000. NaN and
+       Inf are printed as null. The output is valid JSON.
+       \sa BufPrint_dtoa
+   */
+   int fmtDouble(double value);
+
+   /** Print an integer; a fast alternative to printf with the %d,
+       %lld, and %02d format flags.
+       \param value the integer.
+       \param zeroPad the minimum number of digits, padded with
+       leading zeros, or 0.
+       \sa BufPrint_itoa
+   */
+   int fmtInt(S64 value, int zeroPad = 0);
+
+   /** Install a scatter-gather callback for large writes.
+       \sa BufPrint_WriteV
+   */
+   void setWriteV(BufPrint_WriteV cb);
 #endif
    BufPrint_Flush flushCB;
+   BufPrint_WriteV writevCB;
    void *userData;
    char *buf;
    int cursor;
@@ -268,6 +315,7 @@ extern "C"
 #define BufPrint_getBuf(o) (o)->buf
 #define BufPrint_setBuf(o, b, size) (o)->buf = b, (o)->bufSize = size, (o)->cursor = 0
 #define BufPrint_getBufSize(o) (o)->cursor
+#define BufPrint_setWriteV(o, cb) (o)->writevCB = (cb)
    BA_API void BufPrint_constructor(
        BufPrint *o, void *userData, BufPrint_Flush flush);
    BA_API void BufPrint_constructor2(
@@ -284,8 +332,22 @@ extern "C"
        BufPrint *o, const void *source, S32 slen, BaBool padding);
 
    BA_API int BufPrint_jsonString(BufPrint *o, const char *str);
+/** Buffer size required by BufPrint_itoa */
+#define BUFPRINT_ITOA_SIZE 21
+   BA_API int BufPrint_itoa(char *buf, S64 value, int zeroPad);
+   BA_API int BufPrint_fmtInt(BufPrint *o, S64 value, int zeroPad);
+#ifndef NO_DOUBLE
+/** Buffer size required by BufPrint_dtoa */
+#define BUFPRINT_DTOA_SIZE 32
+   BA_API int BufPrint_dtoa(char *buf, double value);
+   BA_API int BufPrint_fmtDouble(BufPrint *o, double value);
+#endif
 #ifdef __cplusplus
 }
+inline void BufPrint::setWriteV(BufPrint_WriteV cb)
+{
+   BufPrint_setWriteV(this, cb);
+}
 inline void *BufPrint::getUserData()
 {
    return BufPrint_getUserData(this);
@@ -356,6 +418,94 @@ inline int BufPrint::jsonString(const char *str)
 {
    return BufPrint_jsonString(this, str);
 }
+inline int BufPrint::fmtInt(S64 value, int zeroPad)
+{
+   return BufPrint_fmtInt(this, value, zeroPad);
+}
+#ifndef NO_DOUBLE
+inline int BufPrint::fmtDouble(double value)
+{
+   return BufPrint_fmtDouble(this, value);
+}
+#endif
+#endif
+
+/** Incremental Base64 and Base64url decoder, the counterpart to
+    BufPrint::b64Encode and BufPrint::b64urlEncode.
+
+    The encoded text can be passed to decode in chunks of any size,
+    such as network reads; only up to three pending characters are
+    kept between calls. Both alphabets are accepted, and padding is
+    optional.
+
+    JParser assembles a string value in one buffer before the
+    callback receives it, which limits a Base64 value to the size of
+    that buffer. Enable JParser::setStringChunks to receive a long
+    value in parts and decode each part as it arrives, see
+    JParserVal::more.
+
+    \code
+    B64Decoder d;
+    U8 out[B64Decoder_maxSize(sizeof(chunk)) + 2];
+    int n = d.decode(chunk, chunkLen, out); // Repeat for each chunk
+    ...
+    int tail = d.end(out); // The last 0 to 2 bytes
+    \endcode
+ */
+typedef struct B64Decoder
+{
+#ifdef __cplusplus
+   B64Decoder();
+
+   /** Decode a chunk of Base64 text.
+       \param src the text.
+       \param len the text length.
+       \param dest receives the decoded bytes; must hold at least
+       B64Decoder_maxSize(len) bytes. Decoding a complete string in
+       one call with a new decoder may be done in place, i.e., 'dest'
+       may equal 'src'.
+       \returns the number of bytes written to 'dest' or -1 if the
+       text is not valid Base64.
+   */
+   int decode(const void *src, int len, U8 *dest);
+
+   /** Complete the decoding and reset the decoder.
+       \param dest receives up to two pending bytes.
+       \returns the number of bytes written to 'dest' or -1 if the
+       text is truncated or incorrectly padded.
+   */
+   int end(U8 *dest);
+#endif
+   U32 bits;  /* Pending characters, 6 bits each */
+   U8 count;  /* Number of pending characters */
+   U8 pad;    /* Number of '=' received */
+} B64Decoder;
+
+/** The largest number of bytes B64Decoder::decode writes for 'len'
+    characters. */
+#define B64Decoder_maxSize(len) (((len) + 3) / 4 * 3)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#define B64Decoder_constructor(o) ((o)->bits = 0, (o)->count = 0, (o)->pad = 0)
+   BA_API int B64Decoder_decode(B64Decoder *o, const void *src, int len, U8 *dest);
+   BA_API int B64Decoder_end(B64Decoder *o, U8 *dest);
+#ifdef __cplusplus
+}
+inline B64Decoder::B64Decoder()
+{
+   B64Decoder_constructor(this);
+}
+inline int B64Decoder::decode(const void *src, int len, U8 *dest)
+{
+   return B64Decoder_decode(this, src, len, dest);
+}
+inline int B64Decoder::end(U8 *dest)
+{
+   return B64Decoder_end(this, dest);
+}
 #endif
 
 /** @} */ /* end of BufPrint */
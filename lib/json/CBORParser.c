@@ -0,0 +1,541 @@
+/*
+ * Streaming CBOR parser, see CBORParser.h.
+ */
+
+#ifndef BA_LIB
+#define BA_LIB 1
+#endif
+
+#include "CBORParser.h"
+#include <string.h>
+
+/* CBOR major types */
+#define CBOR_UINT 0
+#define CBOR_NINT 1
+#define CBOR_BYTES 2
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_TAG 6
+#define CBOR_SIMPLE 7
+
+#define CBOR_BREAK 0xFF
+
+static int
+CBORParser_setStatus(CBORParser *o, JParsStat s, int retVal)
+{
+   o->status = (U8)s;
+   if (retVal)
+   {
+      o->stackIx = 0;
+      o->skipLevel = 0;
+      o->strIndef = FALSE;
+      o->state = CBORParserSt_Head;
+   }
+   return retVal;
+}
+
+#define CBORParser_parseErr(o) \
+   CBORParser_setStatus(o, JParsStat_ParseErr, -1)
+
+/* Make room for 'size' more bytes and a zero terminator in the
+   string assembly buffer.
+*/
+static int
+CBORParser_reserve(CBORParser *o, U32 size)
+{
+   size_t needed = (size_t)o->asmIx + size + 1;
+   if (o->strKey)
+   {
+      /* Member names are assembled directly in the name buffer */
+      if (needed > o->nameSize)
+         return CBORParser_setStatus(o, JParsStat_MemErr, -1);
+      return 0;
+   }
+   if (needed > o->asmSize)
+   {
+      U8 *ptr;
+      size_t newSize = (needed + 255) & ~(size_t)255;
+      if (!o->alloc)
+         return CBORParser_setStatus(o, JParsStat_MemErr, -1);
+      ptr = (U8 *)(o->asmBuf ?
+                   AllocatorIntf_realloc(o->alloc, o->asmBuf, &newSize) :
+                   AllocatorIntf_malloc(o->alloc, &newSize));
+      if (!ptr)
+         return CBORParser_setStatus(o, JParsStat_MemErr, -1);
+      o->asmBuf = ptr;
+      o->asmSize = newSize;
+   }
+   return 0;
+}
+
+/* Space required for Base64 encoding 'size' more bytes, including
+   the bytes pending in o->b64 and the final padding.
+*/
+#define CBORParser_b64Size(o, size) ((((size) + (o)->b64Len) / 3 + 1) * 4)
+
+static const char b64alpha[] = {
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"};
+
+static void
+CBORParser_b64Encode(CBORParser *o, const U8 *src, U32 len)
+{
+   U8 *dst = o->asmBuf + o->asmIx;
+   while (len--)
+   {
+      o->b64[o->b64Len++] = *src++;
+      if (o->b64Len == 3)
+      {
+         *dst++ = b64alpha[o->b64[0] >> 2];
+         *dst++ = b64alpha[(o->b64[0] & 0x03) << 4 | o->b64[1] >> 4];
+         *dst++ = b64alpha[(o->b64[1] & 0x0F) << 2 | o->b64[2] >> 6];
+         *dst++ = b64alpha[o->b64[2] & 0x3F];
+         o->b64Len = 0;
+      }
+   }
+   o->asmIx = (U32)(dst - o->asmBuf);
+}
+
+static void
+CBORParser_b64Finish(CBORParser *o)
+{
+   U8 *dst = o->asmBuf + o->asmIx;
+   if (o->b64Len)
+   {
+      U8 b1 = o->b64Len == 2 ? o->b64[1] : 0;
+      *dst++ = b64alpha[o->b64[0] >> 2];
+      *dst++ = b64alpha[(o->b64[0] & 0x03) << 4 | b1 >> 4];
+      *dst++ = o->b64Len == 2 ? b64alpha[(b1 & 0x0F) << 2] : '=';
+      *dst++ = '=';
+      o->b64Len = 0;
+   }
+   o->asmIx = (U32)(dst - o->asmBuf);
+}
+
+#ifndef NO_DOUBLE
+/* Convert a half precision float to single precision */
+static float
+CBORParser_half(U32 h)
+{
+   U32 sign = (h & 0x8000) << 16;
+   U32 e = (h >> 10) & 0x1F;
+   U32 m = h & 0x3FF;
+   U32 bits;
+   float f;
+   if (e == 0x1F)
+      bits = sign | 0x7F800000 | (m << 13); /* Inf or NaN */
+   else if (e)
+      bits = sign | ((e + 112) << 23) | (m << 13);
+   else if (m)
+   {
+      /* Subnormal: normalize the mantissa */
+      e = 113;
+      while (!(m & 0x400))
+      {
+         m <<= 1;
+         e--;
+      }
+      bits = sign | (e << 23) | ((m & 0x3FF) << 13);
+   }
+   else
+      bits = sign;
+   memcpy(&f, &bits, sizeof(f));
+   return f;
+}
+#endif
+
+/* Returns a negative value on error and JPARSER_SKIP if the callback
+   wants to skip the map or array just started. Any other non zero
+   value from the callback is an error.
+*/
+static int
+CBORParser_service(CBORParser *o)
+{
+   int retVal = 0;
+   if (!o->skipLevel)
+   {
+      retVal = JParserIntf_serviceCB(o->intf, &o->val, o->stackIx);
+      if (retVal && (retVal != JPARSER_SKIP ||
+                     (o->val.t != JParserT_BeginObject &&
+                      o->val.t != JParserT_BeginArray)))
+      {
+         retVal = CBORParser_setStatus(o, JParsStat_IntfErr, -1);
+      }
+   }
+   o->val.memberName[0] = 0;
+   return retVal;
+}
+
+static int CBORParser_end(CBORParser *o);
+
+/* Called when a data item in the current map or array is complete.
+   Closes definite length containers and returns 1 when the top level
+   item is complete.
+*/
+static int
+CBORParser_next(CBORParser *o)
+{
+   CBORParserStackNode *n;
+   if (o->stackIx == 0)
+   {
+      return CBORParser_setStatus(
+          o, o->ptr < o->end ? JParsStat_Done : JParsStat_DoneEOS, 1);
+   }
+   n = &o->stack[o->stackIx - 1];
+   if (n->type == JParserT_BeginObject)
+      n->key = !n->key;
+   if (n->remaining == CBORPARSER_INDEFINITE || --n->remaining)
+      return 0;
+   return CBORParser_end(o);
+}
+
+/* Close the current map or array */
+static int
+CBORParser_end(CBORParser *o)
+{
+   o->stackIx--;
+   o->val.t = o->stack[o->stackIx].type == JParserT_BeginObject ?
+      JParserT_EndObject : JParserT_EndArray;
+   if (o->skipLevel == o->stackIx + 1)
+      o->skipLevel = 0; /* The callback gets the end of a skipped item */
+   if (CBORParser_service(o) < 0)
+      return -1;
+   return CBORParser_next(o);
+}
+
+static int
+CBORParser_begin(CBORParser *o, JParserT t, BaBool indefinite)
+{
+   CBORParserStackNode *n;
+   int retVal;
+   if ((o->stackIx + 1) >= o->stackSize)
+      return CBORParser_setStatus(o, JParsStat_StackOverflow, -1);
+   if (!indefinite && o->arg >= (t == JParserT_BeginObject ?
+                                 CBORPARSER_INDEFINITE / 2 :
+                                 CBORPARSER_INDEFINITE))
+   {
+      return CBORParser_parseErr(o);
+   }
+   o->val.t = t;
+   retVal = CBORParser_service(o);
+   if (retVal < 0)
+      return -1;
+   n = &o->stack[o->stackIx++];
+   n->type = (U8)t;
+   n->key = t == JParserT_BeginObject;
+   if (indefinite)
+      n->remaining = CBORPARSER_INDEFINITE;
+   else
+      n->remaining = (U32)(t == JParserT_BeginObject ? o->arg * 2 : o->arg);
+   if (retVal == JPARSER_SKIP && !o->skipLevel)
+      o->skipLevel = o->stackIx;
+   if (!n->remaining)
+      return CBORParser_end(o);
+   return 0;
+}
+
+static int
+CBORParser_value(CBORParser *o)
+{
+   if (CBORParser_service(o) < 0)
+      return -1;
+   return CBORParser_next(o);
+}
+
+static int
+CBORParser_endString(CBORParser *o)
+{
+   if (o->skipLevel)
+   {
+      if (o->strKey)
+         return CBORParser_next(o);
+      return CBORParser_value(o);
+   }
+   if (o->strKey)
+   {
+      o->val.memberName[o->asmIx] = 0;
+      return CBORParser_next(o);
+   }
+   if (o->strMajor == CBOR_BYTES)
+      CBORParser_b64Finish(o);
+   o->asmBuf[o->asmIx] = 0;
+   o->val.t = JParserT_String;
+   o->val.v.s = (char *)o->asmBuf;
+   o->val.len = o->asmIx;
+   return CBORParser_value(o);
+}
+
+/* Start a definite length string or a chunk of an indefinite length
+   string.
+*/
+static int
+CBORParser_beginChunk(CBORParser *o)
+{
+   U32 len;
+   if (o->arg > 0x7FFFFFFF)
+      return CBORParser_parseErr(o);
+   len = (U32)o->arg;
+   if (!o->skipLevel &&
+       CBORParser_reserve(o, o->strMajor == CBOR_BYTES ?
+                          CBORParser_b64Size(o, len) : len))
+   {
+      return -1;
+   }
+   o->strLeft = len;
+   if (len)
+      o->state = CBORParserSt_String;
+   else if (!o->strIndef)
+      return CBORParser_endString(o);
+   return 0;
+}
+
+static int
+CBORParser_string(CBORParser *o)
+{
+   U32 len = (U32)(o->end - o->ptr);
+   if (len > o->strLeft)
+      len = o->strLeft;
+   if (!o->skipLevel)
+   {
+      if (o->strMajor == CBOR_BYTES)
+         CBORParser_b64Encode(o, o->ptr, len);
+      else
+      {
+         U8 *dst = o->strKey ? (U8 *)o->val.memberName : o->asmBuf;
+         memcpy(dst + o->asmIx, o->ptr, len);
+         o->asmIx += len;
+      }
+   }
+   o->ptr += len;
+   o->strLeft -= len;
+   if (o->strLeft)
+      return 0;
+   o->state = CBORParserSt_Head;
+   if (o->strIndef)
+      return 0; /* Next chunk or break */
+   return CBORParser_endString(o);
+}
+
+/* Process the data item with initial byte o->ib and argument o->arg */
+static int
+CBORParser_item(CBORParser *o)
+{
+   CBORParserStackNode *top;
+   int major = o->ib >> 5;
+   BaBool indefinite = (o->ib & 31) == 31;
+
+   if (o->strIndef)
+   {
+      /* Only chunks of the same type and break are valid */
+      if (o->ib == CBOR_BREAK)
+      {
+         o->strIndef = FALSE;
+         return CBORParser_endString(o);
+      }
+      if (major != o->strMajor || indefinite)
+         return CBORParser_parseErr(o);
+      return CBORParser_beginChunk(o);
+   }
+   if (major == CBOR_TAG)
+      return indefinite ? CBORParser_parseErr(o) : 0;
+   if (o->stackIx == 0)
+   {
+      if (major != CBOR_MAP && major != CBOR_ARRAY)
+         return CBORParser_parseErr(o);
+      top = 0;
+   }
+   else
+      top = &o->stack[o->stackIx - 1];
+
+   if (o->ib == CBOR_BREAK)
+   {
+      if (top && top->remaining == CBORPARSER_INDEFINITE &&
+          (top->type == JParserT_BeginArray || top->key))
+      {
+         return CBORParser_end(o);
+      }
+      return CBORParser_parseErr(o);
+   }
+   o->strKey = top && top->type == JParserT_BeginObject && top->key;
+   if (o->strKey && major != CBOR_TEXT)
+      return CBORParser_parseErr(o); /* Only text keys are supported */
+
+   switch (major)
+   {
+      case CBOR_UINT:
+      case CBOR_NINT:
+         if (indefinite)
+            return CBORParser_parseErr(o);
+         if (o->arg <= 0x7FFFFFFF)
+         {
+            o->val.t = JParserT_Int;
+            o->val.v.d = major == CBOR_UINT ? (S32)o->arg : -1 - (S32)o->arg;
+         }
+         else if (o->arg <= 0x7FFFFFFFFFFFFFFFULL)
+         {
+            o->val.t = JParserT_Long;
+            o->val.v.l = major == CBOR_UINT ? o->arg : (U64)(-1 - (S64)o->arg);
+         }
+         else
+            return CBORParser_parseErr(o);
+         return CBORParser_value(o);
+
+      case CBOR_BYTES:
+      case CBOR_TEXT:
+         o->strMajor = (U8)major;
+         o->asmIx = 0;
+         o->b64Len = 0;
+         if (indefinite)
+         {
+            o->strIndef = TRUE;
+            return o->skipLevel ? 0 : CBORParser_reserve(o, 0);
+         }
+         if (major == CBOR_TEXT && o->zeroCopy && !o->strKey &&
+             !o->skipLevel && o->arg <= (U64)(o->end - o->ptr))
+         {
+            /* The complete string is in the parse buffer */
+            o->val.t = JParserT_String;
+            o->val.v.s = (char *)o->ptr;
+            o->val.len = (U32)o->arg;
+            o->ptr += o->val.len;
+            return CBORParser_value(o);
+         }
+         return CBORParser_beginChunk(o);
+
+      case CBOR_ARRAY:
+         return CBORParser_begin(o, JParserT_BeginArray, indefinite);
+
+      case CBOR_MAP:
+         return CBORParser_begin(o, JParserT_BeginObject, indefinite);
+
+      default:
+         baAssert(major == CBOR_SIMPLE);
+         switch (o->ib & 31)
+         {
+            case 20:
+            case 21:
+               o->val.t = JParserT_Boolean;
+               o->val.v.b = (o->ib & 31) == 21;
+               break;
+            case 22: /* null */
+            case 23: /* undefined */
+               o->val.t = JParserT_Null;
+               break;
+#ifndef NO_DOUBLE
+            case 25:
+               o->val.t = JParserT_Double;
+               o->val.v.f = CBORParser_half((U32)o->arg);
+               break;
+            case 26:
+            {
+               U32 bits = (U32)o->arg;
+               float f;
+               memcpy(&f, &bits, sizeof(f));
+               o->val.t = JParserT_Double;
+               o->val.v.f = f;
+               break;
+            }
+            case 27:
+               o->val.t = JParserT_Double;
+               memcpy(&o->val.v.f, &o->arg, sizeof(o->val.v.f));
+               break;
+#endif
+            default:
+               return CBORParser_parseErr(o);
+         }
+         return CBORParser_value(o);
+   }
+}
+
+void CBORParser_constructor(CBORParser *o, JParserIntf *intf,
+                            char *nameBuf, int namebufSize,
+                            AllocatorIntf *alloc, int extraStackLen)
+{
+   memset(o, 0, sizeof(CBORParser));
+   o->val.memberName = nameBuf;
+   nameBuf[0] = 0;
+   o->nameSize = (U32)namebufSize;
+   o->intf = intf;
+   o->alloc = alloc;
+   o->status = JParsStat_DoneEOS;
+   o->state = CBORParserSt_Head;
+   o->stackSize = (S16)(JPARSER_STACK_LEN + extraStackLen);
+}
+
+void CBORParser_destructor(CBORParser *o)
+{
+   if (o->asmBuf)
+   {
+      AllocatorIntf_free(o->alloc, o->asmBuf);
+      o->asmBuf = 0;
+   }
+}
+
+void CBORParser_reset(CBORParser *o)
+{
+   CBORParser_setStatus(o, JParsStat_DoneEOS, 1);
+   o->argLeft = 0;
+   o->asmIx = 0;
+   o->b64Len = 0;
+   o->val.memberName[0] = 0;
+}
+
+int CBORParser_parse(CBORParser *o, const U8 *buf, U32 size)
+{
+   int retVal;
+   if (o->status == JParsStat_DoneEOS || o->status == JParsStat_NeedMoreData)
+   {
+      o->ptr = buf;
+      o->end = buf + size;
+   }
+   else if (o->status != JParsStat_Done)
+      return -1;
+
+   for (;;)
+   {
+      if (o->ptr == o->end)
+         return CBORParser_setStatus(o, JParsStat_NeedMoreData, 0);
+      switch (o->state)
+      {
+         case CBORParserSt_Head:
+            o->ib = *o->ptr++;
+            o->arg = o->ib & 31;
+            if (o->arg >= 24)
+            {
+               if (o->arg > 27)
+               {
+                  if (o->arg != 31)
+                     return CBORParser_parseErr(o); /* Reserved */
+               }
+               else
+               {
+                  /* 1, 2, 4, or 8 argument bytes follow */
+                  o->argLeft = (U8)(1 << (o->arg - 24));
+                  o->arg = 0;
+                  o->state = CBORParserSt_Arg;
+                  continue;
+               }
+            }
+            retVal = CBORParser_item(o);
+            break;
+
+         case CBORParserSt_Arg:
+            while (o->argLeft && o->ptr < o->end)
+            {
+               o->arg = (o->arg << 8) | *o->ptr++;
+               o->argLeft--;
+            }
+            if (o->argLeft)
+               continue;
+            o->state = CBORParserSt_Head;
+            retVal = CBORParser_item(o);
+            break;
+
+         default:
+            baAssert(o->state == CBORParserSt_String);
+            retVal = CBORParser_string(o);
+      }
+      if (retVal)
+         return retVal;
+   }
+}
@@ -0,0 +1,171 @@
+/*
+ * Streaming CBOR (RFC 8949) parser driving the JParserIntf callbacks.
+ */
+
+#ifndef __CBORParser_h
+#define __CBORParser_h
+
+#include "JParser.h"
+
+/** @addtogroup JSONCB
+@{
+*/
+
+#ifndef __DOXYGEN__
+/* Open map or array */
+typedef struct
+{
+   U32 remaining; /* Items left, CBORPARSER_INDEFINITE if no count */
+   U8 type;       /* JParserT_BeginObject or JParserT_BeginArray */
+   U8 key;        /* Map: the next item is a member name */
+} CBORParserStackNode;
+
+#define CBORPARSER_INDEFINITE 0xFFFFFFFF
+
+typedef enum
+{
+   CBORParserSt_Head,   /* Expecting the initial byte of a data item */
+   CBORParserSt_Arg,    /* Assembling the argument following it */
+   CBORParserSt_String  /* Assembling a text or byte string */
+} CBORParserSt;
+#endif /* __DOXYGEN__ */
+
+/** The CBOR parser is the binary counterpart to JParser. It parses
+    a stream of CBOR data items, as produced by JEncoder in CBOR mode,
+    and calls the same JParserIntf callback interface. JDecoder, the
+    generated decoders, JParserCValFact and JPathFilter can therefore
+    be used unchanged with either wire format.
+
+    Each top level data item must be a map or an array. Maps must use
+    text string keys. CBOR types are mapped as follows:
+
+    \li Unsigned and negative integers: JParserT_Int if the value fits
+    in S32, otherwise JParserT_Long.
+    \li Half, single, and double precision floats: JParserT_Double.
+    \li Text strings: JParserT_String.
+    \li Byte strings: JParserT_String holding the Base64 encoding,
+    which is what JEncoder::b64enc produces in JSON mode.
+    \li true, false, null, and undefined: JParserT_Boolean and
+    JParserT_Null.
+    \li Tags are ignored; the tagged item is returned as is.
+
+    Definite and indefinite length strings, maps, and arrays can be
+    split at any byte boundary between two calls to method parse.
+    Returning JPARSER_SKIP from the callback skips a map or array just
+    as it does for JParser.
+
+    \sa JParser JEncoder::setCBOR
+ */
+typedef struct CBORParser
+{
+#ifdef __cplusplus
+   /** Create a CBOR parser object. The arguments are the same as for
+       JParser::JParser.
+   */
+   CBORParser(JParserIntf *intf, char *nameBuf, int namebufSize,
+              AllocatorIntf *alloc, int extraStackLen = 0);
+
+   /** Parse a CBOR data chunk.
+       \param buf a pointer to the chunk.
+       \param size is the buffer length.
+       \returns
+       \li 0: Needs more data.
+       \li > 0: A complete map or array is parsed.
+       \li < 0: Parse error.
+       \sa getStatus
+   */
+   int parse(const U8 *buf, U32 size);
+
+   /** Terminate and release the internal buffer. */
+   ~CBORParser();
+
+   /** Returns the parser status.
+       \sa JParser::getStatus
+    */
+   JParsStat getStatus();
+
+   /** Enable or disable zero copy mode for text strings.
+       \sa JParser::setZeroCopy
+    */
+   void setZeroCopy(bool enable);
+
+   /** Discard a partially parsed message and any error status.
+       \sa JParser::reset
+    */
+   void reset();
+#endif
+   JParserVal val;
+   JParserIntf *intf;
+   AllocatorIntf *alloc;
+   U8 *asmBuf;      /* Assembling string values */
+   size_t asmSize;
+   U32 asmIx;       /* String length so far */
+   U32 nameSize;    /* Size of the member name buffer in 'val' */
+   U32 strLeft;     /* Bytes left in the current string (chunk) */
+   const U8 *ptr;   /* Current position in the buffer passed to parse */
+   const U8 *end;
+   U64 arg;         /* Argument of the current data item */
+   S16 stackIx;
+   S16 stackSize;
+   S16 skipLevel;   /* Non zero while skipping a map or array */
+   U8 ib;           /* Initial byte of the current data item */
+   U8 argLeft;      /* Argument bytes not yet received */
+   U8 state;        /* CBORParserSt */
+   U8 status;       /* JParsStat */
+   U8 strMajor;     /* Major type of the string being assembled */
+   U8 strIndef;     /* Assembling an indefinite length string */
+   U8 strKey;       /* The string is a member name */
+   U8 zeroCopy;
+   U8 b64[3];       /* Byte string bytes not yet Base64 encoded */
+   U8 b64Len;
+   /* The stack can be extended as for JParser, see 'extraStackLen' */
+   CBORParserStackNode stack[JPARSER_STACK_LEN];
+} CBORParser;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+   BA_API void CBORParser_constructor(CBORParser *o, JParserIntf *intf,
+                                      char *nameBuf, int namebufSize,
+                                      AllocatorIntf *alloc, int extraStackLen);
+   BA_API int CBORParser_parse(CBORParser *o, const U8 *buf, U32 size);
+   BA_API void CBORParser_destructor(CBORParser *o);
+   BA_API void CBORParser_reset(CBORParser *o);
+#define CBORParser_getStatus(o) ((JParsStat)(o)->status)
+#define CBORParser_setZeroCopy(o, enable) \
+   ((o)->zeroCopy = (U8)((enable) ? TRUE : FALSE))
+#ifdef __cplusplus
+}
+inline CBORParser::CBORParser(JParserIntf *intf, char *nameBuf,
+                              int namebufSize, AllocatorIntf *alloc,
+                              int extraStackLen)
+{
+   CBORParser_constructor(this, intf, nameBuf, namebufSize, alloc,
+                          extraStackLen);
+}
+inline int CBORParser::parse(const U8 *buf, U32 size)
+{
+   return CBORParser_parse(this, buf, size);
+}
+inline CBORParser::~CBORParser()
+{
+   CBORParser_destructor(this);
+}
+inline JParsStat CBORParser::getStatus()
+{
+   return CBORParser_getStatus(this);
+}
+inline void CBORParser::setZeroCopy(bool enable)
+{
+   CBORParser_setZeroCopy(this, enable);
+}
+inline void CBORParser::reset()
+{
+   CBORParser_reset(this);
+}
+#endif
+
+/** @} */ /* end of JSONCB */
+
+#endif
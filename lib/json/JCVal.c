@@ -0,0 +1,512 @@
+/*
+ * Compact, read-only JSON DOM, see JCVal.h.
+ */
+
+#ifndef BA_LIB
+#define BA_LIB 1
+#endif
+
+#include "JCVal.h"
+#include <string.h>
+
+#define JParserCValFact_node(o, ix) ((JCVal *)(o)->buf + (ix))
+
+/****************************************************************************
+                                JCVal
+ ****************************************************************************/
+
+static int
+JCVal_setNullErr(JErr *e)
+{
+   JErr_setError(e, JErrT_InvalidMethodParams, "NULL value");
+   return -1;
+}
+
+S32 JCVal_getInt(JCVal *o, JErr *e)
+{
+   if (!o)
+      return JCVal_setNullErr(e), 0;
+   switch (o->type)
+   {
+   case JVType_Int:
+      return o->v.d;
+   case JVType_Long:
+      return (S32)o->v.l;
+#ifndef NO_DOUBLE
+   case JVType_Double:
+      return (S32)o->v.f;
+#endif
+   default:
+      JErr_setTypeErr(e, JVType_Int, JCVal_getType(o));
+   }
+   return 0;
+}
+
+S64 JCVal_getLong(JCVal *o, JErr *e)
+{
+   if (!o)
+      return JCVal_setNullErr(e), 0;
+   switch (o->type)
+   {
+   case JVType_Int:
+      return o->v.d;
+   case JVType_Long:
+      return o->v.l;
+#ifndef NO_DOUBLE
+   case JVType_Double:
+      return (S64)o->v.f;
+#endif
+   default:
+      JErr_setTypeErr(e, JVType_Long, JCVal_getType(o));
+   }
+   return 0;
+}
+
+#ifndef NO_DOUBLE
+double JCVal_getDouble(JCVal *o, JErr *e)
+{
+   if (!o)
+      return JCVal_setNullErr(e), 0;
+   switch (o->type)
+   {
+   case JVType_Int:
+      return o->v.d;
+   case JVType_Long:
+      return (double)o->v.l;
+   case JVType_Double:
+      return o->v.f;
+   default:
+      JErr_setTypeErr(e, JVType_Double, JCVal_getType(o));
+   }
+   return 0;
+}
+#endif
+
+BaBool JCVal_getBoolean(JCVal *o, JErr *e)
+{
+   if (!o)
+      return JCVal_setNullErr(e), FALSE;
+   if (o->type == JVType_Boolean)
+      return o->v.b;
+   if (o->type != JVType_Null)
+      JErr_setTypeErr(e, JVType_Boolean, JCVal_getType(o));
+   return FALSE;
+}
+
+const char *JCVal_getString(JCVal *o, JErr *e)
+{
+   if (!o)
+      return JCVal_setNullErr(e), (const char *)0;
+   if (o->type == JVType_String)
+      return (const char *)o + o->v.s;
+   if (o->type != JVType_Null)
+      JErr_setTypeErr(e, JVType_String, JCVal_getType(o));
+   return 0;
+}
+
+JCVal *JCVal_getObject(JCVal *o, JErr *e)
+{
+   if (!o)
+      return JCVal_setNullErr(e), (JCVal *)0;
+   if (o->type != JVType_Object)
+   {
+      JErr_setTypeErr(e, JVType_Object, JCVal_getType(o));
+      return 0;
+   }
+   return o->v.c.count ? o + 1 : 0;
+}
+
+JCVal *JCVal_getArray(JCVal *o, JErr *e)
+{
+   if (!o)
+      return JCVal_setNullErr(e), (JCVal *)0;
+   if (o->type != JVType_Array)
+   {
+      JErr_setTypeErr(e, JVType_Array, JCVal_getType(o));
+      return 0;
+   }
+   return o->v.c.count ? o + 1 : 0;
+}
+
+JCVal *JCVal_getJ(JCVal *o, JErr *e)
+{
+   if (!o)
+      return JCVal_setNullErr(e), (JCVal *)0;
+   if (o->type != JVType_Object && o->type != JVType_Array)
+   {
+      JErr_setTypeErr(e, JVType_Object, JCVal_getType(o));
+      return 0;
+   }
+   return o->v.c.count ? o + 1 : 0;
+}
+
+S32 JCVal_getLength(JCVal *o, JErr *e)
+{
+   if (!o)
+      return JCVal_setNullErr(e), 0;
+   if (o->type != JVType_Object && o->type != JVType_Array)
+   {
+      JErr_setTypeErr(e, JVType_Object, JCVal_getType(o));
+      return 0;
+   }
+   return o->v.c.count;
+}
+
+/* Find member 'name' among the siblings starting at 'first'. The
+   search starts at 'cursor', the member following the previous match,
+   making lookups in document order O(1).
+*/
+static JCVal *
+JCVal_getMember(JCVal *first, JCVal **cursor, const char *name)
+{
+   JCVal *v = *cursor;
+   do
+   {
+      if (!strcmp((const char *)v + v->name, name))
+      {
+         *cursor = v->next ? v + v->next : first;
+         return v;
+      }
+      v = v->next ? v + v->next : first;
+   } while (v != *cursor);
+   return 0;
+}
+
+static int JCVal_getFlag(
+    JCVal *v, JErr *err, const char **fmt, va_list *argList);
+
+/* Extract the values for the flags following '{' or '[' in 'fmt'.
+   Returns with 'fmt' at the matching '}' or ']'.
+*/
+static int
+JCVal_getChildren(JCVal *o, JErr *err, const char **fmt, va_list *argList)
+{
+   BaBool isObj = o->type == JVType_Object;
+   JCVal *first = o->v.c.count ? o + 1 : 0;
+   JCVal *cursor = first;
+   JCVal *v;
+   for (;;)
+   {
+      if (!**fmt)
+      {
+         JErr_setError(err, JErrT_FmtValErr, "Missing ']' or '}'");
+         return -1;
+      }
+      if (**fmt == '}' || **fmt == ']')
+      {
+         if ((**fmt == '}') != isObj)
+         {
+            JErr_setError(err, JErrT_FmtValErr, "Mismatched ']' or '}'");
+            return -1;
+         }
+         return 0;
+      }
+      if (isObj)
+      {
+         const char *name = va_arg(*argList, const char *);
+         v = name && first ? JCVal_getMember(first, &cursor, name) : 0;
+         if (!v)
+         {
+            JErr_setError(err, JErrT_FmtValErr, "Member not found");
+            return -1;
+         }
+      }
+      else
+      {
+         if (!cursor)
+         {
+            JErr_setError(err, JErrT_FmtValErr, "Too few array elements");
+            return -1;
+         }
+         v = cursor;
+         cursor = JCVal_getNextElem(v);
+      }
+      if (JCVal_getFlag(v, err, fmt, argList))
+         return -1;
+      (*fmt)++;
+   }
+}
+
+static int
+JCVal_getFlag(JCVal *v, JErr *err, const char **fmt, va_list *argList)
+{
+   switch (**fmt)
+   {
+   case 'd':
+      *va_arg(*argList, S32 *) = JCVal_getInt(v, err);
+      break;
+   case 'l':
+      *va_arg(*argList, S64 *) = JCVal_getLong(v, err);
+      break;
+#ifndef NO_DOUBLE
+   case 'f':
+      *va_arg(*argList, double *) = JCVal_getDouble(v, err);
+      break;
+#endif
+   case 'b':
+      *va_arg(*argList, BaBool *) = JCVal_getBoolean(v, err);
+      break;
+   case 's':
+      *va_arg(*argList, const char **) = JCVal_getString(v, err);
+      break;
+   case 'J':
+      *va_arg(*argList, JCVal **) = v;
+      break;
+   case 'A':
+   {
+      JCVal **list = va_arg(*argList, JCVal **);
+      int len = va_arg(*argList, int);
+      JCVal *elem = JCVal_getArray(v, err);
+      for (; len > 0; len--)
+      {
+         *list++ = elem;
+         elem = JCVal_getNextElem(elem);
+      }
+      break;
+   }
+   case '{':
+   case '[':
+      if (!v)
+         return JCVal_setNullErr(err);
+      if (v->type != (**fmt == '{' ? JVType_Object : JVType_Array))
+      {
+         JErr_setTypeErr(err, **fmt == '{' ? JVType_Object : JVType_Array,
+                         JCVal_getType(v));
+         return -1;
+      }
+      (*fmt)++;
+      return JCVal_getChildren(v, err, fmt, argList);
+   default:
+      JErr_setError(err, JErrT_FmtValErr, "Unknown format flag");
+      return -1;
+   }
+   return JErr_isError(err) ? -1 : 0;
+}
+
+JCVal *JCVal_vget(JCVal *o, JErr *err, const char **fmt, va_list *argList)
+{
+   if (JErr_isError(err))
+      return 0;
+   if (!**fmt)
+   {
+      JErr_setTooFewParams(err);
+      return 0;
+   }
+   if (JCVal_getFlag(o, err, fmt, argList))
+      return 0;
+   if ((*fmt)[1])
+   {
+      JErr_setError(err, JErrT_FmtValErr, "Mismatched ']' or '}'");
+      return 0;
+   }
+   return o;
+}
+
+JCVal *JCVal_get(JCVal *o, JErr *err, const char *fmt, ...)
+{
+   JCVal *retv;
+   va_list argList;
+   va_start(argList, fmt);
+   retv = JCVal_vget(o, err, &fmt, &argList);
+   va_end(argList);
+   return retv;
+}
+
+/****************************************************************************
+                                JParserCValFact
+ ****************************************************************************/
+
+static int
+JParserCValFact_setStatus(JParserCValFact *o, JParserValFactStat status)
+{
+   o->status = status;
+   return -1;
+}
+
+/* Make room for 'size' more bytes of nodes and strings. The strings
+   at the end of the buffer move with the end when the buffer grows.
+*/
+static int
+JParserCValFact_reserve(JParserCValFact *o, size_t size)
+{
+   size_t used = o->nodes * sizeof(JCVal) + o->poolSize;
+   size_t newSize;
+   U8 *buf;
+   if (used + size <= o->size)
+      return 0;
+   if (!o->alloc)
+      return JParserCValFact_setStatus(o, JParserValFactStat_VMemErr);
+   newSize = o->size ? o->size * 2 : 256;
+   if (newSize < used + size)
+      newSize = used + size;
+   buf = o->buf ? (U8 *)AllocatorIntf_realloc(o->alloc, o->buf, &newSize)
+                : (U8 *)AllocatorIntf_malloc(o->alloc, &newSize);
+   if (!buf)
+      return JParserCValFact_setStatus(o, JParserValFactStat_VMemErr);
+   memmove(buf + newSize - o->poolSize, buf + o->size - o->poolSize,
+           o->poolSize);
+   o->buf = buf;
+   o->size = newSize;
+   return 0;
+}
+
+/* Copy a string to the pool and return its offset from the end of
+   the buffer. The caller must have reserved the space.
+*/
+static U32
+JParserCValFact_addString(JParserCValFact *o, const char *str, size_t len)
+{
+   U8 *ptr;
+   o->poolSize += len + 1;
+   ptr = o->buf + o->size - o->poolSize;
+   memcpy(ptr, str, len);
+   ptr[len] = 0;
+   return (U32)o->poolSize;
+}
+
+/* The document is complete. Move the strings down to follow the
+   nodes and make all string offsets relative to their node.
+*/
+static void
+JParserCValFact_finish(JParserCValFact *o)
+{
+   U8 *pool = o->buf + o->nodes * sizeof(JCVal);
+   U8 *end = pool + o->poolSize;
+   JCVal *n = (JCVal *)o->buf;
+   JCVal *last = n + o->nodes;
+   memmove(pool, o->buf + o->size - o->poolSize, o->poolSize);
+   for (; n < last; n++)
+   {
+      if (n->name)
+         n->name = (U32)(end - n->name - (U8 *)n);
+      if (n->type == JVType_String)
+         n->v.s = (U32)(end - n->v.s - (U8 *)n);
+   }
+   o->done = TRUE;
+}
+
+static int
+JParserCValFact_service(JParserIntf *super, JParserVal *v, int recLevel)
+{
+   JParserCValFact *o = (JParserCValFact *)super;
+   JCVal *n;
+   JCVal *parent;
+   size_t nameLen = 0;
+   U32 ix;
+   (void)recLevel;
+
+   if (o->status)
+      return -1;
+   if (v->t == JParserT_EndObject || v->t == JParserT_EndArray)
+   {
+      o->cur = JParserCValFact_node(o, o->cur)->v.c.parent;
+      if (o->cur == JCVAL_NIL)
+         JParserCValFact_finish(o);
+      return 0;
+   }
+   if (o->done)
+      JParserCValFact_termFirstVal(o);
+   if (o->nodes >= JCVAL_NIL)
+      return JParserCValFact_setStatus(o, JParserValFactStat_MaxNodes);
+   if (o->cur != JCVAL_NIL &&
+       JParserCValFact_node(o, o->cur)->type == JVType_Object)
+   {
+      nameLen = strlen(v->memberName) + 1;
+   }
+   if (JParserCValFact_reserve(o, sizeof(JCVal) + nameLen +
+                                      (v->t == JParserT_String ? v->len + 1 : 0)))
+   {
+      return -1;
+   }
+   ix = o->nodes++;
+   n = JParserCValFact_node(o, ix);
+   n->name = nameLen ? JParserCValFact_addString(o, v->memberName, nameLen - 1) : 0;
+   n->next = 0;
+   if (o->cur != JCVAL_NIL)
+   {
+      parent = JParserCValFact_node(o, o->cur);
+      /* Node indexes are below JCVAL_NIL, thus the sibling delta and
+         the child count fit in 16 bits.
+      */
+      if (parent->v.c.count++)
+      {
+         /* First child is the node following the parent */
+         JParserCValFact_node(o, parent->v.c.last)->next =
+             (U16)(ix - parent->v.c.last);
+      }
+      parent->v.c.last = (U16)ix;
+   }
+   switch (v->t)
+   {
+   case JParserT_String:
+      n->type = JVType_String;
+      n->v.s = JParserCValFact_addString(o, v->v.s, v->len);
+      break;
+#ifndef NO_DOUBLE
+   case JParserT_Double:
+      n->type = JVType_Double;
+      n->v.f = v->v.f;
+      break;
+#endif
+   case JParserT_Int:
+      n->type = JVType_Int;
+      n->v.d = v->v.d;
+      break;
+   case JParserT_Long:
+      n->type = JVType_Long;
+      n->v.l = (S64)v->v.l;
+      break;
+   case JParserT_Boolean:
+      n->type = JVType_Boolean;
+      n->v.b = v->v.b;
+      break;
+   case JParserT_Null:
+      n->type = JVType_Null;
+      break;
+   case JParserT_BeginObject:
+   case JParserT_BeginArray:
+      n->type = v->t == JParserT_BeginObject ? JVType_Object : JVType_Array;
+      n->v.c.count = 0;
+      n->v.c.last = 0;
+      n->v.c.parent = o->cur;
+      o->cur = (U16)ix;
+      break;
+   default:
+      baAssert(0);
+      return -1;
+   }
+   return 0;
+}
+
+void JParserCValFact_constructor(JParserCValFact *o, AllocatorIntf *alloc)
+{
+   memset(o, 0, sizeof(JParserCValFact));
+   JParserIntf_constructor((JParserIntf *)o, JParserCValFact_service);
+   o->alloc = alloc;
+   o->cur = JCVAL_NIL;
+}
+
+void JParserCValFact_constructor2(JParserCValFact *o, void *buf, size_t size)
+{
+   JParserCValFact_constructor(o, 0);
+   o->buf = (U8 *)buf;
+   o->size = size;
+}
+
+void JParserCValFact_termFirstVal(JParserCValFact *o)
+{
+   o->nodes = 0;
+   o->poolSize = 0;
+   o->cur = JCVAL_NIL;
+   o->done = FALSE;
+   o->status = JParserValFactStat_OK;
+}
+
+void JParserCValFact_destructor(JParserCValFact *o)
+{
+   if (o->alloc && o->buf)
+      AllocatorIntf_free(o->alloc, o->buf);
+   o->buf = 0;
+   o->size = 0;
+   JParserCValFact_termFirstVal(o);
+}
@@ -0,0 +1,327 @@
+/*
+ * Compact, read-only JSON DOM.
+ *
+ * JCVal is an alternative to the pointer linked JVal tree. All nodes
+ * are stored in one contiguous array followed by one string pool.
+ * Nodes are laid out in document order: the first child of an object
+ * or array is the node immediately following it, and siblings are
+ * linked by a 16-bit index delta. Strings and member names are
+ * referenced by an offset relative to the node, so the tree is
+ * position independent and needs no per-node allocation.
+ */
+
+#ifndef __JCVal_h
+#define __JCVal_h
+
+#include "JVal.h"
+
+/** @addtogroup JSONRef
+@{
+*/
+
+/** JCVal is one node in a compact JSON tree created by
+    JParserCValFact. The tree is read only and is queried with the same
+    format flags as JVal::get.
+
+    A node is 16 bytes. Nodes are not allocated individually; the tree,
+    including all strings, is stored in one buffer owned by the
+    JParserCValFact instance.
+
+    Most methods accept a NULL "this" pointer and set JErr or return
+    NULL on errors, just as JVal does.
+*/
+typedef struct JCVal
+{
+#ifdef __cplusplus
+   /** Returns the JSON type.
+    */
+   JVType getType();
+
+   /** Equivalent to get with variable argument list replaced by argList.
+    */
+   JCVal *vget(JErr *err, const char **fmt, va_list *argList);
+
+   /** Get any type of value(s) from a JCVal node or tree. The format
+       flags are the same as for JVal::get, with JCVal replacing JVal
+       for flags 'J' and 'A'. Object members are looked up by name.
+       \sa JVal::get
+   */
+   JCVal *get(JErr *err, const char *fmt, ...);
+
+   /** Returns the value for a number, converting it if needed. */
+   S32 getInt(JErr *e);
+
+   /** Returns the value for a number, converting it if needed. */
+   S64 getLong(JErr *e);
+
+   /** Returns the value for a number, converting it if needed. */
+   double getDouble(JErr *e);
+
+   /** Returns the boolean value or false if a JSON null. */
+   BaBool getBoolean(JErr *e);
+
+   /** Returns the string or NULL if a JSON null. */
+   const char *getString(JErr *e);
+
+   /** Returns the member name if this value is part of a JSON object.
+    */
+   const char *getName();
+
+   /** Returns the next element if the parent is an object or an array.
+    */
+   JCVal *getNextElem();
+
+   /** Returns the first child if an object or NULL if empty. */
+   JCVal *getObject(JErr *e);
+
+   /** Returns the first child if an array or NULL if empty. */
+   JCVal *getArray(JErr *e);
+
+   /** Returns the first child if an object or array. */
+   JCVal *getJ(JErr *e);
+
+   /** Returns the number of children if an object or array. */
+   S32 getLength(JErr *e);
+
+   /** Returns true if this is a child element in an object.
+    */
+   bool isObjectMember();
+#endif
+   union
+   {
+#ifndef NO_DOUBLE
+      double f; /* If floating point */
+#endif
+      S64 l;    /* If long integer */
+      S32 d;    /* If integer */
+      BaBool b; /* If true or false */
+      U32 s;    /* If string: offset from this node */
+      struct
+      {
+         U16 count;  /* Number of children */
+         U16 last;   /* Last child index, while building */
+         U16 parent; /* Parent index, while building */
+      } c; /* If object or array */
+   } v;
+   U32 name; /* Member name offset from this node, 0 if array element */
+   U16 next; /* Index delta to next sibling, 0 if last */
+   U8 type;  /* JVType */
+} JCVal;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#define JCVal_getType(o) ((JVType)(o)->type)
+   BA_API JCVal *JCVal_vget(
+       JCVal *o, JErr *err, const char **fmt, va_list *argList);
+   BA_API JCVal *JCVal_get(JCVal *o, JErr *err, const char *fmt, ...);
+   BA_API S32 JCVal_getInt(JCVal *o, JErr *e);
+   BA_API S64 JCVal_getLong(JCVal *o, JErr *e);
+#ifndef NO_DOUBLE
+   BA_API double JCVal_getDouble(JCVal *o, JErr *e);
+#endif
+   BA_API BaBool JCVal_getBoolean(JCVal *o, JErr *e);
+   BA_API const char *JCVal_getString(JCVal *o, JErr *e);
+#define JCVal_getName(o) \
+   ((o) && (o)->name ? (const char *)(o) + (o)->name : 0)
+#define JCVal_getNextElem(o) ((o) && (o)->next ? (o) + (o)->next : 0)
+   BA_API JCVal *JCVal_getObject(JCVal *o, JErr *e);
+   BA_API JCVal *JCVal_getArray(JCVal *o, JErr *e);
+   BA_API JCVal *JCVal_getJ(JCVal *o, JErr *e);
+   BA_API S32 JCVal_getLength(JCVal *o, JErr *e);
+#define JCVal_isObjectMember(o) ((o)->name != 0)
+#ifdef __cplusplus
+}
+inline JVType JCVal::getType()
+{
+   return JCVal_getType(this);
+}
+inline JCVal *JCVal::vget(JErr *err, const char **fmt, va_list *argList)
+{
+   return JCVal_vget(this, err, fmt, argList);
+}
+inline JCVal *JCVal::get(JErr *err, const char *fmt, ...)
+{
+   JCVal *retv;
+   va_list argList;
+   va_start(argList, fmt);
+   retv = JCVal_vget(this, err, &fmt, &argList);
+   va_end(argList);
+   return retv;
+}
+inline S32 JCVal::getInt(JErr *e)
+{
+   return JCVal_getInt(this, e);
+}
+inline S64 JCVal::getLong(JErr *e)
+{
+   return JCVal_getLong(this, e);
+}
+#ifndef NO_DOUBLE
+inline double JCVal::getDouble(JErr *e)
+{
+   return JCVal_getDouble(this, e);
+}
+#endif
+inline BaBool JCVal::getBoolean(JErr *e)
+{
+   return JCVal_getBoolean(this, e);
+}
+inline const char *JCVal::getString(JErr *e)
+{
+   return JCVal_getString(this, e);
+}
+inline const char *JCVal::getName()
+{
+   return JCVal_getName(this);
+}
+inline JCVal *JCVal::getNextElem()
+{
+   return JCVal_getNextElem(this);
+}
+inline JCVal *JCVal::getObject(JErr *e)
+{
+   return JCVal_getObject(this, e);
+}
+inline JCVal *JCVal::getArray(JErr *e)
+{
+   return JCVal_getArray(this, e);
+}
+inline JCVal *JCVal::getJ(JErr *e)
+{
+   return JCVal_getJ(this, e);
+}
+inline S32 JCVal::getLength(JErr *e)
+{
+   return JCVal_getLength(this, e);
+}
+inline bool JCVal::isObjectMember()
+{
+   return JCVal_isObjectMember(this) ? true : false;
+}
+#endif
+
+/** @} */ /* end of JSONRef */
+
+/** @addtogroup JSONCB
+@{
+*/
+
+/** JParserCValFact is the JCVal JSON parser factory class. An
+    instance of this class is connected to an instance of the JParser
+    and builds a compact JCVal tree, one JSON document at a time.
+
+    Nodes are stored from the start of one buffer and strings from the
+    end. When the document is complete, the strings are moved down to
+    follow the nodes, and getFirstVal returns the root. The buffer
+    either grows through an AllocatorIntf, such as an ArenaAllocator,
+    or is a fixed size buffer provided by the caller.
+
+    The tree is valid until the parser starts on the next JSON
+    document, at which point the factory discards it and starts over.
+    A document can have at most 65535 nodes.
+
+    \sa JParserValFact
+*/
+#ifdef __cplusplus
+typedef struct JParserCValFact : public JParserIntf
+{
+   /** Create a factory allocating its buffer from 'alloc'.
+       The allocator should implement realloc.
+   */
+   JParserCValFact(AllocatorIntf *alloc);
+
+   /** Create a factory using a fixed size buffer. The buffer must be
+       aligned for double.
+   */
+   JParserCValFact(void *buf, size_t size);
+
+   /** Releases the buffer if allocated.
+    */
+   ~JParserCValFact();
+
+   /** Returns the root of the JCVal tree or NULL if no complete
+       document has been parsed.
+    */
+   JCVal *getFirstVal();
+
+   /** Discards the tree. The buffer is kept for the next document.
+    */
+   void termFirstVal();
+
+   /** Returns the number of bytes used by the tree, nodes and strings.
+    */
+   size_t getUsed();
+
+   /** Returns JParserValFactStat_OK or the error that made the
+       factory reject the document.
+    */
+   JParserValFactStat getStatus();
+#else
+typedef struct JParserCValFact
+{
+   JParserIntf super; /*Inherits from JParserIntf*/
+#endif
+   AllocatorIntf *alloc; /* NULL if the buffer is fixed */
+   U8 *buf;
+   size_t size;
+   size_t poolSize; /* Bytes used by strings at the end of buf */
+   U32 nodes;       /* Number of nodes */
+   U16 cur;         /* Open object or array, JCVAL_NIL if none */
+   BaBool done;     /* Document complete, buf is a JCVal tree */
+   JParserValFactStat status;
+} JParserCValFact;
+
+#define JCVAL_NIL 0xFFFF
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+   BA_API void JParserCValFact_constructor(
+       JParserCValFact *o, AllocatorIntf *alloc);
+   BA_API void JParserCValFact_constructor2(
+       JParserCValFact *o, void *buf, size_t size);
+#define JParserCValFact_getFirstVal(o) \
+   ((o)->done ? (JCVal *)(o)->buf : 0)
+   BA_API void JParserCValFact_termFirstVal(JParserCValFact *o);
+#define JParserCValFact_getUsed(o) \
+   ((o)->nodes * sizeof(JCVal) + (o)->poolSize)
+#define JParserCValFact_getStatus(o) (o)->status
+   BA_API void JParserCValFact_destructor(JParserCValFact *o);
+#ifdef __cplusplus
+}
+inline JParserCValFact::JParserCValFact(AllocatorIntf *alloc)
+{
+   JParserCValFact_constructor(this, alloc);
+}
+inline JParserCValFact::JParserCValFact(void *buf, size_t size)
+{
+   JParserCValFact_constructor2(this, buf, size);
+}
+inline JParserCValFact::~JParserCValFact()
+{
+   JParserCValFact_destructor(this);
+}
+inline JCVal *JParserCValFact::getFirstVal()
+{
+   return JParserCValFact_getFirstVal(this);
+}
+inline void JParserCValFact::termFirstVal()
+{
+   JParserCValFact_termFirstVal(this);
+}
+inline size_t JParserCValFact::getUsed()
+{
+   return JParserCValFact_getUsed(this);
+}
+inline JParserValFactStat JParserCValFact::getStatus()
+{
+   return JParserCValFact_getStatus(this);
+}
+#endif
+
+/** @} */ /* end of JSONCB */
+
+#endif
@@ -37,7 +37,7 @@
 #include <string.h>
 
 #define JDecoderV_val2Ix(o, val) (U16)(((U8*)val) - o->buf)
-#define JDecoderV_ix2Val(o, ix) (JDecoderV*)(o->buf + ix)
+#define JDecoderV_ix2Val(o, ix) ((JDecoderV*)((o)->buf + (ix)))
 
 
 static int
@@ -48,10 +48,49 @@ JDecoder_setStatus(JDecoder* o, JDecoderS s)
 }
 
 
+/* Member lookup table for object 'cv': the number of members followed
+ * by the member node indexes sorted by name.
+ */
+#define JDecoderV_memberTab(o, cv) ((U16*)((o)->buf + (cv)->u.child.tabIx))
+
+
+/* Prepare stack node 'sn' for receiving the children of container 'cv' */
+static void
+JDecoder_enter(JDecoder* o, JDecoderStackNode* sn, JDecoderV* cv)
+{
+   sn->contIx = JDecoderV_val2Ix(o, cv);
+   sn->isObj = cv->t == JParserT_BeginObject;
+   sn->nextIx = cv->u.child.firstIx;
+   sn->left = sn->isObj ? JDecoderV_memberTab(o, cv)[0] : 0;
+}
+
+
+/* Binary search for 'name' in the member table of object 'cv' */
+static JDecoderV*
+JDecoder_findMember(JDecoder* o, JDecoderV* cv, const char* name)
+{
+   U16* tab = JDecoderV_memberTab(o, cv);
+   int low = 1;
+   int high = tab[0];
+   while(low <= high)
+   {
+      int mid = (low + high) / 2;
+      JDecoderV* dv = JDecoderV_ix2Val(o, tab[mid]);
+      int cmp = strcmp(name, dv->name);
+      if( ! cmp )
+         return dv;
+      if(cmp < 0)
+         high = mid - 1;
+      else
+         low = mid + 1;
+   }
+   return 0;
+}
+
+
 static int
 JDecoder_buildValCB(JParserIntf* super, JParserVal* v, int reclevel)
 {
-   JDecoderV* dvp; /* parent */
    JDecoderV* dv; /* child */
    JDecoder* o = (JDecoder*)super;
    JDecoderStackNode* sn;
@@ -73,8 +112,7 @@ JDecoder_buildValCB(JParserIntf* super, JParserVal* v, int reclevel)
    if(v->t == JParserT_EndObject || v->t == JParserT_EndArray)
    {
       sn = o->stack + reclevel;
-      dvp = JDecoderV_ix2Val(o, sn->contIx);
-      if(dvp->u.child.firstIx)
+      if(sn->isObj ? sn->left : sn->nextIx)
          return JDecoder_setStatus(o, JDecoderS_Overflow);
       return 0;
    }
@@ -86,26 +124,23 @@ JDecoder_buildValCB(JParserIntf* super, JParserVal* v, int reclevel)
          return 0;
       }
       sn = o->stack + reclevel - 1;
-      dvp = JDecoderV_ix2Val(o, sn->contIx); /* parent */
-      if( ! dvp->u.child.firstIx )
-         return JDecoder_setStatus(o, JDecoderS_Underflow);
    }
-   dv = JDecoderV_ix2Val(o, dvp->u.child.firstIx); /* first child */
    if(*v->memberName) /* if member in object */
    {
       baAssert(sn->isObj);
-      dvp=0;
-      while( strcmp(v->memberName, dv->name) )
-      {
-         if( ! dv->nextIx )
-            return JDecoder_setStatus(o, JDecoderS_NameNotFound);
-         dvp = dv;
-         dv = JDecoderV_ix2Val(o, dv->nextIx);
-      }
+      if( ! sn->left )
+         return JDecoder_setStatus(o, JDecoderS_Underflow);
+      dv = JDecoder_findMember(
+         o, JDecoderV_ix2Val(o, sn->contIx), v->memberName);
+      if( ! dv || dv->done ) /* Not found or duplicate member name */
+         return JDecoder_setStatus(o, JDecoderS_NameNotFound);
    }
    else
    {
       baAssert( ! sn->isObj || reclevel == 0 );
+      if( ! sn->nextIx )
+         return JDecoder_setStatus(o, JDecoderS_Underflow);
+      dv = JDecoderV_ix2Val(o, sn->nextIx);
    }
    switch(v->t)
    {
@@ -125,8 +160,7 @@ JDecoder_buildValCB(JParserIntf* super, JParserVal* v, int reclevel)
                   return JDecoder_setStatus(o, JDecoderS_ChainedErr);
             }
          }
-         o->stack[reclevel].contIx = JDecoderV_val2Ix(o, dv);
-         o->stack[reclevel].isObj = v->t == JParserT_BeginObject;
+         JDecoder_enter(o, o->stack + reclevel, dv);
          break;
 
       case JParserT_Boolean:
@@ -173,40 +207,137 @@ JDecoder_buildValCB(JParserIntf* super, JParserVal* v, int reclevel)
          break;
 
       case JParserT_String: /* Fall through */
-         len = strlen(v->v.s);
+         /* Not zero terminated if the parser is in zero copy mode */
+         len = (int)v->len;
          if( (len + 1) >= dv->sSize)
             return JDecoder_setStatus(o, JDecoderS_StringOverflow);
-         strcpy(dv->u.s, v->v.s);
+         memcpy(dv->u.s, v->v.s, len);
+         dv->u.s[len] = 0;
          break;
 
       default:
          baAssert(0);
    }
 
-   /* unlink 'dv' */
+   /* Mark 'dv' as received. The tree is not modified such that it
+    * can be re-armed by JDecoder_reset.
+    */
    if(*v->memberName)
    {
-      if(dvp)
-         dvp->nextIx = dv->nextIx;
-      else
-      {
-         dvp = JDecoderV_ix2Val(o, sn->contIx); /* parent */
-         dvp->u.child.firstIx = dv->nextIx;
-      }
+      dv->done = TRUE;
+      sn->left--;
    }
    else
+      sn->nextIx = dv->nextIx;
+   return 0;
+}
+
+
+/* Allocate 'size' bytes for the value tree and, if 'depth' exceeds
+ * the embedded stack, the stack.
+ */
+static int
+JDecoder_allocate(JDecoder* o, int size, int depth)
+{
+   size_t asize;
+   int stackOffs = 0;
+   /* Node indexes are 16 bit */
+   if(size > 0xFFFF)
+      return JDecoder_setStatus(o, JDecoderS_NoMemory);
+   asize = (size_t)size;
+   if(depth > JPARSER_STACK_LEN)
+   {
+      stackOffs = (size + (int)sizeof(J_ALIGNMT) - 1) &
+         ~((int)sizeof(J_ALIGNMT) - 1);
+      asize = stackOffs + depth * sizeof(JDecoderStackNode);
+   }
+   if(o->buf)
+      AllocatorIntf_free(o->alloc, o->buf);
+   o->buf = (U8*)AllocatorIntf_malloc(o->alloc, &asize);
+   if( ! o->buf )
    {
-      dvp->u.child.firstIx = dv->nextIx;
+      o->bufSize = 0;
+      o->stack = o->stackBuf;
+      o->stacklen = JPARSER_STACK_LEN;
+      return JDecoder_setStatus(o, JDecoderS_NoMemory);
+   }
+   o->bufSize = size;
+   if(stackOffs)
+   {
+      o->stack = (JDecoderStackNode*)(o->buf + stackOffs);
+      o->stacklen = depth;
+   }
+   else
+   {
+      o->stack = o->stackBuf;
+      o->stacklen = JPARSER_STACK_LEN;
    }
    return 0;
 }
 
 
-static int
-JDecoder_expandBuf(JDecoder* o)
+int
+JDecoder_measure(const char* fmt, int* depth)
 {
-   (void)o;
-   return -1; /* not implemented */
+   U32 isObj = 0; /* One bit per level */
+   int level = -1;
+   int maxLevel = -1;
+   int nodes = 0;
+   int tabEntries = 0;
+   if(*fmt != '{' && *fmt != '[')
+      return -1;
+   for( ; *fmt ; fmt++)
+   {
+      switch(*fmt)
+      {
+         case '}':
+         case ']':
+            if(--level < 0 && fmt[1])
+               return -1;
+            continue;
+
+         case '{':
+         case '[':
+            if(level == 31)
+               return -1;
+            break;
+
+         case 'X':
+         case 'b':
+         case 'd':
+         case 'l':
+         case 'f':
+         case 's':
+            if(level < 0)
+               return -1;
+            break;
+
+         default:
+            return -1;
+      }
+      nodes++;
+      /* Each object member has an entry in the member table */
+      if(level >= 0 && (isObj >> level) & 1)
+         tabEntries++;
+      if(*fmt == '{' || *fmt == '[')
+      {
+         level++;
+         if(*fmt == '{')
+         {
+            isObj |= (U32)1 << level;
+            tabEntries++; /* The member count */
+         }
+         else
+            isObj &= ~((U32)1 << level);
+         if(level > maxLevel)
+            maxLevel = level;
+      }
+   }
+   if(level != -1)
+      return -1;
+   if(depth)
+      *depth = maxLevel + 1;
+   return nodes * (int)sizeof(JDecoderV) + tabEntries * (int)sizeof(U16);
 }
 
 
@@ -225,20 +356,79 @@ JDecoder_link(JDecoder* o, JDecoderStackNode* sn, JDecoderV* v)
 }
 
 
+/* Build the member lookup table for each object in the value tree.
+ * The tables are stored in 'buf' after the value nodes.
+ */
+static int
+JDecoder_buildMemberTabs(JDecoder* o)
+{
+   int ix;
+   int nodesSize = o->bufIx;
+   for(ix = 0 ; ix < nodesSize ; ix += sizeof(JDecoderV))
+   {
+      JDecoderV* cv = JDecoderV_ix2Val(o, ix);
+      U16* tab;
+      U16 cix;
+      int i, n;
+      if(cv->t != JParserT_BeginObject)
+         continue;
+      for(n = 0, cix = cv->u.child.firstIx ; cix ;
+          cix = JDecoderV_ix2Val(o, cix)->nextIx)
+      {
+         n++;
+      }
+      /* An allocated buffer is sized by JDecoder_measure, thus only a
+       * buffer provided by the caller can be too small.
+       */
+      if(o->bufIx + (int)sizeof(U16) * (n + 1) > o->bufSize)
+         return JDecoder_setStatus(o, JDecoderS_NoMemory);
+      cv->u.child.tabIx = (U16)o->bufIx;
+      tab = JDecoderV_memberTab(o, cv);
+      o->bufIx += sizeof(U16) * (n + 1);
+      tab[0] = (U16)n;
+      /* Insertion sort by member name */
+      for(n = 0, cix = cv->u.child.firstIx ; cix ;
+          cix = JDecoderV_ix2Val(o, cix)->nextIx)
+      {
+         const char* name = JDecoderV_ix2Val(o, cix)->name;
+         for(i = n ; i > 0 &&
+                strcmp(JDecoderV_ix2Val(o, tab[i])->name, name) > 0 ; i--)
+         {
+            tab[i+1] = tab[i];
+         }
+         tab[i+1] = cix;
+         n++;
+      }
+   }
+   o->planSize = nodesSize;
+   return 0;
+}
+
 
 int
 JDecoder_vget(JDecoder* o, const char* fmt, va_list* argList)
 {
    int stackIx = -1;
    JDecoderV* v;
-   JDecoderStackNode* sn = o->stack;
+   JDecoderStackNode* sn;
    o->status = JDecoderS_OK;
    o->pIntf=0;
    o->bufIx=0;
+   o->planSize=0;
 
+   if(o->alloc)
+   {
+      int depth;
+      int size = JDecoder_measure(fmt, &depth);
+      if(size < 0)
+         return JDecoder_setStatus(o, JDecoderS_FormatErr);
+      if(JDecoder_allocate(o, size, depth))
+         return -1;
+   }
    if(J_POINTER_NOT_ALIGNED(o->buf))
       return JDecoder_setStatus(o, JDecoderS_BufNotAligned);
 
+   sn = o->stack;
    if(*fmt != '{' && *fmt != '[')
       return JDecoder_setStatus(o, JDecoderS_Unbalanced);
    sn->isObj = *fmt == '{';
@@ -259,15 +449,10 @@ JDecoder_vget(JDecoder* o, const char* fmt, va_list* argList)
       }
       v = JDecoderV_ix2Val(o, o->bufIx);
       o->bufIx += sizeof(JDecoderV);
-      if(o->bufIx >= o->bufSize)
-      {
-         if(stackIx == 0 && (*fmt == '}' || *fmt == ']'))
-            return JDecoder_setStatus(o, JDecoderS_Unbalanced);
-         if(JDecoder_expandBuf(o))
-            return -1;
-         sn = o->stack+stackIx;
-      }
+      if(o->bufIx > o->bufSize)
+         return JDecoder_setStatus(o, JDecoderS_NoMemory);
       v->t = *fmt;
+      v->done = FALSE;
       v->name = stackIx >= 0 && sn->isObj && *fmt != 'X' ?
          va_arg(*argList, const char*) : "";
       v->nextIx = 0;
@@ -306,6 +491,24 @@ JDecoder_vget(JDecoder* o, const char* fmt, va_list* argList)
    }
    if( stackIx || fmt[1] )
       return JDecoder_setStatus(o, JDecoderS_Unbalanced);
+   if(JDecoder_buildMemberTabs(o))
+      return -1;
+   JDecoder_enter(o, o->stack, JDecoderV_ix2Val(o, 0));
+   return 0;
+}
+
+
+int
+JDecoder_reset(JDecoder* o)
+{
+   int ix;
+   if( ! o->planSize )
+      return -1; /* JDecoder_vget failed or not called */
+   for(ix = 0 ; ix < o->planSize ; ix += sizeof(JDecoderV))
+      JDecoderV_ix2Val(o, ix)->done = FALSE;
+   o->status = JDecoderS_OK;
+   o->pIntf = 0;
+   JDecoder_enter(o, o->stack, JDecoderV_ix2Val(o, 0));
    return 0;
 }
 
@@ -329,5 +532,28 @@ JDecoder_constructor(JDecoder* o, U8* buf, int bufSize, int extraStackLen)
    JParserIntf_constructor((JParserIntf*)o, JDecoder_buildValCB);
    o->buf=buf;
    o->bufSize = bufSize;
+   o->planSize = 0;
+   o->alloc = 0;
+   o->stack = o->stackBuf;
    o->stacklen = JPARSER_STACK_LEN + extraStackLen;
 }
+
+
+void
+JDecoder_constructor2(JDecoder* o, AllocatorIntf* alloc)
+{
+   JDecoder_constructor(o, 0, 0, 0);
+   o->alloc = alloc;
+}
+
+
+void
+JDecoder_destructor(JDecoder* o)
+{
+   if(o->alloc && o->buf)
+   {
+      AllocatorIntf_free(o->alloc, o->buf);
+      o->buf = 0;
+      o->planSize = 0;
+   }
+}
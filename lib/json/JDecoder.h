@@ -87,6 +87,11 @@ typedef enum
     */
    JDecoderS_ChainedErr,
 
+   /** The buffer provided in the JDecoder constructor is too small for
+    * the value tree, or the allocator failed.
+    */
+   JDecoderS_NoMemory,
+
    /** OK, no errors
     */
    JDecoderS_OK = 0
@@ -96,6 +101,8 @@ typedef enum
 typedef struct
 {
    U16 contIx; /* container (object or array) index */
+   U16 nextIx; /* next array element expected, if array */
+   U16 left;   /* members not yet received, if object */
    U8 isObj;   /* 1 if object, 0 if array */
 } JDecoderStackNode;
 
@@ -117,13 +124,15 @@ typedef struct
       {
          U16 firstIx;
          U16 lastIx;      /* used via JDecoder_vget only */
+         U16 tabIx;       /* Member table sorted by name, if object */
       } child;            /* if t == container (object or array) */
       JParserIntf *pIntf; /* for 'X' */
    } u;
    const char *name; /* Member name, if parent is an object */
    S32 sSize;        /* Size (len+1) of s buffer ( if t == s ) */
    U16 nextIx;
-   U8 t; /* JVType */
+   U8 t;    /* JVType */
+   U8 done; /* Set when the value is received. Cleared by reset */
 } JDecoderV;
 
 /** JDecoder implements the parser callback API JParserIntf and builds
@@ -145,6 +154,12 @@ typedef struct JDecoder
        parser callback function when the parser feeds elements to the
        JDecoder instance.
 
+       The value tree is not consumed by the parser callback. Call
+       method get once and then call method reset before parsing each
+       new message. This avoids interpreting the format string and the
+       variable argument list for every message. Use one JDecoder
+       instance per message type.
+
        \param fmt format flags:
       <table>
       <tr><th>JSON type</th><th>Format flag</th><th>C type</th></tr>
@@ -167,21 +182,55 @@ typedef struct JDecoder
       \sa JD_MSTR
       \sa JD_ASTR
       \sa JEncoder::set
+      \sa reset
     */
    int get(const char *fmt, ...);
 
+   /** Re-arm the value tree built by method get for a new message.
+       Returns 0 on success and -1 if method get failed or has not
+       been called.
+   */
+   int reset();
+
    /** Create/initialize a JDecoder instance.
 
        \param buf is a pointer to a buffer used internally for memory
        storage when building the pointer value tree. The minimum size
-       must be sizeof(JDecoderV) * N, where N is the number of format
-       flags minus the end of array/object flags (] or }).
+       must be sizeof(JDecoderV) * N + 2 * (M + O), where N is the
+       number of format flags minus the end of array/object flags
+       (] or }), M is the number of object members, and O is the
+       number of objects. The M + O part holds the member lookup
+       tables.
 
        \param bufSize the size of 'buf'
 
        \param extraStackLen is a non documented value and must be set to 0.
+       \sa JDecoder::measure
    */
    JDecoder(U8 *buf, int bufSize, int extraStackLen = 0);
+
+   /** Create a JDecoder that allocates the value tree storage and, for
+       formats nested deeper than JPARSER_STACK_LEN, the stack. Method
+       get measures the format and makes one allocation of the exact
+       size needed. Note that the JParser feeding the decoder has its
+       own stack, see the JParser extraStackLen argument.
+       \param alloc the allocator.
+   */
+   JDecoder(AllocatorIntf *alloc);
+
+   /** Release the memory allocated by method get, if any. */
+   ~JDecoder();
+
+   /** Returns the number of bytes method get needs in the buffer
+       passed to the constructor for format 'fmt', or -1 if the format
+       is invalid. Use this method when sizing the buffer for a message
+       type.
+       \param fmt the format, see method get.
+       \param depth optional, receives the stack depth needed. Formats
+       nested deeper than JPARSER_STACK_LEN require the allocator
+       constructor.
+   */
+   static int measure(const char *fmt, int *depth = 0);
 #if 0
 }
 #endif
@@ -191,12 +240,16 @@ typedef struct JDecoder
 #endif
    JDecoderS status;
    JParserIntf *pIntf;
+   AllocatorIntf *alloc; /* Set if 'buf' is allocated by JDecoder_vget */
    int startServiceLevel;
    U8 *buf;
    int bufIx;
    int bufSize;
+   int planSize; /* Size of the value nodes when JDecoder_vget succeeded */
    int stacklen;
-   JDecoderStackNode stack[JPARSER_STACK_LEN];
+   JDecoderStackNode *stack; /* stackBuf or allocated with 'buf' */
+   /* Must be last; the stack can be extended, see 'extraStackLen' */
+   JDecoderStackNode stackBuf[JPARSER_STACK_LEN];
 } JDecoder;
 
 /** JDecoder::get helper macro, used when setting a number pointer in an object.
@@ -221,8 +274,12 @@ extern "C"
 
    int JDecoder_vget(JDecoder *o, const char *fmt, va_list *argList);
    int JDecoder_get(JDecoder *o, const char *fmt, ...);
+   int JDecoder_reset(JDecoder *o);
    void JDecoder_constructor(
        JDecoder *o, U8 *buf, int bufSize, int extraStackLen);
+   void JDecoder_constructor2(JDecoder *o, AllocatorIntf *alloc);
+   void JDecoder_destructor(JDecoder *o);
+   int JDecoder_measure(const char *fmt, int *depth);
 #ifdef __cplusplus
 }
 inline int JDecoder::vget(const char *fmt, va_list *argList)
@@ -238,10 +295,26 @@ inline int JDecoder::get(const char *fmt, ...)
    va_end(argList);
    return stat;
 }
+inline int JDecoder::reset()
+{
+   return JDecoder_reset(this);
+}
 inline JDecoder::JDecoder(U8 *buf, int bufSize, int extraStackLen)
 {
    JDecoder_constructor(this, buf, bufSize, extraStackLen);
 }
+inline JDecoder::JDecoder(AllocatorIntf *alloc)
+{
+   JDecoder_constructor2(this, alloc);
+}
+inline JDecoder::~JDecoder()
+{
+   JDecoder_destructor(this);
+}
+inline int JDecoder::measure(const char *fmt, int *depth)
+{
+   return JDecoder_measure(fmt, depth);
+}
 #endif
 
 /** @} */ /* end of JSONCB */
@@ -46,6 +46,10 @@ devices, enables the use of the JEncoder without requiring JVal.c
 The above disables function JEncoder::setJV and the format flag 'J'
 for function JEncoder_set/JEncoder_vSetJV
 
+Remove the CBOR (RFC 8949) output format by defining:
+
+#define NO_CBOR
+
 */
 
 #ifndef BA_LIB
@@ -74,14 +78,97 @@ JEncoder_setIoErr(JEncoder *o)
    return -1;
 }
 
+#ifdef NO_CBOR
+#define JEncoder_isCBOR(o) FALSE
+#define JEncoder_cborPutc(o, c) -1
+#else
+#define JEncoder_isCBOR(o) (o)->cbor
+
+/* CBOR major types */
+#define CBOR_UINT 0
+#define CBOR_NINT 1
+#define CBOR_BYTES 2
+#define CBOR_TEXT 3
+
+/* Write the initial byte 'ib' followed by the 'size' least significant
+   bytes of 'val' in network byte order.
+*/
+static int
+JEncoder_cborPut(JEncoder *o, U8 ib, U64 val, int size)
+{
+   U8 b[9];
+   int i;
+   b[0] = ib;
+   for (i = size; i > 0; i--)
+   {
+      b[i] = (U8)val;
+      val >>= 8;
+   }
+   if (BufPrint_write(o->out, b, size + 1) < 0)
+      return JEncoder_setIoErr(o);
+   return 0;
+}
+
+/* Write a data item head using the shortest argument encoding */
+static int
+JEncoder_cborHead(JEncoder *o, int major, U64 val)
+{
+   U8 ib = (U8)(major << 5);
+   if (val < 24)
+      return JEncoder_cborPut(o, (U8)(ib | val), 0, 0);
+   if (val <= 0xFF)
+      return JEncoder_cborPut(o, ib | 24, val, 1);
+   if (val <= 0xFFFF)
+      return JEncoder_cborPut(o, ib | 25, val, 2);
+   if (val <= 0xFFFFFFFF)
+      return JEncoder_cborPut(o, ib | 26, val, 4);
+   return JEncoder_cborPut(o, ib | 27, val, 8);
+}
+
+static int
+JEncoder_cborPutc(JEncoder *o, U8 c)
+{
+   return JEncoder_cborPut(o, c, 0, 0);
+}
+
+static int
+JEncoder_cborInt(JEncoder *o, S64 val)
+{
+   return val < 0 ? JEncoder_cborHead(o, CBOR_NINT, (U64)(-1 - val)) :
+      JEncoder_cborHead(o, CBOR_UINT, (U64)val);
+}
+
+static int
+JEncoder_cborString(JEncoder *o, int major, const void *str, size_t len)
+{
+   if (JEncoder_cborHead(o, major, len))
+      return -1;
+   if (BufPrint_write(o->out, str, (int)len) < 0)
+      return JEncoder_setIoErr(o);
+   return 0;
+}
+
+/* BufPrint flush callback used for measuring the length of a
+   formatted string.
+*/
+static int
+JEncoder_cborCount(BufPrint *bp, int sizeRequired)
+{
+   (void)sizeRequired;
+   *(int *)bp->userData += bp->cursor;
+   bp->cursor = 0;
+   return 0;
+}
+#endif
+
 static int
 JEncoder_setCommaSep(JEncoder *o)
 {
    if (o->startNewObj)
       o->startNewObj = FALSE;
-   else
+   else if (!JEncoder_isCBOR(o))
    {
-      if (BufPrint_printf(o->out, ",") < 0)
+      if (BufPrint_putc(o->out, ',') < 0)
       {
          JEncoder_setIoErr(o);
          return -1;
@@ -153,7 +240,11 @@ int JEncoder_setInt(JEncoder *o, S32 val)
 {
    if (JEncoder_beginValue(o, FALSE))
    {
-      if (BufPrint_printf(o->out, "%d", val) < 0)
+#ifndef NO_CBOR
+      if (JEncoder_isCBOR(o))
+         return JEncoder_cborInt(o, val);
+#endif
+      if (BufPrint_fmtInt(o->out, val, 0) < 0)
          return JEncoder_setIoErr(o);
       return 0;
    }
@@ -164,7 +255,11 @@ int JEncoder_setLong(JEncoder *o, S64 val)
 {
    if (JEncoder_beginValue(o, FALSE))
    {
-      if (BufPrint_printf(o->out, "%lld", val) < 0)
+#ifndef NO_CBOR
+      if (JEncoder_isCBOR(o))
+         return JEncoder_cborInt(o, val);
+#endif
+      if (BufPrint_fmtInt(o->out, val, 0) < 0)
          return JEncoder_setIoErr(o);
       return 0;
    }
@@ -176,7 +271,30 @@ int JEncoder_setDouble(JEncoder *o, double val)
 {
    if (JEncoder_beginValue(o, FALSE))
    {
-      if (BufPrint_printf(o->out, "%f", val) < 0)
+#ifndef NO_CBOR
+      if (JEncoder_isCBOR(o))
+      {
+         /* NaN and Inf are encoded as null, as in the JSON output.
+            Values exactly representable as float use 4 bytes.
+          */
+         if (val != val || val - val != 0)
+            return JEncoder_cborPutc(o, 0xF6);
+         if ((double)(float)val == val)
+         {
+            float f = (float)val;
+            U32 u;
+            memcpy(&u, &f, sizeof(u));
+            return JEncoder_cborPut(o, 0xFA, u, 4);
+         }
+         else
+         {
+            U64 u;
+            memcpy(&u, &val, sizeof(u));
+            return JEncoder_cborPut(o, 0xFB, u, 8);
+         }
+      }
+#endif
+      if (BufPrint_fmtDouble(o->out, val) < 0)
          return JEncoder_setIoErr(o);
       return 0;
    }
@@ -190,9 +308,15 @@ int JEncoder_setString(JEncoder *o, const char *val)
    {
       if (val)
       {
+#ifndef NO_CBOR
+         if (JEncoder_isCBOR(o))
+            return JEncoder_cborString(o, CBOR_TEXT, val, strlen(val));
+#endif
          if (BufPrint_jsonString(o->out, val) < 0)
             return JEncoder_setIoErr(o);
       }
+      else if (JEncoder_isCBOR(o))
+         return JEncoder_cborPutc(o, 0xF6);
       else
       {
          if (BufPrint_write(o->out, "null", -1) < 0)
@@ -207,12 +331,18 @@ int JEncoder_b64enc(JEncoder *o, const void *source, S32 slen)
 {
    if (JEncoder_beginValue(o, FALSE))
    {
+#ifndef NO_CBOR
+      /* CBOR has a native byte string type */
+      if (JEncoder_isCBOR(o))
+         return JEncoder_cborString(o, CBOR_BYTES, source, (size_t)slen);
+#endif
       if (BufPrint_putc(o->out, '"') ||
           BufPrint_b64Encode(o->out, source, slen) < 0 ||
           BufPrint_putc(o->out, '"'))
       {
          return JEncoder_setIoErr(o);
       }
+      return 0;
    }
    return -1;
 }
@@ -223,6 +353,27 @@ int JEncoder_vFmtString(JEncoder *o, const char *fmt, va_list argList)
    {
       if (fmt)
       {
+#ifndef NO_CBOR
+         if (JEncoder_isCBOR(o))
+         {
+            /* Format twice: the first pass measures the length */
+            char buf[32];
+            BufPrint bp;
+            int len = 0;
+            va_list cpy;
+            va_copy(cpy, argList);
+            BufPrint_constructor2(
+               &bp, buf, sizeof(buf), &len, JEncoder_cborCount);
+            BufPrint_vprintf(&bp, fmt, cpy);
+            va_end(cpy);
+            BufPrint_flush(&bp);
+            if (JEncoder_cborHead(o, CBOR_TEXT, (U64)len))
+               return -1;
+            if (BufPrint_vprintf(o->out, fmt, argList) < 0)
+               return JEncoder_setIoErr(o);
+            return 0;
+         }
+#endif
          if (BufPrint_putc(o->out, '"') ||
              BufPrint_vprintf(o->out, fmt, argList) < 0 ||
              BufPrint_putc(o->out, '"'))
@@ -230,6 +381,8 @@ int JEncoder_vFmtString(JEncoder *o, const char *fmt, va_list argList)
             return JEncoder_setIoErr(o);
          }
       }
+      else if (JEncoder_isCBOR(o))
+         return JEncoder_cborPutc(o, 0xF6);
       else
       {
          if (BufPrint_write(o->out, "null", -1) < 0)
@@ -244,7 +397,9 @@ int JEncoder_setBoolean(JEncoder *o, BaBool val)
 {
    if (JEncoder_beginValue(o, FALSE))
    {
-      if (BufPrint_printf(o->out, "%s", val ? "true" : "false") < 0)
+      if (JEncoder_isCBOR(o))
+         return JEncoder_cborPutc(o, val ? 0xF5 : 0xF4);
+      if (BufPrint_write(o->out, val ? "true" : "false", val ? 4 : 5) < 0)
          return JEncoder_setIoErr(o);
       return 0;
    }
@@ -255,6 +410,8 @@ int JEncoder_setNull(JEncoder *o)
 {
    if (JEncoder_beginValue(o, FALSE))
    {
+      if (JEncoder_isCBOR(o))
+         return JEncoder_cborPutc(o, 0xF6);
       if (BufPrint_write(o->out, "null", -1) < 0)
          return JEncoder_setIoErr(o);
       return 0;
@@ -262,6 +419,17 @@ int JEncoder_setNull(JEncoder *o)
    return -1;
 }
 
+int JEncoder_setRaw(JEncoder *o, const void *data, int len)
+{
+   if (JEncoder_beginValue(o, FALSE))
+   {
+      if (BufPrint_write(o->out, data, len) < 0)
+         return JEncoder_setIoErr(o);
+      return 0;
+   }
+   return -1;
+}
+
 #ifdef NO_JVAL_DEPENDENCY
 #define JEncoder_setJV(o, val, x)                                  \
    JErr_setError(o->err, JErrT_FmtValErr, "Feature 'J' Disabled"); \
@@ -331,7 +499,13 @@ int JEncoder_setName(JEncoder *o, const char *name)
 {
    if (JEncoder_beginValue(o, TRUE))
    {
-      if (BufPrint_printf(o->out, "\"%s\":", name) < 0)
+#ifndef NO_CBOR
+      if (JEncoder_isCBOR(o))
+         return JEncoder_cborString(o, CBOR_TEXT, name, strlen(name));
+#endif
+      if (BufPrint_putc(o->out, '"') < 0 ||
+          BufPrint_write(o->out, name, -1) < 0 ||
+          BufPrint_write(o->out, "\":", 2) < 0)
          return JEncoder_setIoErr(o);
       return 0;
    }
@@ -347,9 +521,12 @@ int JEncoder_beginObject(JEncoder *o)
          /* Set current stack position to "isObject" */
          o->objectStack.level++;
          JEncoder_setObject(o);
-         if (BufPrint_write(o->out, "{", -1) < 0)
-            return JEncoder_setIoErr(o);
          o->startNewObj = TRUE;
+         /* CBOR: indefinite length map */
+         if (JEncoder_isCBOR(o))
+            return JEncoder_cborPutc(o, 0xBF);
+         if (BufPrint_putc(o->out, '{') < 0)
+            return JEncoder_setIoErr(o);
          return 0;
       }
       JErr_setError(o->err, JErrT_FmtValErr,
@@ -366,11 +543,14 @@ int JEncoder_endObject(JEncoder *o)
       {
          if (JEncoder_isObject(o))
          {
-            if (BufPrint_printf(o->out, "}", -1) < 0)
-               return JEncoder_setIoErr(o);
             JEncoder_clearObject(o);
             o->objectStack.level--;
             o->startNewObj = FALSE;
+            /* CBOR: "break" */
+            if (JEncoder_isCBOR(o))
+               return JEncoder_cborPutc(o, 0xFF);
+            if (BufPrint_putc(o->out, '}') < 0)
+               return JEncoder_setIoErr(o);
             return 0;
          }
          JErr_setError(o->err, JErrT_FmtValErr,
@@ -390,9 +570,12 @@ int JEncoder_beginArray(JEncoder *o)
       if (o->objectStack.level < (sizeof(o->objectStack.data) * 8))
       {
          o->objectStack.level++;
-         if (BufPrint_printf(o->out, "[", -1) < 0)
-            return JEncoder_setIoErr(o);
          o->startNewObj = TRUE;
+         /* CBOR: indefinite length array */
+         if (JEncoder_isCBOR(o))
+            return JEncoder_cborPutc(o, 0x9F);
+         if (BufPrint_putc(o->out, '[') < 0)
+            return JEncoder_setIoErr(o);
          return 0;
       }
       JErr_setError(o->err, JErrT_FmtValErr,
@@ -410,10 +593,12 @@ int JEncoder_endArray(JEncoder *o)
       {
          if (!JEncoder_isObject(o))
          {
-            if (BufPrint_printf(o->out, "]", -1) < 0)
-               return JEncoder_setIoErr(o);
             o->objectStack.level--;
             o->startNewObj = FALSE;
+            if (JEncoder_isCBOR(o))
+               return JEncoder_cborPutc(o, 0xFF);
+            if (BufPrint_putc(o->out, ']') < 0)
+               return JEncoder_setIoErr(o);
             return 0;
          }
          JErr_setError(o->err, JErrT_FmtValErr,
@@ -79,7 +79,10 @@ typedef struct JEncoder
       int setLong(S64 val);
 #ifndef NO_DOUBLE
 
-      /** Format a double value.
+      /** Format a double value using the shortest representation
+          that parses back to the same value. NaN and Inf are
+          encoded as null.
+          \sa BufPrint::fmtDouble
        */
       int setDouble(double val);
 #endif
@@ -113,6 +116,13 @@ typedef struct JEncoder
        */
       int setNull();
 
+      /** Emit 'len' bytes of pre-encoded data as the next value. The
+          data must be one complete JSON value, or one CBOR data item
+          in CBOR mode; it is written as is.
+          \sa JTemplate
+       */
+      int setRaw(const void* data, int len);
+
       /** Format a node or a tree of JVal nodes.
        */
       int setJV(struct JVal* val, bool iterateNext=false);
@@ -204,10 +214,27 @@ typedef struct JEncoder
        */
       int commit();
 
+      /** Enables the construction of a new object without flushing,
+          so several messages can be sent with one flush.
+       */
+      void endMessage();
+
       /** Fetch the internal BufPrint object.
        */
       BufPrint* getBufPrint();
 
+      /** Switch between JSON text and CBOR (RFC 8949) output. In CBOR
+          mode, the same methods emit binary data items: objects and
+          arrays are indefinite length maps and arrays, doubles are
+          encoded as float when exact, and b64enc emits a byte
+          string. The output can be parsed by CBORParser.
+
+          Must be called between two messages. The CBOR format is
+          not available if the code is compiled with NO_CBOR.
+          \sa CBORParser
+       */
+      void setCBOR(bool enable);
+
 #endif
       JErr* err;
       struct
@@ -218,6 +245,7 @@ typedef struct JEncoder
       BufPrint* out;
       BaBool objectMember;
       BaBool startNewObj;
+      BaBool cbor;
 } JEncoder;
 #ifdef __cplusplus
 extern "C" {
@@ -226,6 +254,7 @@ BA_API void JEncoder_constructor(JEncoder* o, JErr* err, BufPrint* out);
 #define JEncoder_destructor(o) JEncoder_flush(o)
 BA_API int JEncoder_flush(JEncoder* o);
 BA_API int JEncoder_commit(JEncoder* o);
+#define JEncoder_endMessage(o) ((o)->startNewObj = TRUE)
 #define JEncoder_getErr(o) (o)->err
 BA_API int JEncoder_setInt(JEncoder* o, S32 val);
 BA_API int JEncoder_setLong(JEncoder* o, S64 val);
@@ -242,6 +271,7 @@ BA_API int JEncoder_setString(JEncoder* o, const char* val);
 BA_API int JEncoder_b64enc(JEncoder* o, const void* source, S32 slen);
 BA_API int JEncoder_setBoolean(JEncoder* o, BaBool val);
 BA_API int JEncoder_setNull(JEncoder* o);
+BA_API int JEncoder_setRaw(JEncoder* o, const void* data, int len);
 BA_API int JEncoder_setJV(
    JEncoder* o, struct JVal* val, BaBool iterateNext);
 BA_API int JEncoder_vSetJV(
@@ -253,6 +283,7 @@ BA_API int JEncoder_endObject(JEncoder* o);
 BA_API int JEncoder_beginArray(JEncoder* o);
 BA_API int JEncoder_endArray(JEncoder* o);
 #define JEncoder_getBufPrint(o) (o)->out
+#define JEncoder_setCBOR(o, enable) (o)->cbor = (enable) ? TRUE : FALSE
 #ifdef __cplusplus
 }
 inline JEncoder::JEncoder(JErr* err, BufPrint* out) {
@@ -284,6 +315,8 @@ inline int JEncoder::setBoolean(bool val) {
    return  JEncoder_setBoolean(this, val ? TRUE : FALSE); }
 inline int JEncoder::setNull() {
    return  JEncoder_setNull(this); }
+inline int JEncoder::setRaw(const void* data, int len) {
+   return  JEncoder_setRaw(this, data, len); }
 inline int JEncoder::setJV(struct JVal* val, bool iterateNext) {
    return  JEncoder_setJV(this,val,iterateNext?TRUE:FALSE); }
 inline int JEncoder::set(const char* fmt, ...) {
@@ -309,8 +342,12 @@ inline int JEncoder::flush() {
    return JEncoder_flush(this); }
 inline int JEncoder::commit() {
    return JEncoder_commit(this); }
+inline void JEncoder::endMessage() {
+   JEncoder_endMessage(this); }
 inline BufPrint* JEncoder::getBufPrint() {
    return JEncoder_getBufPrint(this); }
+inline void JEncoder::setCBOR(bool enable) {
+   JEncoder_setCBOR(this, enable); }
 #endif
 
 /** JEncoder::set helper macro, used when setting a value for an object.
@@ -0,0 +1,168 @@
+/*
+ * Message framing for JSON and CBOR streams, see JFramer.h.
+ */
+
+#ifndef BA_LIB
+#define BA_LIB 1
+#endif
+
+#include "JFramer.h"
+#include <string.h>
+
+/* Pass a newline delimited frame on, less a trailing '\r' */
+static int
+JFramer_line(JFramer *o, const U8 *frame, U32 len)
+{
+   if (len && frame[len - 1] == '\r')
+      len--;
+   return len ? o->frameCB(o, frame, len) : 0;
+}
+
+static int
+JFramer_feedLines(JFramer *o, const U8 *data, U32 len)
+{
+   while (len)
+   {
+      const U8 *nl = (const U8 *)memchr(data, '\n', len);
+      U32 n = nl ? (U32)(nl - data) : len;
+      if (o->skipping)
+      {
+         if (nl)
+            o->skipping = FALSE;
+      }
+      else if (!o->ix && nl)
+      {
+         /* The complete frame is in 'data' */
+         if (JFramer_line(o, data, n) < 0)
+            return -1;
+      }
+      else if (o->ix + n > o->bufSize)
+      {
+         o->dropped++;
+         o->ix = 0;
+         o->skipping = nl ? FALSE : TRUE;
+      }
+      else
+      {
+         memcpy(o->buf + o->ix, data, n);
+         o->ix += n;
+         if (nl)
+         {
+            U32 frameLen = o->ix;
+            o->ix = 0;
+            if (JFramer_line(o, o->buf, frameLen) < 0)
+               return -1;
+         }
+      }
+      if (!nl)
+         break;
+      n++; /* The '\n' */
+      data += n;
+      len -= n;
+   }
+   return 0;
+}
+
+/* The frame header is complete */
+static void
+JFramer_setFrameLen(JFramer *o, const U8 *hdr)
+{
+   o->frameLen = (U32)hdr[0] << 24 | (U32)hdr[1] << 16 |
+      (U32)hdr[2] << 8 | hdr[3];
+   o->hdrLen = JFRAMER_HDR_SIZE;
+   o->ix = 0;
+   if (o->frameLen > o->bufSize)
+   {
+      o->dropped++;
+      o->skipLen = o->frameLen;
+   }
+   else if (!o->frameLen)
+      o->hdrLen = 0;
+}
+
+static int
+JFramer_feedLength(JFramer *o, const U8 *data, U32 len)
+{
+   while (len)
+   {
+      U32 n;
+      if (o->hdrLen < JFRAMER_HDR_SIZE)
+      {
+         if (!o->hdrLen && len >= JFRAMER_HDR_SIZE)
+         {
+            JFramer_setFrameLen(o, data);
+            data += JFRAMER_HDR_SIZE;
+            len -= JFRAMER_HDR_SIZE;
+         }
+         else
+         {
+            o->hdr[o->hdrLen++] = *data++;
+            len--;
+            if (o->hdrLen == JFRAMER_HDR_SIZE)
+               JFramer_setFrameLen(o, o->hdr);
+         }
+         continue;
+      }
+      if (o->skipLen)
+      {
+         n = len < o->skipLen ? len : o->skipLen;
+         o->skipLen -= n;
+         if (!o->skipLen)
+            o->hdrLen = 0;
+      }
+      else if (!o->ix && len >= o->frameLen)
+      {
+         /* The complete frame is in 'data' */
+         n = o->frameLen;
+         o->hdrLen = 0;
+         if (o->frameCB(o, data, n) < 0)
+            return -1;
+      }
+      else
+      {
+         n = o->frameLen - o->ix;
+         if (n > len)
+            n = len;
+         memcpy(o->buf + o->ix, data, n);
+         o->ix += n;
+         if (o->ix == o->frameLen)
+         {
+            o->ix = 0;
+            o->hdrLen = 0;
+            if (o->frameCB(o, o->buf, o->frameLen) < 0)
+               return -1;
+         }
+      }
+      data += n;
+      len -= n;
+   }
+   return 0;
+}
+
+void
+JFramer_constructor(JFramer *o, JFramerT t, U8 *buf, U32 size,
+                    void *userData, JFramer_FrameCB frameCB)
+{
+   memset(o, 0, sizeof(JFramer));
+   o->type = (U8)t;
+   o->buf = buf;
+   o->bufSize = size;
+   o->userData = userData;
+   o->frameCB = frameCB;
+}
+
+int
+JFramer_feed(JFramer *o, const U8 *data, U32 len)
+{
+   return o->type == JFramerT_Length ? JFramer_feedLength(o, data, len) :
+      JFramer_feedLines(o, data, len);
+}
+
+void
+JFramer_reset(JFramer *o)
+{
+   o->ix = 0;
+   o->hdrLen = 0;
+   o->skipLen = 0;
+   o->skipping = FALSE;
+}
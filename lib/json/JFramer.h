@@ -0,0 +1,147 @@
+/*
+ * Message framing for JSON and CBOR streams.
+ */
+
+#ifndef __JFramer_h
+#define __JFramer_h
+
+#include "JParser.h"
+
+/** @addtogroup JSONCB
+@{
+*/
+
+/** Size of the length prefix in JFramerT_Length mode. */
+#define JFRAMER_HDR_SIZE 4
+
+/** Framing modes */
+typedef enum
+{
+   /** Messages are separated by '\\n' (NDJSON). For JSON text only,
+       since a CBOR message may contain the byte 0x0A. Empty lines and
+       a '\\r' before the '\\n' are ignored.
+    */
+   JFramerT_Newline,
+
+   /** Each message is preceded by its length as a 4 byte big endian
+       integer. Messages of length zero are ignored.
+    */
+   JFramerT_Length
+} JFramerT;
+
+struct JFramer;
+
+/** Called for each complete frame.
+    \param o the framer.
+    \param frame the message, which points into the buffer passed to
+    JFramer_feed if the frame is in one chunk, and into the framer's
+    assembly buffer otherwise. The frame is not zero terminated and is
+    only valid during the callback.
+    \param len the message length.
+    \returns a negative value to stop JFramer_feed.
+*/
+typedef int (*JFramer_FrameCB)(struct JFramer *o, const U8 *frame, U32 len);
+
+/** JFramer splits a byte stream into messages, so a parser can be
+    given complete messages instead of finding the message boundaries
+    in the stream:
+
+    \code
+    static int frameCB(JFramer* o, const U8* frame, U32 len)
+    {
+       JParser* p = (JParser*)o->userData;
+       if(JParser_parse(p, frame, len) <= 0 ||
+          JParser_getStatus(p) != JParsStat_DoneEOS)
+       {
+          JParser_reset(p); // Malformed, skip it
+       }
+       return 0;
+    }
+    \endcode
+
+    A frame that is complete in the chunk passed to JFramer_feed is
+    passed on without copying. Only frames split between two chunks
+    are assembled in 'buf'. Since the parser receives whole messages,
+    it never copies a token split between two parse buffers.
+
+    Frames longer than the assembly buffer are skipped without being
+    lexed and are counted in 'dropped'. In length mode, the bytes of a
+    skipped frame are not even scanned.
+*/
+typedef struct JFramer
+{
+#ifdef __cplusplus
+   /** Create a framer.
+       \param t the framing mode.
+       \param buf the assembly buffer, which also sets the maximum
+       frame size.
+       \param size sizeof(buf).
+       \param userData optional data for the callback.
+       \param frameCB the callback receiving the frames.
+   */
+   JFramer(JFramerT t, U8 *buf, U32 size, void *userData,
+           JFramer_FrameCB frameCB);
+
+   /** Split the chunk into frames and call the callback for each
+       complete frame.
+       \returns 0 or the negative value returned by the callback.
+   */
+   int feed(const U8 *data, U32 len);
+
+   /** Discard a partially received frame. */
+   void reset();
+#endif
+   JFramer_FrameCB frameCB;
+   void *userData;
+   U8 *buf;
+   U32 bufSize;
+   U32 ix;       /* Bytes assembled in 'buf' */
+   U32 frameLen; /* Length mode: size of the current frame */
+   U32 skipLen;  /* Length mode: bytes left of a skipped frame */
+   U32 dropped;  /* Number of frames too large for 'buf' */
+   U8 hdr[JFRAMER_HDR_SIZE];
+   U8 hdrLen;    /* Length mode: header bytes received */
+   U8 type;      /* JFramerT */
+   U8 skipping;  /* Newline mode: skipping to the next '\n' */
+} JFramer;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+   BA_API void JFramer_constructor(JFramer *o, JFramerT t, U8 *buf,
+                                   U32 size, void *userData,
+                                   JFramer_FrameCB frameCB);
+   BA_API int JFramer_feed(JFramer *o, const U8 *data, U32 len);
+   BA_API void JFramer_reset(JFramer *o);
+/** Number of frames dropped for being too large. */
+#define JFramer_getDropped(o) (o)->dropped
+/** Write the JFramerT_Length prefix for a 'len' byte message to 'hdr'. */
+#define JFramer_setHeader(hdr, len)             \
+   do                                           \
+   {                                            \
+      (hdr)[0] = (U8)((U32)(len) >> 24);        \
+      (hdr)[1] = (U8)((U32)(len) >> 16);        \
+      (hdr)[2] = (U8)((U32)(len) >> 8);         \
+      (hdr)[3] = (U8)(len);                     \
+   } while (0)
+#ifdef __cplusplus
+}
+inline JFramer::JFramer(JFramerT t, U8 *buf, U32 size, void *userData,
+                        JFramer_FrameCB frameCB)
+{
+   JFramer_constructor(this, t, buf, size, userData, frameCB);
+}
+inline int JFramer::feed(const U8 *data, U32 len)
+{
+   return JFramer_feed(this, data, len);
+}
+inline void JFramer::reset()
+{
+   JFramer_reset(this);
+}
+#endif
+
+/** @} */ /* end of JSONCB */
+
+#endif
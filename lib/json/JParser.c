@@ -62,6 +62,25 @@ static const U8 nullString[] = {"ull"};
 
 #define hexdigit(x) (((x) <= '9') ? (x) - '0' : ((x)&7) + 9)
 
+#ifndef NO_JLEXER_SWAR
+/* Word-at-a-time (SWAR) helpers. The lexer uses these for skipping
+   whitespace and for copying plain string bytes 4 bytes per
+   iteration. Define NO_JLEXER_SWAR to use the byte-by-byte lexer only.
+*/
+#define SWAR_REP(c) ((U32)(U8)(c)*0x01010101UL)
+
+/* Sets the high bit in each byte of 'w' equal to the byte in 'rep'. */
+#define SWAR_EQ(w, rep) \
+   (~(((((w) ^ (rep)) & 0x7F7F7F7FUL) + 0x7F7F7F7FUL) | ((w) ^ (rep))) & \
+    0x80808080UL)
+
+/* Sets the high bit in each byte of 'w' less than 0x20 (control char). */
+#define SWAR_CTRL(w) \
+   (~((((w)&0x7F7F7F7FUL) + 0x60606060UL) | (w)) & 0x80808080UL)
+
+#define SWAR_LOAD(w, ptr) memcpy(&(w), ptr, 4)
+#endif
+
 /****************************************************************************
                                 JErr
  JSON error message container
@@ -170,26 +189,56 @@ JDBuf_expand(JDBuf *o)
 static void
 JLexer_setString(JLexer *o, JParserVal *v)
 {
-   v->v.s = (char *)o->asmB->buf;
+   if (o->sliceStart)
+   {
+      v->v.s = (char *)o->sliceStart;
+      v->len = o->sliceLen;
+      o->sliceStart = 0;
+   }
+   else
+   {
+      v->v.s = (char *)o->asmB->buf;
+      v->len = o->asmB->index;
+   }
    v->t = JParserT_String;
 }
 
 static void
 JLexer_setNumber(JLexer *o, JParserVal *v)
 {
-   JDBuf *asmB = o->asmB;
-   baAssert(asmB->buf);
-   if (o->isDouble)
+   const char *num;
+   U32 len;
+   U64 l;
+   if (o->sliceStart)
+   {
+      /* Not zero terminated, but always followed by the non number
+         character that ended the token.
+       */
+      num = (const char *)o->sliceStart;
+      len = o->sliceLen;
+      o->sliceStart = 0;
+   }
+   else
+   {
+      baAssert(o->asmB->buf);
+      num = (const char *)o->asmB->buf;
+      len = o->asmB->index;
+   }
+   if (o->numPart != JLexerNum_Int)
    {
 #ifdef NO_DOUBLE
-      U8 *ptr = asmB->buf;
-      while (ptr && *ptr != '.' && *ptr != 'e' && *ptr == 'E')
-         ptr++;
-      *ptr = 0;
-      asmB->index = ptr - asmB->buf;
+      len = o->intDigits;
       goto L_int;
 #else
-      v->v.f = atof((char *)asmB->buf);
+      int exp10 = o->expNeg ? -(int)o->expVal : (int)o->expVal;
+      /* atof handles the rare numbers the fast path cannot round.
+         'num' is followed by a non number character.
+       */
+      if (o->intDigits == 0xFFFF || o->fracDigits == 0xFFFF ||
+          Double_atof3(num, o->intDigits, o->fracDigits, exp10, &v->v.f))
+      {
+         v->v.f = atof(num);
+      }
       v->t = JParserT_Double;
       if (o->sn)
          v->v.f = -v->v.f;
@@ -200,25 +249,31 @@ JLexer_setNumber(JLexer *o, JParserVal *v)
 #ifdef NO_DOUBLE
    L_int:
 #endif
-      v->t = JParserT_Int;
-      if (asmB->index > 9)
+      if (U64_atoll3(num, num + len, &l) ||
+          (o->sn && l > 0x8000000000000000ULL))
       {
-         S64 l = S64_atoll((char *)asmB->buf);
-         S32 lsw = (S32)l;
-         if ((0xFFFFFFFF00000000LL & l) || (lsw < 0))
-         {
-            v->v.l = o->sn ? -l : l;
-            v->t = JParserT_Long;
-         }
-         else
-            v->v.d = (S32)l;
+         /* Does not fit in 64 bits */
+#ifdef NO_DOUBLE
+         l = U64_atoll2(num, num + len);
+#else
+         v->v.f = atof(num);
+         v->t = JParserT_Double;
+         if (o->sn)
+            v->v.f = -v->v.f;
+         return;
+#endif
+      }
+      if (l <= 0x7FFFFFFF)
+      {
+         v->v.d = o->sn ? -(S32)l : (S32)l;
+         v->t = JParserT_Int;
       }
       else
-         v->v.d = (S32)U32_atoi((char *)asmB->buf);
-      if (v->t == JParserT_Int && o->sn)
-         v->v.d = -v->v.d;
+      {
+         v->v.l = o->sn ? 0 - l : l;
+         v->t = JParserT_Long;
+      }
    }
-   o->isDouble = 0;
 }
 
 static int
@@ -237,6 +292,7 @@ JLexer_setValue(JLexer *o, JLexerT t, JParserVal *v)
       JLexer_setNumber(o, v);
       break;
    case JLexerT_String:
+   case JLexerT_StringChunk:
       JLexer_setString(o, v);
       break;
    default:
@@ -253,6 +309,15 @@ JLexer_setValue(JLexer *o, JLexerT t, JParserVal *v)
       (o)->state = JLexerSt_GetNextToken; \
    } while (0)
 
+#define JLexer_beginNumber(o)                \
+   do                                         \
+   {                                          \
+      (o)->intDigits = (o)->fracDigits = 0;   \
+      (o)->expVal = 0;                        \
+      (o)->expNeg = FALSE;                    \
+      (o)->numPart = JLexerNum_Int;           \
+   } while (0)
+
 #define JLexer_setBuf(o, buf, size)        \
    do                                      \
    {                                       \
@@ -260,6 +325,45 @@ JLexer_setValue(JLexer *o, JLexerT t, JParserVal *v)
       (o)->bufEnd = (o)->bufStart + size;  \
    } while (0)
 
+/* Copy the zero copy slice parsed so far to the assembly buffer and
+   continue in copy mode. Used when a token crosses the end of the
+   parse buffer or when a string contains an escape sequence.
+*/
+static int
+JLexer_copySlice(JLexer *o)
+{
+   JDBuf *asmB = o->asmB;
+   U32 len = (U32)(o->tokenPtr - o->sliceStart);
+   while ((asmB->index + len + 2) > asmB->size)
+   {
+      if (JDBuf_expand(asmB))
+         return -1;
+   }
+   memcpy(asmB->buf + asmB->index, o->sliceStart, len);
+   asmB->index += len;
+   o->sliceStart = 0;
+   return 0;
+}
+
+/* In string chunk mode, the string assembled so far is returned as
+   JLexerT_StringChunk instead of expanding the assembly buffer. Room
+   is kept for the largest escape sequence (3 UTF-8 bytes) and the
+   zero terminator.
+*/
+#define JLexer_chunkFull(o) \
+   ((o)->strChunks && (o)->asmB->index && \
+    ((o)->asmB->index + 5) > (o)->asmB->size)
+
+static JLexerT
+JLexer_chunk(JLexer *o)
+{
+   if (o->sliceStart)
+      o->sliceLen = (U32)(o->tokenPtr - o->sliceStart);
+   else
+      o->asmB->buf[o->asmB->index] = 0;
+   return JLexerT_StringChunk;
+}
+
 static BaBool
 JLexer_hasMoreData(JLexer *o)
 {
@@ -273,6 +377,140 @@ JLexer_hasMoreData(JLexer *o)
    return FALSE;
 }
 
+#ifndef NO_JLEXER_SWAR
+/* Skip whitespace 4 bytes at a time. Stops at the first word
+   containing a non whitespace character or when less than 4 bytes
+   are left; the byte lexer takes care of the rest.
+*/
+static void
+JLexer_swarSkipSpace(JLexer *o)
+{
+   while (o->bufEnd - o->tokenPtr >= 4)
+   {
+      U32 w;
+      SWAR_LOAD(w, o->tokenPtr);
+      if ((SWAR_EQ(w, SWAR_REP(' ')) | SWAR_EQ(w, SWAR_REP('\n')) |
+           SWAR_EQ(w, SWAR_REP('\r')) | SWAR_EQ(w, SWAR_REP('\t'))) !=
+          0x80808080UL)
+      {
+         break;
+      }
+      o->tokenPtr += 4;
+   }
+}
+
+/* Copy plain string bytes 4 bytes at a time. Stops at a word
+   containing the end quote, a backslash or a control character, when
+   the assembly buffer is full, or when less than 5 bytes are left. At
+   least one byte is always left in the input buffer such that the
+   byte lexer can continue without checking for end of buffer.
+*/
+static void
+JLexer_swarString(JLexer *o)
+{
+   JDBuf *asmB = o->asmB;
+   const U32 quote = SWAR_REP(o->sn);
+   while (o->bufEnd - o->tokenPtr > 4 && (asmB->index + 5) <= asmB->size)
+   {
+      U32 w;
+      SWAR_LOAD(w, o->tokenPtr);
+      if (SWAR_EQ(w, quote) | SWAR_EQ(w, SWAR_REP('\\')) | SWAR_CTRL(w))
+         break;
+      memcpy(asmB->buf + asmB->index, &w, 4);
+      asmB->index += 4;
+      o->tokenPtr += 4;
+   }
+}
+
+/* Same as JLexer_swarString, but for zero copy strings and for
+   strings in skipped objects and arrays.
+*/
+static void
+JLexer_swarSkipString(JLexer *o)
+{
+   const U32 quote = SWAR_REP(o->sn);
+   while (o->bufEnd - o->tokenPtr > 4)
+   {
+      U32 w;
+      SWAR_LOAD(w, o->tokenPtr);
+      if (SWAR_EQ(w, quote) | SWAR_EQ(w, SWAR_REP('\\')) | SWAR_CTRL(w))
+         break;
+      o->tokenPtr += 4;
+   }
+}
+
+/* Skip bytes in a skipped object or array 4 bytes at a time. Stops
+   at a word containing a quote or a bracket.
+*/
+static void
+JLexer_swarSkipValue(JLexer *o)
+{
+   while (o->bufEnd - o->tokenPtr > 4)
+   {
+      U32 w;
+      SWAR_LOAD(w, o->tokenPtr);
+      if (SWAR_EQ(w, SWAR_REP('"')) | SWAR_EQ(w, SWAR_REP('\'')) |
+          SWAR_EQ(w, SWAR_REP('{')) | SWAR_EQ(w, SWAR_REP('}')) |
+          SWAR_EQ(w, SWAR_REP('[')) | SWAR_EQ(w, SWAR_REP(']')))
+      {
+         break;
+      }
+      o->tokenPtr += 4;
+   }
+}
+#endif
+
+/* Fast-forward to the bracket closing the object or array being
+   skipped. Only quotes and brackets are tracked; strings and numbers
+   are neither assembled nor validated.
+*/
+static JLexerT
+JLexer_skip(JLexer *o)
+{
+   if (o->skipEsc)
+   {
+      o->skipEsc = FALSE;
+      o->tokenPtr++;
+   }
+   while (o->tokenPtr != o->bufEnd)
+   {
+      U8 c;
+      if (o->sn) /* In string */
+      {
+#ifndef NO_JLEXER_SWAR
+         JLexer_swarSkipString(o);
+#endif
+         c = *o->tokenPtr++;
+         if (c == '\\')
+         {
+            if (o->tokenPtr == o->bufEnd)
+            {
+               o->skipEsc = TRUE;
+               break;
+            }
+            o->tokenPtr++;
+         }
+         else if (c == o->sn)
+            o->sn = 0;
+         continue;
+      }
+#ifndef NO_JLEXER_SWAR
+      JLexer_swarSkipValue(o);
+#endif
+      c = *o->tokenPtr++;
+      if (c == '"' || c == '\'')
+         o->sn = c;
+      else if (c == '{' || c == '[')
+         o->skipDepth++;
+      else if ((c == '}' || c == ']') && --o->skipDepth == 0)
+      {
+         o->state = JLexerSt_GetNextToken;
+         return c == '}' ? JLexerT_EndObject : JLexerT_EndArray;
+      }
+   }
+   return JLexerT_NeedMoreData;
+}
+
 static JLexerT
 JLexer_nextToken(JLexer *o)
 {
@@ -281,7 +519,15 @@ JLexer_nextToken(JLexer *o)
    {
       baAssert(o->tokenPtr <= o->bufEnd);
       if (o->tokenPtr == o->bufEnd)
+      {
+         /* A token started at the end of the buffer, such as a lone
+            '"' or '-', must not keep pointing into the buffer, which
+            the caller may reuse for the next chunk.
+         */
+         if (o->sliceStart && JLexer_copySlice(o))
+            return JLexerT_MemErr;
          return JLexerT_NeedMoreData;
+      }
 
       switch (o->state)
       {
@@ -331,10 +577,51 @@ JLexer_nextToken(JLexer *o)
          break;
 
       case JLexerSt_String:
+         if (o->sliceStart)
+         {
+            for (;;)
+            {
+#ifndef NO_JLEXER_SWAR
+               JLexer_swarSkipString(o);
+#endif
+               if (*o->tokenPtr == '\\')
+               {
+                  if (o->strChunks && o->tokenPtr != o->sliceStart)
+                     return JLexer_chunk(o);
+                  /* Continue in copy mode below */
+                  if (JLexer_copySlice(o))
+                     return JLexerT_MemErr;
+                  break;
+               }
+               if (*o->tokenPtr == o->sn)
+               {
+                  o->sliceLen = (U32)(o->tokenPtr - o->sliceStart);
+                  o->tokenPtr++;
+                  o->state = JLexerSt_GetNextToken;
+                  return JLexerT_String;
+               }
+               if (++o->tokenPtr == o->bufEnd)
+               {
+                  /* The rest of the string is assembled in copy mode */
+                  if (o->strChunks)
+                     return JLexer_chunk(o);
+                  if (JLexer_copySlice(o))
+                     return JLexerT_MemErr;
+                  return JLexerT_NeedMoreData;
+               }
+            }
+         }
          if (JDBuf_expandIfNeeded(o->asmB, 2))
             return JLexerT_MemErr;
-         while (*o->tokenPtr != '\\')
+         for (;;)
          {
+#ifndef NO_JLEXER_SWAR
+            JLexer_swarString(o);
+#endif
+            if (JLexer_chunkFull(o))
+               return JLexer_chunk(o);
+            if (*o->tokenPtr == '\\')
+               break;
             if (*o->tokenPtr == o->sn) /* equal end of string: ' or "  */
             {
                asmB->buf[asmB->index] = 0;
@@ -455,20 +742,76 @@ JLexer_nextToken(JLexer *o)
       }
 
       case JLexerSt_Number:
-         while (strchr(jsonNumberChars, *o->tokenPtr))
+         for (;;)
          {
-            if (JDBuf_expandIfNeeded(o->asmB, 2))
-               return JLexerT_MemErr;
-            if (*o->tokenPtr == '.' || *o->tokenPtr == 'e' || *o->tokenPtr == 'E')
-               o->isDouble = TRUE;
-            asmB->buf[asmB->index++] = *o->tokenPtr++;
+            U8 c = *o->tokenPtr;
+            if (c >= '0' && c <= '9')
+            {
+               switch (o->numPart)
+               {
+               case JLexerNum_Int:
+                  if (o->intDigits != 0xFFFF)
+                     o->intDigits++;
+                  break;
+               case JLexerNum_Frac:
+                  if (o->fracDigits != 0xFFFF)
+                     o->fracDigits++;
+                  break;
+               default:
+                  o->numPart = JLexerNum_ExpDigits;
+                  if (o->expVal < 1000)
+                     o->expVal = (U16)(o->expVal * 10 + (c - '0'));
+                  else
+                     o->expVal = 9999;
+               }
+            }
+            else if (c == '.' && o->numPart == JLexerNum_Int && o->intDigits)
+               o->numPart = JLexerNum_Frac;
+            else if ((c == 'e' || c == 'E') && o->numPart <= JLexerNum_Frac &&
+                     o->intDigits && (o->numPart == JLexerNum_Int || o->fracDigits))
+            {
+               o->numPart = JLexerNum_Exp;
+            }
+            else if ((c == '-' || c == '+') && o->numPart == JLexerNum_Exp)
+            {
+               o->numPart = JLexerNum_ExpSign;
+               o->expNeg = c == '-';
+            }
+            else if (strchr(jsonNumberChars, c))
+               return JLexerT_ParseErr; /* Misplaced number character */
+            else
+               break;
+            if (o->sliceStart)
+               o->tokenPtr++;
+            else
+            {
+               if (JDBuf_expandIfNeeded(o->asmB, 2))
+                  return JLexerT_MemErr;
+               asmB->buf[asmB->index++] = *o->tokenPtr++;
+            }
             if (o->tokenPtr == o->bufEnd)
+            {
+               if (o->sliceStart && JLexer_copySlice(o))
+                  return JLexerT_MemErr;
                return JLexerT_NeedMoreData;
+            }
+         }
+         if (!o->intDigits ||
+             (o->numPart == JLexerNum_Frac && !o->fracDigits) ||
+             o->numPart == JLexerNum_Exp || o->numPart == JLexerNum_ExpSign)
+         {
+            return JLexerT_ParseErr; /* Incomplete number */
          }
-         asmB->buf[asmB->index] = 0;
+         if (o->sliceStart)
+            o->sliceLen = (U32)(o->tokenPtr - o->sliceStart);
+         else
+            asmB->buf[asmB->index] = 0;
          o->state = JLexerSt_GetNextToken;
          return JLexerT_Number;
 
+      case JLexerSt_Skip:
+         return JLexer_skip(o);
+
       case JLexerSt_GetNextToken:
          switch (*o->tokenPtr)
          {
@@ -526,10 +869,12 @@ JLexer_nextToken(JLexer *o)
          case '"':
          case '\'':
             baAssert(asmB->index == 0);
-            if (JDBuf_expandIfNeeded(o->asmB, 2))
-               return JLexerT_MemErr;
             o->sn = *o->tokenPtr++;
             o->state = JLexerSt_String;
+            if (o->zeroCopy)
+               o->sliceStart = o->tokenPtr;
+            else if (JDBuf_expandIfNeeded(o->asmB, 2))
+               return JLexerT_MemErr;
             break;
 
          case ' ':
@@ -537,14 +882,20 @@ JLexer_nextToken(JLexer *o)
          case '\n':
          case '\r':
             o->tokenPtr++;
+#ifndef NO_JLEXER_SWAR
+            JLexer_swarSkipSpace(o);
+#endif
             break;
 
          case '-': /* negative number */
             o->tokenPtr++;
             o->sn = 255;
             o->state = JLexerSt_Number;
+            JLexer_beginNumber(o);
             baAssert(asmB->index == 0);
-            if (JDBuf_expandIfNeeded(o->asmB, 256))
+            if (o->zeroCopy)
+               o->sliceStart = o->tokenPtr;
+            else if (JDBuf_expandIfNeeded(o->asmB, 256))
                return JLexerT_MemErr;
             break;
 
@@ -559,7 +910,10 @@ JLexer_nextToken(JLexer *o)
             {
                o->sn = 0;
                o->state = JLexerSt_Number;
-               if (JDBuf_expandIfNeeded(o->asmB, 256))
+               JLexer_beginNumber(o);
+               if (o->zeroCopy)
+                  o->sliceStart = o->tokenPtr;
+               else if (JDBuf_expandIfNeeded(o->asmB, 256))
                   return JLexerT_MemErr;
                break;
             }
@@ -587,12 +941,20 @@ JParser_setStatus(JParser *o, JParsStat s, int retVal)
    return retVal;
 }
 
+/* Returns a negative value on error and JPARSER_SKIP if the callback
+   wants to skip the object or array just started. Any other non zero
+   value from the callback is an error.
+*/
 static int
 JParser_service(JParser *o)
 {
    int retVal = JParserIntf_serviceCB(o->intf, &o->val, o->stackIx);
-   if (retVal)
-      JParser_setStatus(o, JParsStat_IntfErr, -1);
+   if (retVal && (retVal != JPARSER_SKIP ||
+                  (o->val.t != JParserT_BeginObject &&
+                   o->val.t != JParserT_BeginArray)))
+   {
+      retVal = JParser_setStatus(o, JParsStat_IntfErr, -1);
+   }
    o->val.memberName[0] = 0;
    return retVal;
 }
@@ -620,9 +982,23 @@ void JParser_destructor(JParser *o)
    JDBuf_destructor(&o->asmB);
 }
 
+void JParser_reset(JParser *o)
+{
+   JDBuf_reset(&o->asmB);
+   JDBuf_reset(&o->mnameB);
+   o->val.memberName[0] = 0;
+   JLexer_constructor(&o->lexer, &o->asmB);
+   o->lexer.zeroCopy = o->zeroCopy;
+   o->lexer.strChunks = o->strChunks;
+   o->status = JParsStat_DoneEOS;
+   o->state = JParserSt_StartObj;
+   o->stackIx = 0;
+}
+
 int JParser_parse(JParser *o, const U8 *buf, U32 size)
 {
    JLexerT lexerT;
+   int retVal;
    if (o->status == JParsStat_DoneEOS || o->status == JParsStat_NeedMoreData)
       JLexer_setBuf(&o->lexer, buf, size);
    else if (o->status != JParsStat_Done)
@@ -642,6 +1018,22 @@ int JParser_parse(JParser *o, const U8 *buf, U32 size)
          return JParser_setStatus(o, JParsStat_ParseErr, -1);
       if (lexerT == JLexerT_MemErr)
          return JParser_setStatus(o, JParsStat_MemErr, -1);
+      if (lexerT == JLexerT_StringChunk)
+      {
+         /* Part of a string value, see JParser_setStringChunks. Not
+            JParser_service, as the member name is kept for the
+            remaining parts.
+         */
+         baAssert(o->state == JParserSt_Value ||
+                  o->state == JParserSt_BeginArray);
+         JLexer_setValue(&o->lexer, lexerT, &o->val);
+         o->val.more = TRUE;
+         retVal = JParserIntf_serviceCB(o->intf, &o->val, o->stackIx);
+         o->val.more = FALSE;
+         if (retVal)
+            return JParser_setStatus(o, JParsStat_IntfErr, -1);
+         continue;
+      }
 
       switch (o->state)
       {
@@ -654,6 +1046,8 @@ int JParser_parse(JParser *o, const U8 *buf, U32 size)
          {
             o->val.t = JParserT_BeginObject;
             o->lexer.asmB = &o->mnameB;
+            o->lexer.zeroCopy = FALSE;
+            o->lexer.strChunks = FALSE;
             o->state = JParserSt_MemberName;
          }
          else if (lexerT == JLexerT_BeginArray)
@@ -663,9 +1057,24 @@ int JParser_parse(JParser *o, const U8 *buf, U32 size)
          }
          else
             return JParser_setStatus(o, JParsStat_ParseErr, -1);
-         if (JParser_service(o))
+         retVal = JParser_service(o);
+         if (retVal < 0)
             return -1;
          o->stackIx++;
+         if (retVal == JPARSER_SKIP)
+         {
+            /* The lexer returns the closing bracket, which is
+               handled as if the object or array was empty.
+            */
+            o->lexer.asmB = &o->asmB;
+            o->lexer.zeroCopy = o->zeroCopy;
+            o->lexer.strChunks = o->strChunks;
+            o->lexer.state = JLexerSt_Skip;
+            o->lexer.skipDepth = 1;
+            o->lexer.skipEsc = FALSE;
+            o->lexer.sn = 0;
+            o->state = JParserSt_Comma;
+         }
          break;
 
       case JParserSt_BeginArray:
@@ -677,6 +1086,8 @@ int JParser_parse(JParser *o, const U8 *buf, U32 size)
       case JParserSt_MemberName:
          JDBuf_reset(&o->mnameB);
          o->lexer.asmB = &o->asmB;
+         o->lexer.zeroCopy = o->zeroCopy;
+         o->lexer.strChunks = o->strChunks;
          if (lexerT == JLexerT_EndObject)
             goto L_endObj;
          if (lexerT != JLexerT_String)
@@ -699,7 +1110,7 @@ int JParser_parse(JParser *o, const U8 *buf, U32 size)
          }
          if (JLexer_setValue(&o->lexer, lexerT, &o->val))
             return JParser_setStatus(o, JParsStat_ParseErr, -1);
-         if (JParser_service(o))
+         if (JParser_service(o) < 0)
             return -1;
          o->state = JParserSt_Comma;
          break;
@@ -710,6 +1121,8 @@ int JParser_parse(JParser *o, const U8 *buf, U32 size)
             if (lexerT == JLexerT_Comma)
             {
                o->lexer.asmB = &o->mnameB;
+               o->lexer.zeroCopy = FALSE;
+               o->lexer.strChunks = FALSE;
                o->state = JParserSt_MemberName;
             }
             else if (lexerT == JLexerT_EndObject)
@@ -719,7 +1132,7 @@ int JParser_parse(JParser *o, const U8 *buf, U32 size)
                   return JParser_setStatus(o, JParsStat_ParseErr, -1);
                o->val.t = JParserT_EndObject;
                o->stackIx--;
-               if (JParser_service(o))
+               if (JParser_service(o) < 0)
                   return -1;
                if (o->stackIx == 0)
                {
@@ -744,7 +1157,7 @@ int JParser_parse(JParser *o, const U8 *buf, U32 size)
                   return JParser_setStatus(o, JParsStat_ParseErr, -1);
                o->val.t = JParserT_EndArray;
                o->stackIx--;
-               if (JParser_service(o))
+               if (JParser_service(o) < 0)
                   return -1;
                if (o->stackIx == 0)
                   goto L_endParse;
@@ -52,10 +52,20 @@ struct JParserVal;
     \param o, the interface object
     \param v, the parsed value
     \param recLevel goes from 0 to N and represents object nesting level
+    \returns 0 on success and a negative value on error. Returning
+    JPARSER_SKIP for JParserT_BeginObject or JParserT_BeginArray makes
+    the lexer fast-forward to the end of the object or array; the
+    callback then receives the matching JParserT_EndObject or
+    JParserT_EndArray without the values in between. Any other non
+    zero value stops the parser with JParsStat_IntfErr.
  */
 typedef int (*JParserIntf_Service)(
     struct JParserIntf *o, struct JParserVal *v, int recLevel);
 
+/** Returned by a JParserIntf_Service to skip an object or array.
+ */
+#define JPARSER_SKIP 1
+
 /** The JParserIntf interface class is the interface between the parser and
     an object that implements the JParserIntf interface.
  */
@@ -264,6 +274,7 @@ typedef enum
    JLexerT_EndArray,
    JLexerT_Comma,        /* ',' Array or object list comma. */
    JLexerT_MemberSep,    /* ':'  for string : value */
+   JLexerT_StringChunk,  /* Part of a string, see JLexer.strChunks */
    JLexerT_NeedMoreData, /* Lexer not completed with current token. */
    JLexerT_ParseErr,
    JLexerT_MemErr
@@ -280,9 +291,20 @@ typedef enum
    JLexerSt_StringEscape,
    JLexerSt_StringUnicode,
    JLexerSt_Number,
+   JLexerSt_Skip, /* Skipping an object or array */
    JLexerSt_GetNextToken
 } JLexerSt;
 
+/* The part of a number the lexer is in */
+typedef enum
+{
+   JLexerNum_Int,
+   JLexerNum_Frac,
+   JLexerNum_Exp,     /* After 'e' or 'E' */
+   JLexerNum_ExpSign, /* After the exponent sign */
+   JLexerNum_ExpDigits
+} JLexerNum;
+
 typedef struct
 {
    JDBuf *asmB;
@@ -299,6 +321,13 @@ typedef struct
    const U8 *typeChkPtr;
    U8 retVal;
 
+   /* sliceStart is set when the current string or number is returned
+      as a slice into the input buffer, i.e. when zero copy is enabled
+      and the token has not (yet) crossed a buffer boundary.
+   */
+   const U8 *sliceStart;
+   U32 sliceLen;
+
    U8 state; /* JLexerSt */
 
    /* state for string or number.
@@ -307,7 +336,17 @@ typedef struct
       If in state Boolean: true or false.
    */
    U8 sn;
-   U8 isDouble; /* Used when reading a number */
+   /* Number layout recorded while lexing, used by JLexer_setNumber.
+    */
+   U16 intDigits;  /* Digits before '.' */
+   U16 fracDigits; /* Digits after '.' */
+   U16 expVal;     /* Exponent magnitude, saturates at 9999 */
+   U8 expNeg;      /* Exponent is negative */
+   U8 numPart;     /* JLexerNum */
+   U8 zeroCopy; /* Set by JParser when lexing values (not member names) */
+   U8 strChunks; /* As zeroCopy, for JParser_setStringChunks */
+   U8 skipEsc;    /* Skip state: backslash at end of previous buffer */
+   U16 skipDepth; /* Skip state: open brackets */
 } JLexer;
 
 #endif /* __DOXYGEN__ */
@@ -347,6 +386,14 @@ typedef struct JParserVal
       BaBool b;
    } v;
 
+   /** The string length, excluding the zero terminator, if 't' is
+       JParserT_String. Strings returned in zero copy mode point
+       directly into the buffer passed to JParser_parse and are not zero
+       terminated.
+       \sa JParser_setZeroCopy
+   */
+   U32 len;
+
    /** object member name is set for objects. Use the following
        construction to differentiate between an object/array:
        \code
@@ -363,6 +410,13 @@ typedef struct JParserVal
    */
    char *memberName;
    JParserT t; /**< The type controlling 'v' */
+
+   /** Set if 't' is JParserT_String and more parts of the string
+       follow in the next callbacks. The last part, which may be
+       empty, has 'more' cleared.
+       \sa JParser_setStringChunks
+   */
+   BaBool more;
 } JParserVal;
 
 /** JSON Parser Status.
@@ -459,6 +513,44 @@ struct JParser
        \sa parse
    */
    JParsStat getStatus();
+
+   /** Enable or disable zero copy mode. In zero copy mode, strings and
+       numbers that start and end in the buffer passed to method parse
+       are not copied to the internal assembly buffer. String values
+       are instead handed to the callback as a pointer into the parse
+       buffer and JParserVal::len holds the length. The string is not
+       zero terminated and must not be modified. Only tokens spanning
+       two parse buffers and strings with escape sequences are copied.
+       Member names are always copied.
+
+       Must be called before parsing or between two JSON messages.
+   */
+   void setZeroCopy(bool enable);
+
+   /** Enable or disable delivering long string values in parts. A
+       string value that does not fit in the assembly buffer, which
+       is 256 bytes when first allocated, is passed to the callback
+       in several calls with JParserVal::more set for all but the
+       last part. In zero copy mode, the part of a string
+       in the buffer passed to method parse is also delivered as soon
+       as the string crosses the end of the buffer or reaches an
+       escape sequence. The memory used for a string is then bounded
+       regardless of the string length, which makes it possible to
+       stream large values such as Base64 data to a B64Decoder.
+
+       The callback must handle JParserVal::more; JDecoder and
+       JParserValFact do not. Member names are never split.
+
+       Must be called before parsing or between two JSON messages.
+   */
+   void setStringChunks(bool enable);
+
+   /** Discard a partially parsed message and any error status, so the
+       next call to method parse starts a new message. Used for
+       skipping a malformed message when the message boundaries are
+       known, see JFramer.
+   */
+   void reset();
 #endif
    JLexer lexer;
    JParserVal val;
@@ -469,6 +561,8 @@ struct JParser
    S16 stackSize;
    U8 status; /* JParsStat */
    U8 state;  /* JParserSt */
+   U8 zeroCopy;
+   U8 strChunks;
    /* It's possible to extend the stack size by reserving
     * N*JParserStackNode bytes immediately following the memory for
     * this struct instance. N is then used as 'extraStackLen' in constructor.
@@ -487,7 +581,12 @@ extern "C"
                                    int extraStackLen);
    BA_API int JParser_parse(JParser *o, const U8 *buf, U32 size);
    BA_API void JParser_destructor(JParser *o);
+   BA_API void JParser_reset(JParser *o);
 #define JParser_getStatus(o) ((JParsStat)(o)->status)
+#define JParser_setZeroCopy(o, enable) \
+   ((o)->zeroCopy = (o)->lexer.zeroCopy = (U8)((enable) ? TRUE : FALSE))
+#define JParser_setStringChunks(o, enable) \
+   ((o)->strChunks = (o)->lexer.strChunks = (U8)((enable) ? TRUE : FALSE))
 #ifdef __cplusplus
 }
 inline JParser::JParser(JParserIntf *intf, char *nameBuf,
@@ -508,6 +607,18 @@ inline JParsStat JParser::getStatus()
 {
    return JParser_getStatus(this);
 }
+inline void JParser::setZeroCopy(bool enable)
+{
+   JParser_setZeroCopy(this, enable);
+}
+inline void JParser::setStringChunks(bool enable)
+{
+   JParser_setStringChunks(this, enable);
+}
+inline void JParser::reset()
+{
+   JParser_reset(this);
+}
 #endif
 
 /** @} */ /* end of JSONRef */
@@ -0,0 +1,137 @@
+/*
+ * JSON path filter for JParser, see JPathFilter.h.
+ */
+
+#ifndef BA_LIB
+#define BA_LIB 1
+#endif
+
+#include "JPathFilter.h"
+#include <string.h>
+
+/* Compare path 'sel' with the path made of the open segments followed
+   by 'key'. Returns 2 if 'sel' selects the value, 1 if 'sel' selects a
+   value below it, and 0 if neither.
+*/
+static int
+JPathFilter_match(JPathFilter *o, const char *sel, const char *key)
+{
+   int i;
+   for (i = 1; i <= o->level; i++)
+   {
+      const char *k = i < o->level ? o->seg[i].key : key;
+      if (!*sel)
+         return 2; /* 'sel' selects a container above this value */
+      if (*sel++ != '/')
+         return 0;
+      if (sel[0] == '*' && (!sel[1] || sel[1] == '/'))
+         sel++;
+      else
+      {
+         while (*sel && *sel != '/' && *sel == *k)
+            sel++, k++;
+         if ((*sel && *sel != '/') || *k)
+            return 0;
+      }
+   }
+   return *sel ? 1 : 2;
+}
+
+static void
+JPathFilter_setIndex(char *key, U16 index)
+{
+   char tmp[6];
+   int len = 0;
+   do
+   {
+      tmp[len++] = (char)('0' + index % 10);
+      index /= 10;
+   } while (index);
+   while (len)
+      *key++ = tmp[--len];
+   *key = 0;
+}
+
+static int
+JPathFilter_service(JParserIntf *super, JParserVal *v, int recLevel)
+{
+   JPathFilter *o = (JPathFilter *)super;
+   BaBool begin = v->t == JParserT_BeginObject || v->t == JParserT_BeginArray;
+   char index[6];
+   const char *key;
+   int i, match = 0;
+
+   if (o->selDepth)
+   {
+      if (begin)
+         o->selDepth++;
+      else if (v->t == JParserT_EndObject || v->t == JParserT_EndArray)
+         o->selDepth--;
+      return JParserIntf_serviceCB(o->next, v, recLevel);
+   }
+   if (v->t == JParserT_EndObject || v->t == JParserT_EndArray)
+   {
+      if (o->skipping)
+      {
+         o->skipping = FALSE;
+         return 0;
+      }
+      o->level--;
+      return JParserIntf_serviceCB(o->next, v, recLevel);
+   }
+   if (recLevel == 0)
+   {
+      /* Root object or array, start of a new document */
+      o->level = 0;
+      o->skipping = FALSE;
+      key = "";
+      match = 1;
+   }
+   else
+   {
+      if (o->seg[o->level - 1].isArray)
+      {
+         JPathFilter_setIndex(index, o->seg[o->level - 1].index++);
+         key = index;
+      }
+      else
+         key = v->memberName;
+      for (i = 0; i < o->pathLen && match != 2; i++)
+      {
+         int m = JPathFilter_match(o, o->paths[i], key);
+         if (m > match)
+            match = m;
+      }
+   }
+   if (match == 2)
+   {
+      if (begin)
+         o->selDepth = 1;
+      return JParserIntf_serviceCB(o->next, v, recLevel);
+   }
+   if (match == 1 && begin && o->level < JPATHFILTER_MAX_DEPTH &&
+       strlen(key) < JPATHFILTER_MAX_NAME)
+   {
+      strcpy(o->seg[o->level].key, key);
+      o->seg[o->level].index = 0;
+      o->seg[o->level].isArray = v->t == JParserT_BeginArray;
+      o->level++;
+      return JParserIntf_serviceCB(o->next, v, recLevel);
+   }
+   if (begin)
+   {
+      o->skipping = TRUE;
+      return JPARSER_SKIP;
+   }
+   return 0; /* Not selected */
+}
+
+void JPathFilter_constructor(JPathFilter *o, JParserIntf *next,
+                             const char *const *paths, int pathLen)
+{
+   memset(o, 0, sizeof(JPathFilter));
+   JParserIntf_constructor((JParserIntf *)o, JPathFilter_service);
+   o->next = next;
+   o->paths = paths;
+   o->pathLen = pathLen;
+}
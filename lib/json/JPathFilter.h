@@ -0,0 +1,94 @@
+/*
+ * JSON path filter for JParser.
+ */
+
+#ifndef __JPathFilter_h
+#define __JPathFilter_h
+
+#include "JParser.h"
+
+/** @addtogroup JSONCB
+@{
+*/
+
+/** Maximum number of path segments tracked by JPathFilter. */
+#ifndef JPATHFILTER_MAX_DEPTH
+#define JPATHFILTER_MAX_DEPTH 8
+#endif
+
+/** Maximum member name length, including the zero terminator, of an
+    object or array leading to a selected value. Containers with longer
+    names are skipped unless the path selects them.
+*/
+#ifndef JPATHFILTER_MAX_NAME
+#define JPATHFILTER_MAX_NAME 32
+#endif
+
+/** JPathFilter is a JParserIntf placed between the JParser and
+    another JParserIntf, such as a JDecoder, a generated decoder, or a
+    JParserCValFact. It forwards only the values selected by a set of
+    JSON paths, for example:
+
+    \code
+    static const char* const paths[] = {
+       "/cmd/led", "/cfg/display/contrast", "/tasks/0/name"
+    };
+    \endcode
+
+    A path selects a value and everything below it. Segments are
+    object member names or array indexes, and a '*' segment matches
+    any member or element. The objects and arrays leading to a selected value
+    are forwarded so the next interface receives a well formed, pruned
+    document. Every other object and array is skipped by the lexer
+    using JPARSER_SKIP; its strings and numbers are never assembled.
+
+    The paths are not copied and must be valid for the lifetime of
+    the filter.
+*/
+#ifdef __cplusplus
+typedef struct JPathFilter : public JParserIntf
+{
+   /** Create a filter forwarding the values selected by 'paths' to
+       'next'.
+   */
+   JPathFilter(JParserIntf *next, const char *const *paths, int pathLen);
+#else
+typedef struct JPathFilter
+{
+   JParserIntf super; /*Inherits from JParserIntf*/
+#endif
+   JParserIntf *next;
+   const char *const *paths;
+   int pathLen;
+   /* Open objects and arrays on the way to a selected value. seg[0]
+      is the root.
+   */
+   struct
+   {
+      char key[JPATHFILTER_MAX_NAME]; /* Member name or array index */
+      U16 index;                      /* Next element index if array */
+      U8 isArray;
+   } seg[JPATHFILTER_MAX_DEPTH];
+   int level;       /* Number of entries in 'seg' */
+   int selDepth;    /* Nesting level in a selected object or array */
+   BaBool skipping; /* Next value is the end of a skipped container */
+} JPathFilter;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+   BA_API void JPathFilter_constructor(JPathFilter *o, JParserIntf *next,
+                                       const char *const *paths, int pathLen);
+#ifdef __cplusplus
+}
+inline JPathFilter::JPathFilter(
+    JParserIntf *next, const char *const *paths, int pathLen)
+{
+   JPathFilter_constructor(this, next, paths, pathLen);
+}
+#endif
+
+/** @} */ /* end of JSONCB */
+
+#endif
@@ -0,0 +1,247 @@
+/*
+ * Pre-serialized message templates, see JTemplate.h.
+ */
+
+#ifndef BA_LIB
+#define BA_LIB 1
+#endif
+
+#include "JTemplate.h"
+#include <string.h>
+
+/* The template buffer cannot grow */
+static int
+JTemplate_flush(BufPrint *o, int sizeRequired)
+{
+   (void)o;
+   return sizeRequired ? -1 : 0;
+}
+
+#ifdef NO_CBOR
+#define JTemplate_isCBOR(o) FALSE
+#else
+#define JTemplate_isCBOR(o) (o)->encoder.cbor
+#endif
+
+/* Returns the slot if it exists and has type 't' */
+static JTemplateSlot *
+JTemplate_getSlot(JTemplate *o, int slot, JParserT t)
+{
+   if (slot < 0 || slot >= o->slotLen || o->slots[slot].type != (U8)t)
+      return 0;
+   return o->slots + slot;
+}
+
+#define JTemplate_slotPtr(o, s) ((U8 *)BufPrint_getBuf(&(o)->out) + (s)->offset)
+
+/* Right align 'len' bytes in the slot and pad with leading spaces */
+static int
+JTemplate_setRight(JTemplate *o, JTemplateSlot *s, const char *val, int len)
+{
+   U8 *ptr;
+   if (len > s->width)
+      return -1;
+   ptr = JTemplate_slotPtr(o, s);
+   memset(ptr, ' ', s->width - len);
+   memcpy(ptr + s->width - len, val, len);
+   return 0;
+}
+
+/* CBOR head with a fixed size argument */
+static void
+JTemplate_setHead(JTemplate *o, JTemplateSlot *s, U8 ib, U64 val)
+{
+   U8 *ptr = JTemplate_slotPtr(o, s);
+   int i;
+   *ptr = ib;
+   for (i = s->width - 1; i > 0; i--)
+   {
+      ptr[i] = (U8)val;
+      val >>= 8;
+   }
+}
+
+static int
+JTemplate_setNumber(JTemplate *o, JTemplateSlot *s, S64 val)
+{
+   if (JTemplate_isCBOR(o))
+   {
+      /* Major type 0 or 1 with a 4 or 8 byte argument */
+      U8 ib = s->width == 5 ? 0x1A : 0x1B;
+      if (val < 0)
+         JTemplate_setHead(o, s, (U8)(ib | 0x20), (U64)(-1 - val));
+      else
+         JTemplate_setHead(o, s, ib, (U64)val);
+      return 0;
+   }
+   else
+   {
+      char buf[BUFPRINT_ITOA_SIZE];
+      return JTemplate_setRight(o, s, buf, BufPrint_itoa(buf, val, 0));
+   }
+}
+
+void JTemplate_constructor(JTemplate *o, char *buf, int size, BaBool cbor)
+{
+   BufPrint_constructor2(&o->out, buf, size, 0, JTemplate_flush);
+   JErr_constructor(&o->err);
+   JEncoder_constructor(&o->encoder, &o->err, &o->out);
+#ifndef NO_CBOR
+   JEncoder_setCBOR(&o->encoder, cbor);
+#else
+   (void)cbor;
+#endif
+   o->slotLen = 0;
+}
+
+int JTemplate_slot(JTemplate *o, JParserT t, int width)
+{
+   U8 placeholder[255];
+   JTemplateSlot *s;
+   if (JErr_isError(&o->err))
+      return -1;
+   if (o->slotLen == JTEMPLATE_MAX_SLOTS)
+   {
+      JErr_setError(&o->err, JErrT_FmtValErr, "Too many slots");
+      return -1;
+   }
+   if (JTemplate_isCBOR(o))
+   {
+      switch (t)
+      {
+         case JParserT_Int: width = 5; break;
+         case JParserT_Long: width = 9; break;
+#ifndef NO_DOUBLE
+         case JParserT_Double: width = 9; break;
+#endif
+         case JParserT_Boolean: width = 1; break;
+         default:
+            JErr_setError(&o->err, JErrT_FmtValErr, "Slot type not supported");
+            return -1;
+      }
+   }
+   else
+   {
+      int min;
+      switch (t)
+      {
+         /* Default widths hold any value of the type */
+         case JParserT_Int: min = 1; if (!width) width = 11; break;
+         case JParserT_Long: min = 1; if (!width) width = 20; break;
+#ifndef NO_DOUBLE
+         case JParserT_Double: min = 1; if (!width) width = 24; break;
+#endif
+         case JParserT_Boolean: min = 5; if (!width) width = 5; break;
+         case JParserT_String: min = 2; if (!width) width = 34; break;
+         default:
+            JErr_setError(&o->err, JErrT_FmtValErr, "Slot type not supported");
+            return -1;
+      }
+      if (width < min || width > (int)sizeof(placeholder))
+      {
+         JErr_setError(&o->err, JErrT_FmtValErr, "Invalid slot width");
+         return -1;
+      }
+   }
+   /* The placeholder is a valid value: a zero CBOR item, or "0",
+      false, or "" padded with spaces.
+    */
+   if (JTemplate_isCBOR(o))
+   {
+      memset(placeholder, 0, width);
+      placeholder[0] = t == JParserT_Int ? 0x1A : t == JParserT_Long ? 0x1B :
+         t == JParserT_Boolean ? 0xF4 : 0xFB;
+   }
+   else
+   {
+      memset(placeholder, ' ', width);
+      if (t == JParserT_String)
+         placeholder[0] = placeholder[1] = '"';
+      else if (t == JParserT_Boolean)
+         memcpy(placeholder, "false", 5);
+      else
+         placeholder[width - 1] = '0';
+   }
+   if (JEncoder_setRaw(&o->encoder, placeholder, width))
+      return -1;
+   /* The slot ends at the cursor; a member name or separator may precede it */
+   s = o->slots + o->slotLen;
+   s->offset = (U16)(BufPrint_getBufSize(&o->out) - width);
+   s->width = (U8)width;
+   s->type = (U8)t;
+   return o->slotLen++;
+}
+
+int JTemplate_end(JTemplate *o)
+{
+   if (JErr_noError(&o->err) && o->encoder.objectStack.level)
+      JErr_setError(&o->err, JErrT_FmtValErr, "Unterminated object or array");
+   return JErr_isError(&o->err) ? -1 : 0;
+}
+
+int JTemplate_setInt(JTemplate *o, int slot, S32 val)
+{
+   JTemplateSlot *s = JTemplate_getSlot(o, slot, JParserT_Int);
+   return s ? JTemplate_setNumber(o, s, val) : -1;
+}
+
+int JTemplate_setLong(JTemplate *o, int slot, S64 val)
+{
+   JTemplateSlot *s = JTemplate_getSlot(o, slot, JParserT_Long);
+   return s ? JTemplate_setNumber(o, s, val) : -1;
+}
+
+#ifndef NO_DOUBLE
+int JTemplate_setDouble(JTemplate *o, int slot, double val)
+{
+   JTemplateSlot *s = JTemplate_getSlot(o, slot, JParserT_Double);
+   if (!s)
+      return -1;
+   if (JTemplate_isCBOR(o))
+   {
+      U64 u;
+      memcpy(&u, &val, sizeof(u));
+      JTemplate_setHead(o, s, 0xFB, u);
+      return 0;
+   }
+   else
+   {
+      char buf[BUFPRINT_DTOA_SIZE];
+      return JTemplate_setRight(o, s, buf, BufPrint_dtoa(buf, val));
+   }
+}
+#endif
+
+int JTemplate_setBoolean(JTemplate *o, int slot, BaBool val)
+{
+   JTemplateSlot *s = JTemplate_getSlot(o, slot, JParserT_Boolean);
+   if (!s)
+      return -1;
+   if (JTemplate_isCBOR(o))
+      *JTemplate_slotPtr(o, s) = val ? 0xF5 : 0xF4;
+   else
+   {
+      U8 *ptr = JTemplate_slotPtr(o, s);
+      memset(ptr, ' ', s->width);
+      memcpy(ptr, val ? "true" : "false", val ? 4 : 5);
+   }
+   return 0;
+}
+
+int JTemplate_setString(JTemplate *o, int slot, const char *val)
+{
+   char buf[256];
+   BufPrint bp;
+   U8 *ptr;
+   JTemplateSlot *s = JTemplate_getSlot(o, slot, JParserT_String);
+   if (!s)
+      return -1;
+   /* Escape to a temporary buffer so the slot is unchanged on error */
+   BufPrint_constructor2(&bp, buf, s->width, 0, JTemplate_flush);
+   if (val ? BufPrint_jsonString(&bp, val) < 0 : BufPrint_write(&bp, "null", 4) < 0)
+      return -1;
+   ptr = JTemplate_slotPtr(o, s);
+   memcpy(ptr, buf, bp.cursor);
+   memset(ptr + bp.cursor, ' ', s->width - bp.cursor);
+   return 0;
+}
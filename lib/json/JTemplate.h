@@ -0,0 +1,190 @@
+/*
+ * Pre-serialized message templates with fixed width value slots.
+ */
+
+#ifndef __JTemplate_h
+#define __JTemplate_h
+
+#include "JEncoder.h"
+
+/** @addtogroup JSONRef
+@{
+*/
+
+/** Maximum number of value slots in one template. */
+#ifndef JTEMPLATE_MAX_SLOTS
+#define JTEMPLATE_MAX_SLOTS 16
+#endif
+
+#ifndef __DOXYGEN__
+typedef struct
+{
+   U16 offset; /* Position in the template buffer */
+   U8 width;   /* Number of bytes reserved */
+   U8 type;    /* JParserT */
+} JTemplateSlot;
+#endif
+
+/** A JTemplate is a message encoded once, with a fixed width slot
+    for each value that changes between sends. Sending the message
+    again only rewrites the slot bytes; no JEncoder state machine,
+    member names, or separators are involved.
+
+    The template is built with the JEncoder returned by getEncoder.
+    Static parts are set with the regular JEncoder methods, and each
+    variable value is reserved by calling slot in place of a set
+    method:
+
+    \code
+    char buf[64];
+    JTemplate t(buf, sizeof(buf), false);
+    JEncoder* e = t.getEncoder();
+    e->beginObject();
+    e->setName("led");
+    int led = t.slot(JParserT_Boolean, 0);
+    e->setName("temp");
+    int temp = t.slot(JParserT_Double, 0);
+    e->endObject();
+    if(t.end()) ... // Error
+    ...
+    t.setBoolean(led, true);
+    t.setDouble(temp, 21.5);
+    send(sock, t.getBuf(), t.getLen(), 0);
+    \endcode
+
+    In JSON mode, a slot is padded with spaces, which is insignificant
+    white space in JSON, so the message length never changes. Numbers
+    are right aligned and strings are left aligned.
+
+    In CBOR mode, numbers and booleans use a fixed size head: 5 bytes
+    for int, 9 bytes for long and double, and 1 byte for boolean. CBOR
+    has no padding, thus string slots are not supported in CBOR mode.
+    NaN and Inf are encoded as is in CBOR mode and as null in JSON.
+*/
+typedef struct JTemplate
+{
+#ifdef __cplusplus
+   /** Create a template in 'buf'.
+       \param buf the template buffer, which must be large enough for
+       the complete message.
+       \param size sizeof(buf).
+       \param cbor encode CBOR instead of JSON text.
+   */
+   JTemplate(char *buf, int size, bool cbor);
+
+   /** Returns the encoder used for building the template.
+    */
+   JEncoder *getEncoder();
+
+   /** Reserve a slot for the next value.
+       \param t the value type: JParserT_Int, JParserT_Long,
+       JParserT_Double, JParserT_Boolean, or JParserT_String.
+       \param width the number of bytes to reserve in JSON mode,
+       including quotes for strings, or 0 for the default width. The
+       width is fixed by the type in CBOR mode.
+       \returns the slot index or -1 on error.
+   */
+   int slot(JParserT t, int width);
+
+   /** Completes the template.
+       \returns 0 if the template is complete and valid.
+   */
+   int end();
+
+   /** Rewrite a slot. The set methods return -1 if the value does
+       not fit or if the slot has a different type, leaving the slot
+       unchanged.
+   */
+   int setInt(int slot, S32 val);
+   int setLong(int slot, S64 val);
+#ifndef NO_DOUBLE
+   int setDouble(int slot, double val);
+#endif
+   int setBoolean(int slot, bool val);
+   int setString(int slot, const char *val);
+
+   /** Returns the encoded message. */
+   const char *getBuf();
+
+   /** Returns the message length. */
+   int getLen();
+#endif
+   BufPrint out; /* Writes the template to the buffer */
+   JErr err;
+   JEncoder encoder;
+   JTemplateSlot slots[JTEMPLATE_MAX_SLOTS];
+   int slotLen;
+} JTemplate;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+   BA_API void JTemplate_constructor(
+       JTemplate *o, char *buf, int size, BaBool cbor);
+#define JTemplate_getEncoder(o) (&(o)->encoder)
+   BA_API int JTemplate_slot(JTemplate *o, JParserT t, int width);
+   BA_API int JTemplate_end(JTemplate *o);
+   BA_API int JTemplate_setInt(JTemplate *o, int slot, S32 val);
+   BA_API int JTemplate_setLong(JTemplate *o, int slot, S64 val);
+#ifndef NO_DOUBLE
+   BA_API int JTemplate_setDouble(JTemplate *o, int slot, double val);
+#endif
+   BA_API int JTemplate_setBoolean(JTemplate *o, int slot, BaBool val);
+   BA_API int JTemplate_setString(JTemplate *o, int slot, const char *val);
+#define JTemplate_getBuf(o) ((const char *)BufPrint_getBuf(&(o)->out))
+#define JTemplate_getLen(o) BufPrint_getBufSize(&(o)->out)
+#ifdef __cplusplus
+}
+inline JTemplate::JTemplate(char *buf, int size, bool cbor)
+   : encoder(&err, &out)
+{
+   JTemplate_constructor(this, buf, size, cbor ? TRUE : FALSE);
+}
+inline JEncoder *JTemplate::getEncoder()
+{
+   return JTemplate_getEncoder(this);
+}
+inline int JTemplate::slot(JParserT t, int width)
+{
+   return JTemplate_slot(this, t, width);
+}
+inline int JTemplate::end()
+{
+   return JTemplate_end(this);
+}
+inline int JTemplate::setInt(int slot, S32 val)
+{
+   return JTemplate_setInt(this, slot, val);
+}
+inline int JTemplate::setLong(int slot, S64 val)
+{
+   return JTemplate_setLong(this, slot, val);
+}
+#ifndef NO_DOUBLE
+inline int JTemplate::setDouble(int slot, double val)
+{
+   return JTemplate_setDouble(this, slot, val);
+}
+#endif
+inline int JTemplate::setBoolean(int slot, bool val)
+{
+   return JTemplate_setBoolean(this, slot, val ? TRUE : FALSE);
+}
+inline int JTemplate::setString(int slot, const char *val)
+{
+   return JTemplate_setString(this, slot, val);
+}
+inline const char *JTemplate::getBuf()
+{
+   return JTemplate_getBuf(this);
+}
+inline int JTemplate::getLen()
+{
+   return JTemplate_getLen(this);
+}
+#endif
+
+/** @} */ /* end of JSONRef */
+
+#endif
@@ -35,6 +35,11 @@
 #define LWIP_NETIF_LINK_CALLBACK 1
 #define LWIP_NETIF_HOSTNAME 1
 #define LWIP_NETCONN 0
+// The TCP task blocks in recv() while other tasks send on the same socket,
+// and IOT_stopMessageLoop wakes it with shutdown(). Tasks using sockets must
+// call lwip_socket_thread_init().
+#define LWIP_NETCONN_FULLDUPLEX 1
+#define LWIP_NETCONN_SEM_PER_THREAD 1
 #define MEM_STATS 0
 #define SYS_STATS 0
 #define MEMP_STATS 0
@@ -47,6 +52,10 @@
 #define LWIP_UDP 1
 #define LWIP_DNS 1
 #define LWIP_TCP_KEEPALIVE 1
+// tcp_task rebinds its local port on reconnect, and the connect race
+// binds it once per server; losing sockets are reset with SO_LINGER 0
+#define SO_REUSE 1
+#define LWIP_SO_LINGER 1
 #define LWIP_NETIF_TX_SINGLE_PBUF 1
 #define DHCP_DOES_ARP_CHECK 0
 #define LWIP_DHCP_DOES_ACD_CHECK 0
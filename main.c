@@ -7,6 +7,7 @@
 #include "lib/acme_5_outlines_font.h"
 #include "lib/BMSPA_font.h"
 #include "iot_tcpclient.h"
+#include "iot_servers.h"
 #include "lib/fontd.h"
 
 #pragma region Icons
@@ -76,8 +77,17 @@ typedef struct _settingsData
     char wifiPassword[65];
     uint8_t controlByteB;
     uint8_t controlByteD;
+    /* Added after the fields above, so older settings keep their
+       layout; SETTINGS_SERVERS_SET marks a server list written by
+       setupWIFI_end. */
+    uint8_t serversSet;
+    char servers[IOT_SERVER_LIST_LEN];
 } SettingsData;
 
+#define SETTINGS_SERVERS_SET 0xA5
+
+_Static_assert(sizeof(SettingsData) <= FLASH_PAGE_SIZE, "nvmem_write programs one flash page");
+
 rotencoder_t actionRot;
 
 SemaphoreHandle_t dispMut; // I2C is not thread safe
@@ -334,6 +344,37 @@ void setupWIFI_end(SettingsData *settings, SettingsData *oldSettings)
 
     debugLog(NULL, "Copied wifi password.");
 
+    /* Only parsed to validate the input; tcp_task builds its own list */
+    static iot_server_list_t check;
+    settings->serversSet = 0;
+    for (;;)
+    {
+        printf("\n[CFG] Enter the servers as host:port separated by ',' (empty for %s):\n", IOT_SERVERS);
+        /* Not waitForLine, which skips the empty line */
+        char *servers = getLine(true, '\r', &length);
+        if (!servers || length == 0)
+        {
+            /* Keep the default, also when out of memory */
+            free(servers);
+            break;
+        }
+        if (length < IOT_SERVER_LIST_LEN)
+        {
+            strncpy(settings->servers, servers, length);
+            settings->servers[length] = '\0';
+            if (IOT_serverList_parse(&check, settings->servers) >= 0)
+            {
+                settings->serversSet = SETTINGS_SERVERS_SET;
+                free(servers);
+                break;
+            }
+        }
+        free(servers);
+        printf("\n[CFG] Invalid server list.\n");
+    }
+
+    debugLog(NULL, "Copied servers.");
+
     settings->wifiSetup = true;
     settings->controlByteA = oldSettings->controlByteA + 1;
     settings->controlByteB = settings->controlByteA + 3;
@@ -407,65 +448,107 @@ static void tcp_status_update(bool data)
     F_END("tcp_status_update");
 }
 
-static void tcp_task(__unused void *params)
+/* Reconnect backoff: the delay doubles per failed attempt up to the
+   maximum, and is randomized so devices losing the same server do not
+   reconnect in step.
+ */
+#define TCP_RECONNECT_MIN_MS 500
+#define TCP_RECONNECT_MAX_MS 30000
+
+/* Keepalive probes find a server that vanished while nothing is sent */
+#define TCP_KEEPALIVE_IDLE_S 10
+#define TCP_KEEPALIVE_INTVL_S 2
+#define TCP_KEEPALIVE_COUNT 3
+
+iot_server_list_t serverList;
+
+static void tcp_set_icon(size_t icon)
 {
-    C_START("tcp_task");
-    int client_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
-    struct sockaddr_in listen_addr = {};
-    listen_addr.sin_len = sizeof(struct sockaddr_in);
-    listen_addr.sin_family = AF_INET;
-    listen_addr.sin_port = htons(5001);
-    listen_addr.sin_addr.s_addr = 0;
-
-    struct sockaddr_in connect_addr = {};
-    connect_addr.sin_len = sizeof(struct sockaddr_in);
-    connect_addr.sin_family = AF_INET;
-    connect_addr.sin_port = htons(23);
-    connect_addr.sin_addr.s_addr = PP_HTONL(LWIP_MAKEU32(192, 168, 1, 153));
-
-    if (client_sock < 0)
+    if (xSemaphoreTake(dispMut, 100))
     {
-        debugLog("[TCP] Unable to create socket: error %d", NULL, errno);
-
-        ssd1306_draw_status_icon_array(&disp, tcpIcon, ICONS_TCP_FAIL);
+        ssd1306_draw_status_icon_array(&disp, tcpIcon, icon);
         ssd1306_show(&disp);
-        vTaskDelete(NULL);
-        C_RETURN("tcp_task");
+        xSemaphoreGive(dispMut);
     }
+}
 
-    if (bind(client_sock, (struct sockaddr *)&listen_addr, sizeof(listen_addr)) < 0)
-    {
-        debugLog("[TCP] Unable to bind socket: error %d", NULL, errno);
+static void tcp_set_keepalive(int sock)
+{
+    int opt = 1;
+    setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &opt, sizeof(opt));
+    opt = TCP_KEEPALIVE_IDLE_S;
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &opt, sizeof(opt));
+    opt = TCP_KEEPALIVE_INTVL_S;
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &opt, sizeof(opt));
+    opt = TCP_KEEPALIVE_COUNT;
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &opt, sizeof(opt));
+}
 
-        ssd1306_draw_status_icon_array(&disp, tcpIcon, ICONS_TCP_FAIL);
-        ssd1306_show(&disp);
-        vTaskDelete(NULL);
-        C_RETURN("tcp_task");
-    }
+/* Connection manager: connects to the fastest reachable server, runs
+   the message loop, and reconnects with backoff until
+   IOT_stopMessageLoop is called. The client is built once, so its
+   buffers and unsent messages carry over to the next connection.
+ */
+static void tcp_task(void *params)
+{
+    C_START("tcp_task");
+    SettingsData *settings = (SettingsData *)params;
+    lwip_socket_thread_init();
+    int client_sock = -1;
 
-    if (connect(client_sock, (struct sockaddr *)&connect_addr, sizeof(connect_addr)) < 0)
+    IOT_serverList_constructor(&serverList);
+    if (settings->serversSet != SETTINGS_SERVERS_SET ||
+        !memchr(settings->servers, 0, IOT_SERVER_LIST_LEN) ||
+        IOT_serverList_parse(&serverList, settings->servers) < 0)
     {
-        debugLog("[TCP] Unable to connect to server: error %d", NULL, errno);
-
-        ssd1306_draw_status_icon_array(&disp, tcpIcon, ICONS_TCP_FAIL);
-        ssd1306_show(&disp);
-        vTaskDelete(NULL);
-        C_RETURN("tcp_task");
+        IOT_serverList_parse(&serverList, IOT_SERVERS);
     }
+    debugLog("[TCP] %d server(s), first %s:%u", NULL, serverList.count, serverList.servers[0].host, serverList.servers[0].port);
 
-    debugLog("[TCP] Connected client from %s with port %u", NULL, ip4addr_ntoa(netif_ip4_addr(netif_list)), ntohs(listen_addr.sin_port));
+    IOT_constructor(&client, &client_sock, tcp_status_update);
+    IOT_setCBOR(&client, IOT_USE_CBOR);
+    if (IOT_setFraming(&client, IOT_FRAMING))
+        debugLog("[TCP] Framing %d not supported with CBOR", NULL, IOT_FRAMING);
+    clientInitialized = true;
 
-    ssd1306_draw_status_icon_array(&disp, tcpIcon, ICONS_TCP_UP);
-    ssd1306_show(&disp);
+    uint32_t backoff = TCP_RECONNECT_MIN_MS;
+    while (client.running)
+    {
+        client_sock = IOT_serverList_connect(&serverList, IOT_LOCAL_PORT);
+        if (client_sock >= 0)
+        {
+            iot_server_t *server = IOT_serverList_current(&serverList);
+            debugLog("[TCP] Connected to %s:%u from %s, rtt %u ms", NULL, server->host, server->port, ip4addr_ntoa(netif_ip4_addr(netif_list)), server->srtt);
+            tcp_set_keepalive(client_sock);
+            tcp_set_icon(ICONS_TCP_UP);
+            backoff = TCP_RECONNECT_MIN_MS;
 
-    IOT_constructor(&client, &client_sock, tcp_status_update);
+            IOT_startMessageLoop(&client);
 
-    clientInitialized = true;
-    IOT_startMessageLoop(&client);
-    clientInitialized = false;
+            int sock = client_sock;
+            client_sock = -1;
+            if (!client.running)
+            {
+                closesocket(sock);
+                break;
+            }
+            /* A reset leaves no TIME_WAIT blocking the local port */
+            IOT_abortSocket(sock);
+            debugLog("[TCP] Connection lost", NULL);
+        }
+        else
+            debugLog("[TCP] No server reachable", NULL);
+        tcp_set_icon(ICONS_TCP_FAIL);
+
+        /* Half the backoff, plus up to the other half at random */
+        uint32_t delay = backoff / 2 + (uint32_t)get_rand_int(0, backoff / 2 + 1);
+        debugLog("[TCP] Reconnecting in %u ms", NULL, delay);
+        vTaskDelay(pdMS_TO_TICKS(delay));
+        backoff = min(backoff * 2, TCP_RECONNECT_MAX_MS);
+    }
 
-    ssd1306_draw_status_icon_array(&disp, tcpIcon, ICONS_TCP_FAIL);
-    ssd1306_show(&disp);
+    clientInitialized = false;
+    tcp_set_icon(ICONS_TCP_FAIL);
 
     vTaskDelete(NULL);
     C_END("tcp_task");
@@ -713,7 +796,10 @@ static void ui_task(void *params)
                     if (timeL.hour == 0)
                         timeL.hour = 12;
 
-                    sprintf(strBuf, "%d:%02d", timeL.hour, timeL.min);
+                    int len = BufPrint_itoa(strBuf, timeL.hour, 0);
+                    strBuf[len++] = ':';
+                    len += BufPrint_itoa(strBuf + len, timeL.min, 2);
+                    strBuf[len] = 0;
 
                     ssd1306_string_measure timeSize = ssd1306_measure_string(BMSPA_font, strBuf, 3);
                     uint32_t offX = disp.width / 2 - timeSize.width / 2;
@@ -731,7 +817,7 @@ static void ui_task(void *params)
                         onboardTemp = read_onboard_temperature(TEMPERATURE_UNITS);
                     }
 
-                    sprintf(strBuf, "%d", (int)roundf(onboardTemp));
+                    strBuf[BufPrint_itoa(strBuf, (int)roundf(onboardTemp), 0)] = 0;
 
                     ssd1306_string_measure strSize = ssd1306_measure_string(BMSPA_font, strBuf, 3);
                     ssd1306_string_measure degSize = ssd1306_measure_string(BMSPA_font, "o", 1);
@@ -775,7 +861,7 @@ static void ui_task(void *params)
                             if (minutes == 0)
                             {
                                 // draw big seconds
-                                sprintf(strBuf, "%lld", seconds);
+                                strBuf[BufPrint_itoa(strBuf, seconds, 0)] = 0;
 
                                 ssd1306_string_measure numSize = ssd1306_measure_string(fontd_8x5, strBuf, 3);
                                 ssd1306_string_measure unitSize = ssd1306_measure_string(fontd_8x5, "sec.", 2);
@@ -790,8 +876,9 @@ static void ui_task(void *params)
                             else
                             {
                                 // draw big minutes + small seconds
-                                sprintf(strBuf, "%lld", minutes);
-                                sprintf(strBufS, ":%02lld", seconds);
+                                strBuf[BufPrint_itoa(strBuf, minutes, 0)] = 0;
+                                strBufS[0] = ':';
+                                strBufS[1 + BufPrint_itoa(strBufS + 1, seconds, 2)] = 0;
 
                                 ssd1306_string_measure numSize = ssd1306_measure_string(fontd_8x5, strBuf, 3);
                                 ssd1306_string_measure subSize = ssd1306_measure_string(fontd_8x5, strBufS, 2);
@@ -807,8 +894,12 @@ static void ui_task(void *params)
                         else
                         {
                             // draw big hours + small minutes:seconds
-                            sprintf(strBuf, "%lld", hours);
-                            sprintf(strBufS, ":%02lld:%02lld", minutes, seconds);
+                            strBuf[BufPrint_itoa(strBuf, hours, 0)] = 0;
+                            strBufS[0] = ':';
+                            BufPrint_itoa(strBufS + 1, minutes, 2);
+                            strBufS[3] = ':';
+                            BufPrint_itoa(strBufS + 4, seconds, 2);
+                            strBufS[6] = 0;
 
                             ssd1306_string_measure numSize = ssd1306_measure_string(fontd_8x5, strBuf, 3);
                             ssd1306_string_measure subSize = ssd1306_measure_string(fontd_8x5, strBufS, 2);
@@ -858,6 +949,10 @@ static void main_task(__unused void *params)
         C_RETURN("main_task");
     }
 
+    /* lwIP socket calls from this task need the per-thread semaphore:
+       IOT_stopMessageLoop calls shutdown() on the client socket */
+    lwip_socket_thread_init();
+
     cyw43_arch_enable_sta_mode();
     netif_set_hostname(netif_default, WIFI_HOSTNAME);
 
@@ -951,7 +1046,7 @@ static void main_task(__unused void *params)
 
     TaskHandle_t tcpTask;
     debugLog("[MAIN] Starting TCP client task", "Starting client.");
-    xTaskCreate(tcp_task, "TCPThread", configMINIMAL_STACK_SIZE, NULL, (tskIDLE_PRIORITY + 2UL), &tcpTask);
+    xTaskCreate(tcp_task, "TCPThread", configMINIMAL_STACK_SIZE, settings, (tskIDLE_PRIORITY + 2UL), &tcpTask);
 
     while (!clientInitialized) // wait for iot client
     {
@@ -973,7 +1068,8 @@ static void main_task(__unused void *params)
         if (time_reached(nextSendTime))
         {
             nextSendTime = make_timeout_time_ms(1000);
-            if (IOT_Send(&client, "{b}", JE_MEMBER(&((&client)->packet), led)) < 0)
+            iot_telemetry_t telemetry = {.led = client.packet.led};
+            if (IOT_sendTelemetry(&client, &telemetry) < 0)
                 IOT_stopMessageLoop(&client);
         }
     }
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "JParser.h"
+#include "JDecoder.h"
+#include "JEncoder.h"
+#include "bench_messages.h"
+
+#define CHUNK_SIZE 256 /* Same as TCP_IN_OUT_BUF_SIZE */
+#define MIN_RUNTIME_NS 500000000ULL
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int discard_flush(BufPrint *o, int sizeRequired)
+{
+    (void)sizeRequired;
+    o->cursor = 0;
+    return 0;
+}
+
+static int parse_message(JParser *parser, const U8 *data, size_t size)
+{
+    int status = 0;
+    for (size_t off = 0; off < size; off += CHUNK_SIZE)
+    {
+        size_t n = size - off < CHUNK_SIZE ? size - off : CHUNK_SIZE;
+        status = JParser_parse(parser, data + off, (U32)n);
+        if (status < 0)
+            return status;
+    }
+    return status;
+}
+
+static void report(const char *name, unsigned long iterations, uint64_t elapsed, size_t size)
+{
+    double seconds = (double)elapsed / 1e9;
+    printf("%-18s %10.0f msg/s %8.2f MB/s %7.1f ns/msg\n", name, iterations / seconds,
+           (double)size * iterations / seconds / 1e6, (double)elapsed / iterations);
+}
+
+static int encode_generic(JEncoder *encoder, const bench_record_t *r)
+{
+    return JEncoder_set(encoder, "{bdlffsdb}",
+                        JE_MEMBER(r, enabled), JE_MEMBER(r, id), JE_MEMBER(r, timestamp),
+                        JE_MEMBER(r, temperature), JE_MEMBER(r, humidity), JE_MEMBER(r, label),
+                        JE_MEMBER(r, rssi), JE_MEMBER(r, alarm)) ||
+           JEncoder_commit(encoder);
+}
+
+static int bench_decode(const char *payload, size_t size, bool generated)
+{
+    static uintptr_t planBuf[64];
+    char memberName[16];
+    bench_record_t r;
+    bench_record_decoder_t decoder;
+    JDecoder jdecoder;
+    JParser parser;
+    JParserIntf *intf;
+    unsigned long iterations = 0;
+    uint64_t start, elapsed;
+
+    memset(&r, 0, sizeof(r));
+    if (generated)
+    {
+        bench_record_decoder_constructor(&decoder, &r);
+        intf = (JParserIntf *)&decoder;
+    }
+    else
+    {
+        JDecoder_constructor(&jdecoder, (U8 *)planBuf, sizeof(planBuf), 0);
+        if (JDecoder_get(&jdecoder, "{bdlffsdb}",
+                         JD_MNUM(&r, enabled), JD_MNUM(&r, id), JD_MNUM(&r, timestamp),
+                         JD_MNUM(&r, temperature), JD_MNUM(&r, humidity), JD_MSTR(&r, label),
+                         JD_MNUM(&r, rssi), JD_MNUM(&r, alarm)))
+        {
+            fprintf(stderr, "JDecoder_get failed\n");
+            return -1;
+        }
+        intf = (JParserIntf *)&jdecoder;
+    }
+    JParser_constructor(&parser, intf, memberName, sizeof(memberName),
+                        AllocatorIntf_getDefault(), 0);
+    JParser_setZeroCopy(&parser, TRUE);
+
+    start = now_ns();
+    do
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            if (!generated)
+                JDecoder_reset(&jdecoder);
+            if (parse_message(&parser, (const U8 *)payload, size) <= 0)
+            {
+                fprintf(stderr, "Parse failed: %d\n", JParser_getStatus(&parser));
+                JParser_destructor(&parser);
+                return -1;
+            }
+        }
+        iterations += 1000;
+        elapsed = now_ns() - start;
+    } while (elapsed < MIN_RUNTIME_NS);
+
+    if (r.id != 42 || strcmp(r.label, "living room sensor") || !r.alarm)
+    {
+        fprintf(stderr, "Decoded record does not match payload\n");
+        JParser_destructor(&parser);
+        return -1;
+    }
+    report(generated ? "decode generated" : "decode generic", iterations, elapsed, size);
+    JParser_destructor(&parser);
+    return 0;
+}
+
+static int bench_encode(const bench_record_t *r, size_t size, bool generated)
+{
+    char buf[256];
+    BufPrint out;
+    JErr err;
+    JEncoder encoder;
+    unsigned long iterations = 0;
+    uint64_t start, elapsed;
+
+    BufPrint_constructor2(&out, buf, sizeof(buf), 0, discard_flush);
+    JErr_constructor(&err);
+    JEncoder_constructor(&encoder, &err, &out);
+
+    start = now_ns();
+    do
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            if (generated ? bench_record_encode(&out, r) || BufPrint_flush(&out)
+                          : encode_generic(&encoder, r))
+            {
+                fprintf(stderr, "Encode failed\n");
+                return -1;
+            }
+        }
+        iterations += 1000;
+        elapsed = now_ns() - start;
+    } while (elapsed < MIN_RUNTIME_NS);
+
+    report(generated ? "encode generated" : "encode generic", iterations, elapsed, size);
+    return 0;
+}
+
+int main(int ac, char *as[])
+{
+    static const bench_record_t record = {
+        true, 42, 1700000000123LL, 21.5, 40.25, "living room sensor", -67, true};
+    char generic[256], generated[256];
+    BufPrint out;
+    JErr err;
+    JEncoder encoder;
+    size_t size;
+
+    (void)ac;
+    (void)as;
+
+    /* Both paths must produce the same JSON */
+    BufPrint_constructor2(&out, generic, sizeof(generic), 0, discard_flush);
+    JErr_constructor(&err);
+    JEncoder_constructor(&encoder, &err, &out);
+    if (JEncoder_set(&encoder, "{bdlffsdb}",
+                     JE_MEMBER(&record, enabled), JE_MEMBER(&record, id),
+                     JE_MEMBER(&record, timestamp), JE_MEMBER(&record, temperature),
+                     JE_MEMBER(&record, humidity), JE_MEMBER(&record, label),
+                     JE_MEMBER(&record, rssi), JE_MEMBER(&record, alarm)))
+    {
+        fprintf(stderr, "JEncoder_set failed\n");
+        return EXIT_FAILURE;
+    }
+    size = (size_t)out.cursor;
+    generic[size] = 0;
+    BufPrint_constructor2(&out, generated, sizeof(generated), 0, discard_flush);
+    bench_record_encode(&out, &record);
+    generated[out.cursor] = 0;
+    if (strcmp(generic, generated))
+    {
+        fprintf(stderr, "Output differs:\n  %s\n  %s\n", generic, generated);
+        return EXIT_FAILURE;
+    }
+    printf("%s (%zu bytes)\n", generated, size);
+
+    if (bench_decode(generic, size, false) || bench_decode(generic, size, true) ||
+        bench_encode(&record, size, false) || bench_encode(&record, size, true))
+    {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
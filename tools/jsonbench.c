@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "JParser.h"
+
+#define CHUNK_SIZE 256 /* Same as TCP_IN_OUT_BUF_SIZE */
+#define MIN_RUNTIME_NS 500000000ULL
+
+typedef struct
+{
+    JParserIntf super;
+    unsigned long values;
+} CountingIntf;
+
+static int CountingIntf_service(JParserIntf *super, JParserVal *v, int recLevel)
+{
+    (void)v;
+    (void)recLevel;
+    ((CountingIntf *)super)->values++;
+    return 0;
+}
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Pretty-printed command payload, similar to what the servers send */
+static size_t make_pretty_payload(char *buf, size_t size)
+{
+    size_t len = 0;
+    len += snprintf(buf + len, size - len, "{\n    \"led\": true,\n    \"name\": \"%s\",\n    \"items\": [\n",
+                    "PicoW IoT Device living room sensor, firmware channel stable");
+    for (int i = 0; i < 16 && len < size; i++)
+    {
+        len += snprintf(buf + len, size - len,
+                        "        {\n            \"id\": %d,\n            \"label\": \"actuator number %d on the east wall\",\n"
+                        "            \"enabled\": %s\n        }%s\n",
+                        i, i, i & 1 ? "true" : "false", i == 15 ? "" : ",");
+    }
+    len += snprintf(buf + len, size - len, "    ]\n}\n");
+    return len;
+}
+
+static int parse_message(JParser *parser, const U8 *data, size_t size)
+{
+    int status = 0;
+    for (size_t off = 0; off < size; off += CHUNK_SIZE)
+    {
+        size_t n = size - off < CHUNK_SIZE ? size - off : CHUNK_SIZE;
+        status = JParser_parse(parser, data + off, (U32)n);
+        if (status < 0)
+            return status;
+    }
+    return status;
+}
+
+static int run_bench(const char *payload, size_t size, bool zeroCopy)
+{
+    char memberName[64];
+    CountingIntf intf;
+    JParser parser;
+    unsigned long iterations = 0;
+
+    JParserIntf_constructor((JParserIntf *)&intf, CountingIntf_service);
+    intf.values = 0;
+    JParser_constructor(&parser, (JParserIntf *)&intf, memberName, sizeof(memberName),
+                        AllocatorIntf_getDefault(), 0);
+    JParser_setZeroCopy(&parser, zeroCopy);
+
+    if (parse_message(&parser, (const U8 *)payload, size) <= 0)
+    {
+        fprintf(stderr, "Parse failed: %d\n", JParser_getStatus(&parser));
+        JParser_destructor(&parser);
+        return -1;
+    }
+
+    uint64_t start = now_ns(), elapsed;
+    do
+    {
+        for (int i = 0; i < 1000; i++)
+            parse_message(&parser, (const U8 *)payload, size);
+        iterations += 1000;
+        elapsed = now_ns() - start;
+    } while (elapsed < MIN_RUNTIME_NS);
+
+    double seconds = (double)elapsed / 1e9;
+    printf("%-10s %-9s %6zu bytes/msg %10.0f msg/s %8.2f MB/s (%lu values)\n",
+#ifdef NO_JLEXER_SWAR
+           "bytewise",
+#else
+           "swar",
+#endif
+           zeroCopy ? "zerocopy" : "copy",
+           size, iterations / seconds, (double)size * iterations / seconds / 1e6,
+           intf.values / (iterations + 1));
+
+    JParser_destructor(&parser);
+    return 0;
+}
+
+int main(int ac, char *as[])
+{
+    static char payload[16384];
+    size_t size = make_pretty_payload(payload, sizeof(payload));
+
+    (void)ac;
+    (void)as;
+
+    if (run_bench(payload, size, false) || run_bench(payload, size, true))
+        return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,482 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+
+/*
+ * Generates C structs with JSON encode/decode functions from a schema.
+ *
+ * Schema syntax, one declaration per line, '#' starts a comment:
+ *
+ *   struct iot_command_packet
+ *       bool led
+ *       string name 32
+ *   end
+ *
+ * Field types: bool, int (S32), long (S64), float, double and
+ * string <size> (char array including the zero terminator).
+ *
+ * For each struct <name> the generator emits the typedef <name>_t, a
+ * JParserIntf decoder <name>_decoder_t, an encoder <name>_encode
+ * writing JSON text directly to a BufPrint, and <name>_set, which
+ * emits the object through a JEncoder and therefore also supports the
+ * JEncoder CBOR mode. <name>_template builds a JTemplate with one slot
+ * per field, in declaration order, and <name>_patch rewrites the slots
+ * for a new value; structs with more than JTEMPLATE_MAX_SLOTS fields
+ * fail at run time.
+ */
+
+#define MAX_LINE 256
+#define MAX_NAME 64
+#define MAX_FIELDS 32 /* One bit per field in the decoder */
+#define MAX_STRUCTS 32
+
+typedef enum
+{
+    F_BOOL,
+    F_INT,
+    F_LONG,
+    F_FLOAT,
+    F_DOUBLE,
+    F_STRING
+} field_type_t;
+
+static const char *type_names[] = {"bool", "int", "long", "float", "double", "string"};
+static const char *c_types[] = {"bool", "S32", "S64", "float", "double", "char"};
+
+typedef struct
+{
+    char name[MAX_NAME];
+    field_type_t type;
+    int size; /* if F_STRING */
+} field_t;
+
+typedef struct
+{
+    char name[MAX_NAME];
+    field_t fields[MAX_FIELDS];
+    int count;
+} struct_t;
+
+static struct_t structs[MAX_STRUCTS];
+static int struct_count;
+
+static bool is_identifier(const char *s)
+{
+    if (!isalpha((unsigned char)*s) && *s != '_')
+        return false;
+    for (const char *p = s; *p; p++)
+        if (!isalnum((unsigned char)*p) && *p != '_')
+            return false;
+    return true;
+}
+
+static int parse_schema(const char *path, FILE *in)
+{
+    char line[MAX_LINE];
+    int lineno = 0;
+    struct_t *cur = NULL;
+
+    while (fgets(line, sizeof(line), in))
+    {
+        char kw[MAX_NAME], name[MAX_NAME], extra[MAX_NAME];
+        char *comment = strchr(line, '#');
+        int n;
+
+        ++lineno;
+        if (comment)
+            *comment = 0;
+        n = sscanf(line, "%63s %63s %63s", kw, name, extra);
+        if (n <= 0)
+            continue;
+
+        if (!strcmp(kw, "struct"))
+        {
+            if (cur || n != 2 || !is_identifier(name) || struct_count == MAX_STRUCTS)
+                goto fail;
+            cur = &structs[struct_count++];
+            strcpy(cur->name, name);
+        }
+        else if (!strcmp(kw, "end"))
+        {
+            if (!cur || n != 1 || !cur->count)
+                goto fail;
+            cur = NULL;
+        }
+        else
+        {
+            field_t *f;
+            size_t t;
+            if (!cur || n < 2 || !is_identifier(name) || cur->count == MAX_FIELDS)
+                goto fail;
+            for (t = 0; t < sizeof(type_names) / sizeof(type_names[0]); t++)
+                if (!strcmp(kw, type_names[t]))
+                    break;
+            if (t == sizeof(type_names) / sizeof(type_names[0]))
+                goto fail;
+            for (int i = 0; i < cur->count; i++)
+                if (!strcmp(cur->fields[i].name, name))
+                    goto fail;
+            f = &cur->fields[cur->count++];
+            strcpy(f->name, name);
+            f->type = (field_type_t)t;
+            f->size = 0;
+            if (f->type == F_STRING)
+            {
+                if (n != 3 || (f->size = atoi(extra)) < 2)
+                    goto fail;
+            }
+            else if (n != 2)
+                goto fail;
+        }
+    }
+    if (cur)
+    {
+        fprintf(stderr, "%s: missing 'end' for struct %s\n", path, cur->name);
+        return -1;
+    }
+    return 0;
+
+fail:
+    fprintf(stderr, "%s:%d: invalid declaration\n", path, lineno);
+    return -1;
+}
+
+static void write_header(FILE *out, const char *schema, const char *guard)
+{
+    fprintf(out, "/* Generated by tools/jsongen from %s. Do not edit. */\n\n", schema);
+    fprintf(out, "#ifndef %s\n#define %s\n\n", guard, guard);
+    fprintf(out, "#include <stdbool.h>\n");
+    fprintf(out, "#include \"lib/json/JDecoder.h\"\n");
+    fprintf(out, "#include \"lib/json/JTemplate.h\"\n");
+
+    for (int s = 0; s < struct_count; s++)
+    {
+        struct_t *st = &structs[s];
+        fprintf(out, "\ntypedef struct %s\n{\n", st->name);
+        for (int i = 0; i < st->count; i++)
+        {
+            field_t *f = &st->fields[i];
+            if (f->type == F_STRING)
+                fprintf(out, "    char %s[%d];\n", f->name, f->size);
+            else
+                fprintf(out, "    %s %s;\n", c_types[f->type], f->name);
+        }
+        fprintf(out, "} %s_t;\n\n", st->name);
+
+        fprintf(out, "/** JParserIntf decoding one JSON object at a time into 'dest'.\n"
+                     "    'status' is a JDecoderS_xxx code. The decoder re-arms itself\n"
+                     "    at the start of each object.\n"
+                     " */\n");
+        fprintf(out, "typedef struct\n{\n"
+                     "    JParserIntf super;\n"
+                     "    %s_t *dest;\n"
+                     "    U32 received; /* One bit per member */\n"
+                     "    int status;\n"
+                     "    bool inObject;\n"
+                     "} %s_decoder_t;\n\n",
+                st->name, st->name);
+        fprintf(out, "void %s_decoder_constructor(%s_decoder_t *o, %s_t *dest);\n",
+                st->name, st->name, st->name);
+        fprintf(out, "int %s_encode(BufPrint *out, const %s_t *v);\n", st->name, st->name);
+        fprintf(out, "int %s_set(JEncoder *e, const %s_t *v);\n", st->name, st->name);
+        fprintf(out, "int %s_template(JTemplate *t);\n", st->name);
+        fprintf(out, "int %s_patch(JTemplate *t, const %s_t *v);\n", st->name, st->name);
+    }
+    fprintf(out, "\n#endif\n");
+}
+
+static int compare_fields(const void *a, const void *b)
+{
+    const field_t *fa = *(const field_t *const *)a, *fb = *(const field_t *const *)b;
+    return strcmp(fa->name, fb->name);
+}
+
+static void write_field_decoder(FILE *out, struct_t *st, field_t *f)
+{
+    const char *indent = "            ";
+    switch (f->type)
+    {
+    case F_BOOL:
+        fprintf(out, "%sif (v->t != JParserT_Boolean)\n", indent);
+        fprintf(out, "%s    goto formatErr;\n", indent);
+        fprintf(out, "%sd->%s = v->v.b ? true : false;\n", indent, f->name);
+        break;
+    case F_INT:
+        fprintf(out, "%sif (v->t != JParserT_Int)\n", indent);
+        fprintf(out, "%s    goto formatErr;\n", indent);
+        fprintf(out, "%sd->%s = v->v.d;\n", indent, f->name);
+        break;
+    case F_LONG:
+        fprintf(out, "%sif (v->t == JParserT_Int)\n", indent);
+        fprintf(out, "%s    d->%s = v->v.d;\n", indent, f->name);
+        fprintf(out, "%selse if (v->t == JParserT_Long)\n", indent);
+        fprintf(out, "%s    d->%s = (S64)v->v.l;\n", indent, f->name);
+        fprintf(out, "%selse\n", indent);
+        fprintf(out, "%s    goto formatErr;\n", indent);
+        break;
+    case F_FLOAT:
+    case F_DOUBLE:
+        fprintf(out, "%sif (v->t == JParserT_Double)\n", indent);
+        fprintf(out, "%s    d->%s = (%s)v->v.f;\n", indent, f->name, c_types[f->type]);
+        fprintf(out, "%selse if (v->t == JParserT_Int)\n", indent);
+        fprintf(out, "%s    d->%s = (%s)v->v.d;\n", indent, f->name, c_types[f->type]);
+        fprintf(out, "%selse if (v->t == JParserT_Long)\n", indent);
+        fprintf(out, "%s    d->%s = (%s)(S64)v->v.l;\n", indent, f->name, c_types[f->type]);
+        fprintf(out, "%selse\n", indent);
+        fprintf(out, "%s    goto formatErr;\n", indent);
+        break;
+    case F_STRING:
+        fprintf(out, "%sif (v->t == JParserT_String)\n", indent);
+        fprintf(out, "%s{\n", indent);
+        fprintf(out, "%s    /* Not zero terminated if the parser is in zero copy mode */\n", indent);
+        fprintf(out, "%s    if (v->len >= sizeof(d->%s))\n", indent, f->name);
+        fprintf(out, "%s        return %s_decoder_fail(o, JDecoderS_StringOverflow);\n", indent, st->name);
+        fprintf(out, "%s    memcpy(d->%s, v->v.s, v->len);\n", indent, f->name);
+        fprintf(out, "%s    d->%s[v->len] = 0;\n", indent, f->name);
+        fprintf(out, "%s}\n", indent);
+        fprintf(out, "%selse if (v->t == JParserT_Null)\n", indent);
+        fprintf(out, "%s    d->%s[0] = 0;\n", indent, f->name);
+        fprintf(out, "%selse\n", indent);
+        fprintf(out, "%s    goto formatErr;\n", indent);
+        break;
+    }
+    fprintf(out, "%sbit = 0x%08lXUL;\n", indent, 1UL << (f - st->fields));
+}
+
+static void write_decoder(FILE *out, struct_t *st)
+{
+    field_t *sorted[MAX_FIELDS];
+    unsigned long all = st->count == 32 ? 0xFFFFFFFFUL : (1UL << st->count) - 1;
+    int i;
+
+    fprintf(out, "\nstatic int %s_decoder_fail(%s_decoder_t *o, int status)\n{\n"
+                 "    o->status = status;\n"
+                 "    o->inObject = false;\n"
+                 "    return status;\n}\n",
+            st->name, st->name);
+
+    fprintf(out, "\nstatic int %s_decoder_service(JParserIntf *super, JParserVal *v, int recLevel)\n{\n",
+            st->name);
+    fprintf(out, "    %s_decoder_t *o = (%s_decoder_t *)super;\n", st->name, st->name);
+    fprintf(out, "    %s_t *d = o->dest;\n", st->name);
+    fprintf(out, "    const char *name = v->memberName;\n");
+    fprintf(out, "    U32 bit;\n");
+    fprintf(out, "    (void)recLevel;\n");
+    fprintf(out, "    if (!o->inObject)\n    {\n"
+                 "        if (v->t != JParserT_BeginObject)\n"
+                 "            goto formatErr;\n"
+                 "        o->inObject = true;\n"
+                 "        o->received = 0;\n"
+                 "        o->status = JDecoderS_OK;\n"
+                 "        return 0;\n    }\n");
+    fprintf(out, "    if (v->t == JParserT_EndObject)\n    {\n"
+                 "        if (o->received != 0x%08lXUL)\n"
+                 "            return %s_decoder_fail(o, JDecoderS_Overflow);\n"
+                 "        o->inObject = false;\n"
+                 "        return 0;\n    }\n",
+            all, st->name);
+
+    /* Dispatch on the first character, then compare the full name */
+    for (i = 0; i < st->count; i++)
+        sorted[i] = &st->fields[i];
+    qsort(sorted, st->count, sizeof(sorted[0]), compare_fields);
+    fprintf(out, "    switch (name[0])\n    {\n");
+    for (i = 0; i < st->count;)
+    {
+        char first = sorted[i]->name[0];
+        fprintf(out, "    case '%c':\n", first);
+        for (bool firstInCase = true; i < st->count && sorted[i]->name[0] == first; i++)
+        {
+            field_t *f = sorted[i];
+            fprintf(out, "        %sif (!strcmp(name, \"%s\"))\n        {\n",
+                    firstInCase ? "" : "else ", f->name);
+            firstInCase = false;
+            write_field_decoder(out, st, f);
+            fprintf(out, "        }\n");
+        }
+        fprintf(out, "        else\n            goto nameNotFound;\n        break;\n");
+    }
+    fprintf(out, "    default:\n        goto nameNotFound;\n    }\n");
+    fprintf(out, "    if (o->received & bit) /* Duplicate member name */\n"
+                 "        goto nameNotFound;\n"
+                 "    o->received |= bit;\n"
+                 "    return 0;\n\n");
+    fprintf(out, "nameNotFound:\n"
+                 "    return %s_decoder_fail(o, JDecoderS_NameNotFound);\n"
+                 "formatErr:\n"
+                 "    return %s_decoder_fail(o, JDecoderS_FormatErr);\n}\n",
+            st->name, st->name);
+
+    fprintf(out, "\nvoid %s_decoder_constructor(%s_decoder_t *o, %s_t *dest)\n{\n"
+                 "    JParserIntf_constructor((JParserIntf *)o, %s_decoder_service);\n"
+                 "    o->dest = dest;\n"
+                 "    o->received = 0;\n"
+                 "    o->status = JDecoderS_OK;\n"
+                 "    o->inObject = false;\n}\n",
+            st->name, st->name, st->name, st->name);
+}
+
+static void write_encoder(FILE *out, struct_t *st)
+{
+    fprintf(out, "\nint %s_encode(BufPrint *out, const %s_t *v)\n{\n", st->name, st->name);
+    for (int i = 0; i < st->count; i++)
+    {
+        field_t *f = &st->fields[i];
+        /* Member name and separators are emitted as one literal */
+        fprintf(out, "    %sBufPrint_write(out, \"%c\\\"%s\\\":\", %d) < 0 ||\n",
+                i ? "    " : "if (", i ? ',' : '{', f->name, (int)strlen(f->name) + 4);
+        switch (f->type)
+        {
+        case F_BOOL:
+            fprintf(out, "        BufPrint_write(out, v->%s ? \"true\" : \"false\", v->%s ? 4 : 5) < 0 ||\n",
+                    f->name, f->name);
+            break;
+        case F_INT:
+        case F_LONG:
+            fprintf(out, "        BufPrint_fmtInt(out, v->%s, 0) < 0 ||\n", f->name);
+            break;
+        case F_FLOAT:
+        case F_DOUBLE:
+            fprintf(out, "        BufPrint_fmtDouble(out, v->%s) < 0 ||\n", f->name);
+            break;
+        case F_STRING:
+            fprintf(out, "        BufPrint_jsonString(out, v->%s) < 0 ||\n", f->name);
+            break;
+        }
+    }
+    fprintf(out, "        BufPrint_putc(out, '}') < 0)\n"
+                 "    {\n        return -1;\n    }\n"
+                 "    return 0;\n}\n");
+}
+
+static void write_setter(FILE *out, struct_t *st)
+{
+    static const char *setters[] = {"Boolean", "Int", "Long", "Double", "Double", "String"};
+    fprintf(out, "\nint %s_set(JEncoder *e, const %s_t *v)\n{\n", st->name, st->name);
+    fprintf(out, "    JEncoder_beginObject(e);\n");
+    for (int i = 0; i < st->count; i++)
+    {
+        field_t *f = &st->fields[i];
+        fprintf(out, "    JEncoder_setName(e, \"%s\");\n", f->name);
+        fprintf(out, "    JEncoder_set%s(e, v->%s);\n", setters[f->type], f->name);
+    }
+    fprintf(out, "    JEncoder_endObject(e);\n"
+                 "    return JErr_isError(JEncoder_getErr(e)) ? -1 : 0;\n}\n");
+}
+
+static void write_template(FILE *out, struct_t *st)
+{
+    static const char *types[] = {"Boolean", "Int", "Long", "Double", "Double", "String"};
+    fprintf(out, "\nint %s_template(JTemplate *t)\n{\n", st->name);
+    fprintf(out, "    JEncoder *e = JTemplate_getEncoder(t);\n"
+                 "    JEncoder_beginObject(e);\n");
+    for (int i = 0; i < st->count; i++)
+    {
+        field_t *f = &st->fields[i];
+        /* Room for the unescaped string and the quotes */
+        int width = f->type == F_STRING ? (f->size + 1 > 255 ? 255 : f->size + 1) : 0;
+        fprintf(out, "    JEncoder_setName(e, \"%s\");\n", f->name);
+        fprintf(out, "    JTemplate_slot(t, JParserT_%s, %d);\n", types[f->type], width);
+    }
+    fprintf(out, "    JEncoder_endObject(e);\n"
+                 "    return JTemplate_end(t);\n}\n");
+
+    fprintf(out, "\nint %s_patch(JTemplate *t, const %s_t *v)\n{\n", st->name, st->name);
+    for (int i = 0; i < st->count; i++)
+    {
+        field_t *f = &st->fields[i];
+        fprintf(out, "    %sJTemplate_set%s(t, %d, v->%s)%s\n", i ? "    " : "if (",
+                types[f->type], i, f->name, i + 1 < st->count ? " ||" : ")");
+    }
+    fprintf(out, "    {\n        return -1;\n    }\n"
+                 "    return 0;\n}\n");
+}
+
+static void write_source(FILE *out, const char *schema, const char *header)
+{
+    fprintf(out, "/* Generated by tools/jsongen from %s. Do not edit. */\n\n", schema);
+    fprintf(out, "#include <string.h>\n");
+    fprintf(out, "#include \"%s\"\n", header);
+    for (int s = 0; s < struct_count; s++)
+    {
+        write_decoder(out, &structs[s]);
+        write_encoder(out, &structs[s]);
+        write_setter(out, &structs[s]);
+        write_template(out, &structs[s]);
+    }
+}
+
+static const char *base_name(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    const char *bslash = strrchr(path, '\\');
+    if (bslash > slash)
+        slash = bslash;
+    return slash ? slash + 1 : path;
+}
+
+int main(int ac, char *as[])
+{
+    if (ac != 3)
+    {
+        fprintf(stderr, "Usage: %s [schema file] [output base name]\n", as[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *in = NULL, *hout = NULL, *cout = NULL;
+    size_t base_len = strlen(as[2]);
+    char *hpath = malloc(base_len + 3), *cpath = malloc(base_len + 3);
+    char guard[MAX_LINE];
+    const char *hname;
+
+    sprintf(hpath, "%s.h", as[2]);
+    sprintf(cpath, "%s.c", as[2]);
+    hname = base_name(hpath);
+
+    if ((in = fopen(as[1], "r")) == NULL)
+    {
+        fprintf(stderr, "Could not open \"%s\" for reading!\n", as[1]);
+        goto fail;
+    }
+    if (parse_schema(as[1], in))
+        goto fail;
+    if (!struct_count)
+    {
+        fprintf(stderr, "%s: no structs declared\n", as[1]);
+        goto fail;
+    }
+
+    if ((hout = fopen(hpath, "w")) == NULL || (cout = fopen(cpath, "w")) == NULL)
+    {
+        fprintf(stderr, "Could not open \"%s\" for writing!\n", hout ? cpath : hpath);
+        goto fail;
+    }
+
+    snprintf(guard, sizeof(guard), "_%s", hname);
+    for (char *p = guard; *p; p++)
+        *p = isalnum((unsigned char)*p) ? (char)toupper((unsigned char)*p) : '_';
+
+    write_header(hout, base_name(as[1]), guard);
+    write_source(cout, base_name(as[1]), hname);
+
+    fclose(in);
+    fclose(hout);
+    fclose(cout);
+    free(hpath);
+    free(cpath);
+    return EXIT_SUCCESS;
+
+fail:
+    if (in)
+        fclose(in);
+    if (hout)
+        fclose(hout);
+    if (cout)
+        fclose(cout);
+    free(hpath);
+    free(cpath);
+    return EXIT_FAILURE;
+}
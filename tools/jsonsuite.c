@@ -0,0 +1,1595 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+#include "JParser.h"
+#include "JDecoder.h"
+#include "JEncoder.h"
+#include "JCVal.h"
+#include "JPathFilter.h"
+#include "CBORParser.h"
+#include "JTemplate.h"
+#include "JFramer.h"
+#include "iot_messages.h"
+
+/*
+ * Host benchmark suite for the JSON stack in lib/json.
+ *
+ * Runs a corpus of command and telemetry shaped payloads through
+ * JParser (copy and zero-copy), the JCVal DOM, JPathFilter, JDecoder, the generated
+ * message code, JEncoder and BufPrint, plus the CBOR encoder and
+ * CBORParser, JFramer, and reports throughput, time per
+ * message and peak allocator usage. Results can be saved as CSV and
+ * compared against a later run:
+ *
+ *   jsonsuite -c > baseline.csv
+ *   ... change the parser ...
+ *   jsonsuite -b baseline.csv
+ *
+ * Additional payloads can be added with -f file; each file holds one
+ * JSON message.
+ *
+ * A few self checks run first; -k runs only these, which is what
+ * ctest does.
+ */
+
+#define CHUNK_SIZE 256 /* Same as TCP_IN_OUT_BUF_SIZE */
+#define MAX_PAYLOAD 16384
+#define MAX_RESULTS 64
+#define DEEP_LEVELS 24
+
+static uint64_t min_runtime_ns = 200000000ULL;
+static bool csv_output = false;
+
+typedef struct
+{
+    char name[48];
+    size_t bytes;
+    double msgs_per_sec;
+    double mb_per_sec;
+    double ns_per_msg;
+    size_t peak_bytes;
+    double allocs_per_msg;
+} result_t;
+
+static result_t baseline[MAX_RESULTS];
+static int baseline_count = 0;
+
+/* --------------------------------------------------------------------------
+ * Allocator tracking current and peak usage.
+ * ------------------------------------------------------------------------*/
+
+typedef struct
+{
+    AllocatorIntf super;
+    size_t current;
+    size_t peak;
+    unsigned long allocs;
+} tracking_alloc_t;
+
+typedef union
+{
+    size_t size;
+    max_align_t align;
+} alloc_header_t;
+
+static void tracking_alloc_add(tracking_alloc_t *o, size_t size)
+{
+    o->current += size;
+    if (o->current > o->peak)
+        o->peak = o->current;
+}
+
+static void *tracking_alloc_malloc(AllocatorIntf *super, size_t *size)
+{
+    tracking_alloc_t *o = (tracking_alloc_t *)super;
+    alloc_header_t *h = malloc(sizeof(alloc_header_t) + *size);
+    if (!h)
+        return NULL;
+    h->size = *size;
+    o->allocs++;
+    tracking_alloc_add(o, *size);
+    return h + 1;
+}
+
+static void *tracking_alloc_realloc(AllocatorIntf *super, void *p, size_t *size)
+{
+    tracking_alloc_t *o = (tracking_alloc_t *)super;
+    alloc_header_t *h;
+    size_t old_size;
+    if (!p)
+        return tracking_alloc_malloc(super, size);
+    h = (alloc_header_t *)p - 1;
+    old_size = h->size;
+    h = realloc(h, sizeof(alloc_header_t) + *size);
+    if (!h)
+        return NULL;
+    h->size = *size;
+    o->allocs++;
+    o->current -= old_size;
+    tracking_alloc_add(o, *size);
+    return h + 1;
+}
+
+static void tracking_alloc_free(AllocatorIntf *super, void *p)
+{
+    tracking_alloc_t *o = (tracking_alloc_t *)super;
+    alloc_header_t *h;
+    if (!p)
+        return;
+    h = (alloc_header_t *)p - 1;
+    o->current -= h->size;
+    free(h);
+}
+
+static void tracking_alloc_constructor(tracking_alloc_t *o)
+{
+    AllocatorIntf_constructor(&o->super, tracking_alloc_malloc, tracking_alloc_realloc,
+                              tracking_alloc_free);
+    o->current = o->peak = 0;
+    o->allocs = 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Corpus
+ * ------------------------------------------------------------------------*/
+
+typedef struct
+{
+    const char *name;
+    char *data;
+    size_t size;
+} payload_t;
+
+static payload_t corpus[MAX_RESULTS];
+static int corpus_count = 0;
+
+static char *payload_alloc(void)
+{
+    char *buf = malloc(MAX_PAYLOAD);
+    if (!buf)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return buf;
+}
+
+static void corpus_add(const char *name, char *data, size_t size)
+{
+    if (corpus_count == MAX_RESULTS || size >= MAX_PAYLOAD)
+    {
+        fprintf(stderr, "Cannot add payload %s\n", name);
+        exit(EXIT_FAILURE);
+    }
+    corpus[corpus_count].name = name;
+    corpus[corpus_count].data = data;
+    corpus[corpus_count].size = size;
+    corpus_count++;
+}
+
+/* Command packet as sent by the servers today */
+static size_t make_command(char *buf, size_t size)
+{
+    return snprintf(buf, size, "{\"led\":true}");
+}
+
+/* Device status report with a nested object and a small array */
+static size_t make_telemetry(char *buf, size_t size)
+{
+    return snprintf(buf, size,
+                    "{\"device\":\"picow-3a1f\",\"uptime\":123456,\"timestamp\":1700000000123,"
+                    "\"led\":true,\"temperature\":21.53,\"humidity\":40.25,\"rssi\":-67,"
+                    "\"vsys\":4.98,\"heap\":{\"free\":81234,\"min\":60211},"
+                    "\"tasks\":[{\"name\":\"main\",\"stack\":312},{\"name\":\"tcp\",\"stack\":188},"
+                    "{\"name\":\"oled\",\"stack\":402}]}");
+}
+
+/* Flat object with many members of mixed type */
+static size_t make_wide(char *buf, size_t size)
+{
+    size_t len = snprintf(buf, size, "{");
+    for (int i = 0; i < 64; i++)
+    {
+        const char *sep = i ? "," : "";
+        switch (i % 4)
+        {
+        case 0:
+            len += snprintf(buf + len, size - len, "%s\"member%02d\":%d", sep, i, i * 1013);
+            break;
+        case 1:
+            len += snprintf(buf + len, size - len, "%s\"member%02d\":%s", sep, i,
+                            i & 2 ? "true" : "false");
+            break;
+        case 2:
+            len += snprintf(buf + len, size - len, "%s\"member%02d\":\"value %d\"", sep, i, i);
+            break;
+        default:
+            len += snprintf(buf + len, size - len, "%s\"member%02d\":null", sep, i);
+        }
+    }
+    len += snprintf(buf + len, size - len, "}");
+    return len;
+}
+
+/* Nested objects and arrays, DEEP_LEVELS levels */
+static size_t make_deep(char *buf, size_t size)
+{
+    size_t len = 0;
+    for (int i = 0; i < DEEP_LEVELS; i++)
+        len += snprintf(buf + len, size - len, i & 1 ? "[%d," : "{\"level\":%d,\"child\":", i);
+    len += snprintf(buf + len, size - len, "\"leaf\"");
+    for (int i = DEEP_LEVELS - 1; i >= 0; i--)
+        len += snprintf(buf + len, size - len, i & 1 ? "]" : "}");
+    return len;
+}
+
+/* Long strings with escape sequences and non-ASCII characters */
+static size_t make_strings(char *buf, size_t size)
+{
+    size_t len = snprintf(buf, size, "{");
+    for (int i = 0; i < 8; i++)
+    {
+        len += snprintf(buf + len, size - len,
+                        "%s\"text%d\":\"Sensor %d reported \\\"ok\\\" at the east wall.\\n"
+                        "Caf\\u00e9 temperature 21\\u00b0C \\ud83d\\ude00 path C:\\\\data\\/log, "
+                        "then continued with a fairly long plain ASCII sentence to fill the line.\"",
+                        i ? "," : "", i, i);
+    }
+    len += snprintf(buf + len, size - len, "}");
+    return len;
+}
+
+/* Array of integers and doubles in various notations */
+static size_t make_numbers(char *buf, size_t size)
+{
+    static const char *const values[] = {
+        "21.537", "-0.000123", "6.02214076e23", "123456789", "-42", "0", "3.141592653589793",
+        "1e-7", "4294967296", "-9223372036854775807", "0.1", "2.5E+3", "1700000000123",
+        "-17.25", "65535", "1.7976931348623157e308"};
+    size_t len = snprintf(buf, size, "{\"samples\":[");
+    for (int i = 0; i < 128; i++)
+        len += snprintf(buf + len, size - len, "%s%s", i ? "," : "", values[i % 16]);
+    len += snprintf(buf + len, size - len, "]}");
+    return len;
+}
+
+static int load_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    char *buf;
+    size_t size;
+    if (!f)
+    {
+        fprintf(stderr, "Could not open \"%s\" for reading!\n", path);
+        return -1;
+    }
+    buf = payload_alloc();
+    size = fread(buf, 1, MAX_PAYLOAD, f);
+    fclose(f);
+    if (size == MAX_PAYLOAD)
+    {
+        fprintf(stderr, "%s: larger than %d bytes\n", path, MAX_PAYLOAD - 1);
+        return -1;
+    }
+    buf[size] = 0;
+    corpus_add(path, buf, size);
+    return 0;
+}
+
+static void make_corpus(void)
+{
+    static const struct
+    {
+        const char *name;
+        size_t (*make)(char *buf, size_t size);
+    } builtins[] = {
+        {"command", make_command}, {"telemetry", make_telemetry}, {"wide", make_wide},
+        {"deep", make_deep}, {"strings", make_strings}, {"numbers", make_numbers}};
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++)
+    {
+        char *buf = payload_alloc();
+        corpus_add(builtins[i].name, buf, builtins[i].make(buf, MAX_PAYLOAD));
+    }
+}
+
+/* --------------------------------------------------------------------------
+ * Reporting
+ * ------------------------------------------------------------------------*/
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int load_baseline(const char *path)
+{
+    char line[256];
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        fprintf(stderr, "Could not open \"%s\" for reading!\n", path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f) && baseline_count < MAX_RESULTS)
+    {
+        result_t *r = &baseline[baseline_count];
+        if (sscanf(line, "%47[^,],%zu,%lf,%lf,%lf,%zu,%lf", r->name, &r->bytes, &r->msgs_per_sec,
+                   &r->mb_per_sec, &r->ns_per_msg, &r->peak_bytes, &r->allocs_per_msg) == 7)
+        {
+            baseline_count++;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static const result_t *find_baseline(const char *name)
+{
+    for (int i = 0; i < baseline_count; i++)
+    {
+        if (!strcmp(baseline[i].name, name))
+            return &baseline[i];
+    }
+    return NULL;
+}
+
+static void print_header(void)
+{
+    if (csv_output)
+        printf("name,bytes,msg_per_s,mb_per_s,ns_per_msg,peak_bytes,allocs_per_msg\n");
+    else
+        printf("%-26s %6s %11s %9s %10s %8s %7s%s\n", "benchmark", "bytes", "msg/s", "MB/s",
+               "ns/msg", "peak B", "allocs", baseline_count ? "  vs baseline" : "");
+}
+
+static void report(const char *name, size_t bytes, unsigned long iterations, uint64_t elapsed,
+                   const tracking_alloc_t *alloc)
+{
+    double seconds = (double)elapsed / 1e9;
+    result_t r;
+    const result_t *base;
+
+    snprintf(r.name, sizeof(r.name), "%s", name);
+    r.bytes = bytes;
+    r.msgs_per_sec = iterations / seconds;
+    r.mb_per_sec = (double)bytes * iterations / seconds / 1e6;
+    r.ns_per_msg = (double)elapsed / iterations;
+    r.peak_bytes = alloc ? alloc->peak : 0;
+    r.allocs_per_msg = alloc ? (double)alloc->allocs / iterations : 0;
+
+    if (csv_output)
+    {
+        printf("%s,%zu,%.0f,%.3f,%.2f,%zu,%.3f\n", r.name, r.bytes, r.msgs_per_sec,
+               r.mb_per_sec, r.ns_per_msg, r.peak_bytes, r.allocs_per_msg);
+        return;
+    }
+    printf("%-26s %6zu %11.0f %9.2f %10.1f %8zu %7.2f", r.name, r.bytes, r.msgs_per_sec,
+           r.mb_per_sec, r.ns_per_msg, r.peak_bytes, r.allocs_per_msg);
+    if ((base = find_baseline(name)) != NULL)
+        printf("  %+6.1f%% time", (r.ns_per_msg - base->ns_per_msg) * 100.0 / base->ns_per_msg);
+    printf("\n");
+}
+
+/* --------------------------------------------------------------------------
+ * Parser benchmarks
+ * ------------------------------------------------------------------------*/
+
+typedef struct
+{
+    JParserIntf super;
+    unsigned long values;
+} counting_intf_t;
+
+static int counting_intf_service(JParserIntf *super, JParserVal *v, int recLevel)
+{
+    (void)v;
+    (void)recLevel;
+    ((counting_intf_t *)super)->values++;
+    return 0;
+}
+
+/* Each chunk is copied to the same buffer before it is parsed, as
+   TCP_manage receives it, so zero copy mode cannot rely on an earlier
+   chunk staying in place.
+ */
+static U8 recv_buf[CHUNK_SIZE];
+
+static int parse_message(JParser *parser, const U8 *data, size_t size)
+{
+    int status = 0;
+    for (size_t off = 0; off < size; off += CHUNK_SIZE)
+    {
+        size_t n = size - off < CHUNK_SIZE ? size - off : CHUNK_SIZE;
+        memcpy(recv_buf, data + off, n);
+        status = JParser_parse(parser, recv_buf, (U32)n);
+        if (status < 0)
+            return status;
+    }
+    return status;
+}
+
+/* Run 'intf' over 'p' until min_runtime_ns has elapsed. The JParser is
+   allocated with room for DEEP_LEVELS extra stack entries and uses
+   'alloc', which may be shared with 'intf'.
+ */
+static int bench_parse(const char *name, const payload_t *p, JParserIntf *intf, bool zeroCopy,
+                       void (*reset)(JParserIntf *intf), tracking_alloc_t *alloc)
+{
+    char memberName[64];
+    JParser *parser;
+    unsigned long iterations = 0;
+    uint64_t start, elapsed;
+
+    parser = malloc(sizeof(JParser) + DEEP_LEVELS * sizeof(JParserStackNode));
+    if (!parser)
+        return -1;
+    JParser_constructor(parser, intf, memberName, sizeof(memberName), &alloc->super,
+                        DEEP_LEVELS);
+    JParser_setZeroCopy(parser, zeroCopy);
+
+    start = now_ns();
+    do
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            if (reset)
+                reset(intf);
+            if (parse_message(parser, (const U8 *)p->data, p->size) <= 0)
+            {
+                fprintf(stderr, "%s: parse failed: %d\n", name, JParser_getStatus(parser));
+                JParser_destructor(parser);
+                free(parser);
+                return -1;
+            }
+        }
+        iterations += 100;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_runtime_ns);
+
+    report(name, p->size, iterations, elapsed, alloc);
+    JParser_destructor(parser);
+    free(parser);
+    return 0;
+}
+
+static int bench_parser(void)
+{
+    char name[64];
+    for (int i = 0; i < corpus_count; i++)
+    {
+        for (int zeroCopy = 0; zeroCopy < 2; zeroCopy++)
+        {
+            counting_intf_t intf;
+            tracking_alloc_t alloc;
+            tracking_alloc_constructor(&alloc);
+            JParserIntf_constructor((JParserIntf *)&intf, counting_intf_service);
+            intf.values = 0;
+            snprintf(name, sizeof(name), "parse %s %s", corpus[i].name,
+                     zeroCopy ? "zerocopy" : "copy");
+            if (bench_parse(name, &corpus[i], (JParserIntf *)&intf, zeroCopy, NULL, &alloc))
+                return -1;
+        }
+    }
+    return 0;
+}
+
+/* Select one member with JPathFilter; everything else is skipped by the
+   lexer. Compare with "parse <name> zerocopy".
+ */
+static int bench_filter(void)
+{
+    static const char *const paths[] = {"/led"};
+    char name[64];
+    for (int i = 0; i < corpus_count; i++)
+    {
+        counting_intf_t intf;
+        JPathFilter filter;
+        tracking_alloc_t alloc;
+        tracking_alloc_constructor(&alloc);
+        JParserIntf_constructor((JParserIntf *)&intf, counting_intf_service);
+        intf.values = 0;
+        JPathFilter_constructor(&filter, (JParserIntf *)&intf, paths, 1);
+        snprintf(name, sizeof(name), "filter %s", corpus[i].name);
+        if (bench_parse(name, &corpus[i], (JParserIntf *)&filter, true, NULL, &alloc))
+            return -1;
+    }
+    return 0;
+}
+
+/* Build a JCVal tree per message. Peak usage includes the tree buffer. */
+static int bench_dom(void)
+{
+    char name[64];
+    for (int i = 0; i < corpus_count; i++)
+    {
+        JParserCValFact fact;
+        tracking_alloc_t alloc;
+        int status;
+        tracking_alloc_constructor(&alloc);
+        JParserCValFact_constructor(&fact, &alloc.super);
+        snprintf(name, sizeof(name), "dom %s", corpus[i].name);
+        status = bench_parse(name, &corpus[i], (JParserIntf *)&fact, true, NULL, &alloc);
+        if (!status && !JParserCValFact_getFirstVal(&fact))
+            status = -1;
+        JParserCValFact_destructor(&fact);
+        if (status)
+            return -1;
+    }
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Decoder benchmarks, command packet
+ * ------------------------------------------------------------------------*/
+
+static void jdecoder_reset(JParserIntf *intf)
+{
+    JDecoder_reset((JDecoder *)intf);
+}
+
+static int bench_decoder(void)
+{
+    static uintptr_t planBuf[16];
+    payload_t p;
+    iot_command_packet_t packet;
+    iot_command_packet_decoder_t decoder;
+    JDecoder jdecoder;
+    tracking_alloc_t alloc;
+    char buf[64];
+
+    p.name = "command";
+    p.data = buf;
+    p.size = make_command(buf, sizeof(buf));
+
+    tracking_alloc_constructor(&alloc);
+    packet.led = false;
+    JDecoder_constructor(&jdecoder, (U8 *)planBuf, sizeof(planBuf), 0);
+    if (JDecoder_get(&jdecoder, "{b}", JD_MNUM(&packet, led)))
+    {
+        fprintf(stderr, "JDecoder_get failed\n");
+        return -1;
+    }
+    if (bench_parse("decode command jdecoder", &p, (JParserIntf *)&jdecoder, true,
+                    jdecoder_reset, &alloc) ||
+        !packet.led)
+    {
+        return -1;
+    }
+
+    tracking_alloc_constructor(&alloc);
+    packet.led = false;
+    iot_command_packet_decoder_constructor(&decoder, &packet);
+    if (bench_parse("decode command generated", &p, (JParserIntf *)&decoder, true, NULL,
+                    &alloc) ||
+        decoder.status != JDecoderS_OK || !packet.led)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Encoder benchmarks
+ * ------------------------------------------------------------------------*/
+
+static size_t encoded_size;
+
+static int counting_flush(BufPrint *o, int sizeRequired)
+{
+    (void)sizeRequired;
+    encoded_size += o->cursor;
+    o->cursor = 0;
+    return 0;
+}
+
+static int counting_writev(BufPrint *o, const BufPrintSeg *seg, int segLen)
+{
+    (void)o;
+    for (int i = 0; i < segLen; i++)
+        encoded_size += seg[i].len;
+    return 0;
+}
+
+static int encode_telemetry(JEncoder *e)
+{
+    static const char *const tasks[] = {"main", "tcp", "oled"};
+    static const int stacks[] = {312, 188, 402};
+    JEncoder_beginObject(e);
+    JEncoder_setName(e, "device");
+    JEncoder_setString(e, "picow-3a1f");
+    JEncoder_setName(e, "uptime");
+    JEncoder_setInt(e, 123456);
+    JEncoder_setName(e, "timestamp");
+    JEncoder_setLong(e, 1700000000123LL);
+    JEncoder_setName(e, "led");
+    JEncoder_setBoolean(e, TRUE);
+    JEncoder_setName(e, "temperature");
+    JEncoder_setDouble(e, 21.53);
+    JEncoder_setName(e, "humidity");
+    JEncoder_setDouble(e, 40.25);
+    JEncoder_setName(e, "rssi");
+    JEncoder_setInt(e, -67);
+    JEncoder_setName(e, "vsys");
+    JEncoder_setDouble(e, 4.98);
+    JEncoder_setName(e, "heap");
+    JEncoder_beginObject(e);
+    JEncoder_setName(e, "free");
+    JEncoder_setInt(e, 81234);
+    JEncoder_setName(e, "min");
+    JEncoder_setInt(e, 60211);
+    JEncoder_endObject(e);
+    JEncoder_setName(e, "tasks");
+    JEncoder_beginArray(e);
+    for (int i = 0; i < 3; i++)
+    {
+        JEncoder_beginObject(e);
+        JEncoder_setName(e, "name");
+        JEncoder_setString(e, tasks[i]);
+        JEncoder_setName(e, "stack");
+        JEncoder_setInt(e, stacks[i]);
+        JEncoder_endObject(e);
+    }
+    JEncoder_endArray(e);
+    JEncoder_endObject(e);
+    return JEncoder_commit(e);
+}
+
+static int encode_strings(JEncoder *e)
+{
+    char name[8];
+    JEncoder_beginObject(e);
+    for (int i = 0; i < 8; i++)
+    {
+        snprintf(name, sizeof(name), "text%d", i);
+        JEncoder_setName(e, name);
+        JEncoder_setString(e, "Sensor reported \"ok\" at the east wall.\n"
+                              "Caf\xc3\xa9 temperature 21\xc2\xb0" "C \xf0\x9f\x98\x80 path C:\\data/log, "
+                              "then continued with a fairly long plain ASCII sentence to fill the line.");
+    }
+    JEncoder_endObject(e);
+    return JEncoder_commit(e);
+}
+
+static int encode_numbers(JEncoder *e)
+{
+    static const double values[] = {21.537, -0.000123, 6.02214076e23, 123456789, -42, 0,
+                                    3.141592653589793, 1e-7, 4294967296.0, 0.1, 2.5e3,
+                                    1700000000123.0, -17.25, 65535, 1.7976931348623157e308,
+                                    -273.15};
+    JEncoder_beginObject(e);
+    JEncoder_setName(e, "samples");
+    JEncoder_beginArray(e);
+    for (int i = 0; i < 128; i++)
+        JEncoder_setDouble(e, values[i % 16]);
+    JEncoder_endArray(e);
+    JEncoder_endObject(e);
+    return JEncoder_commit(e);
+}
+
+/* A log dump: one large string of 80 character lines */
+static int encode_log(JEncoder *e)
+{
+    static char log[4096];
+    if (!log[0])
+    {
+        for (size_t i = 0; i < sizeof(log) - 1; i++)
+            log[i] = i % 81 == 80 ? '\n' : (char)('a' + i % 26);
+    }
+    JEncoder_beginObject(e);
+    JEncoder_setName(e, "log");
+    JEncoder_setString(e, log);
+    JEncoder_endObject(e);
+    return JEncoder_commit(e);
+}
+
+static int encode_telemetry_generated(JEncoder *e)
+{
+    static const iot_telemetry_t telemetry = {true};
+    return iot_telemetry_encode(JEncoder_getBufPrint(e), &telemetry) ||
+           BufPrint_flush(JEncoder_getBufPrint(e));
+}
+
+static int bench_encode(const char *name, int (*encode)(JEncoder *e), bool cbor, bool writev)
+{
+    char buf[512];
+    BufPrint out;
+    JErr err;
+    JEncoder encoder;
+    unsigned long iterations = 0;
+    uint64_t start, elapsed;
+    size_t size;
+
+    BufPrint_constructor2(&out, buf, sizeof(buf), 0, counting_flush);
+    if (writev)
+        BufPrint_setWriteV(&out, counting_writev);
+    JErr_constructor(&err);
+    JEncoder_constructor(&encoder, &err, &out);
+    JEncoder_setCBOR(&encoder, cbor);
+
+    encoded_size = 0;
+    if (encode(&encoder))
+    {
+        fprintf(stderr, "%s: encode failed\n", name);
+        return -1;
+    }
+    size = encoded_size;
+
+    start = now_ns();
+    do
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            if (encode(&encoder))
+            {
+                fprintf(stderr, "%s: encode failed\n", name);
+                return -1;
+            }
+        }
+        iterations += 100;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_runtime_ns);
+
+    report(name, size, iterations, elapsed, NULL);
+    return 0;
+}
+
+/* encode_telemetry with a slot for every number and boolean */
+static int telemetry_template(JTemplate *t)
+{
+    static const char *const tasks[] = {"main", "tcp", "oled"};
+    JEncoder *e = JTemplate_getEncoder(t);
+    JEncoder_beginObject(e);
+    JEncoder_setName(e, "device");
+    JEncoder_setString(e, "picow-3a1f");
+    JEncoder_setName(e, "uptime");
+    JTemplate_slot(t, JParserT_Int, 0);
+    JEncoder_setName(e, "timestamp");
+    JTemplate_slot(t, JParserT_Long, 0);
+    JEncoder_setName(e, "led");
+    JTemplate_slot(t, JParserT_Boolean, 0);
+    JEncoder_setName(e, "temperature");
+    JTemplate_slot(t, JParserT_Double, 0);
+    JEncoder_setName(e, "humidity");
+    JTemplate_slot(t, JParserT_Double, 0);
+    JEncoder_setName(e, "rssi");
+    JTemplate_slot(t, JParserT_Int, 0);
+    JEncoder_setName(e, "vsys");
+    JTemplate_slot(t, JParserT_Double, 0);
+    JEncoder_setName(e, "heap");
+    JEncoder_beginObject(e);
+    JEncoder_setName(e, "free");
+    JTemplate_slot(t, JParserT_Int, 0);
+    JEncoder_setName(e, "min");
+    JTemplate_slot(t, JParserT_Int, 0);
+    JEncoder_endObject(e);
+    JEncoder_setName(e, "tasks");
+    JEncoder_beginArray(e);
+    for (int i = 0; i < 3; i++)
+    {
+        JEncoder_beginObject(e);
+        JEncoder_setName(e, "name");
+        JEncoder_setString(e, tasks[i]);
+        JEncoder_setName(e, "stack");
+        JTemplate_slot(t, JParserT_Int, 0);
+        JEncoder_endObject(e);
+    }
+    JEncoder_endArray(e);
+    JEncoder_endObject(e);
+    return JTemplate_end(t);
+}
+
+static int patch_telemetry(JTemplate *t)
+{
+    static const int stacks[] = {312, 188, 402};
+    if (JTemplate_setInt(t, 0, 123456) ||
+        JTemplate_setLong(t, 1, 1700000000123LL) ||
+        JTemplate_setBoolean(t, 2, TRUE) ||
+        JTemplate_setDouble(t, 3, 21.53) ||
+        JTemplate_setDouble(t, 4, 40.25) ||
+        JTemplate_setInt(t, 5, -67) ||
+        JTemplate_setDouble(t, 6, 4.98) ||
+        JTemplate_setInt(t, 7, 81234) ||
+        JTemplate_setInt(t, 8, 60211))
+    {
+        return -1;
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        if (JTemplate_setInt(t, 9 + i, stacks[i]))
+            return -1;
+    }
+    /* Stands in for handing the buffer to the socket */
+    encoded_size += JTemplate_getLen(t);
+    return 0;
+}
+
+static int bench_template(const char *name, bool cbor)
+{
+    char buf[512];
+    JTemplate t;
+    unsigned long iterations = 0;
+    uint64_t start, elapsed;
+
+    JTemplate_constructor(&t, buf, sizeof(buf), cbor);
+    if (telemetry_template(&t) || patch_telemetry(&t))
+    {
+        fprintf(stderr, "%s: template failed\n", name);
+        return -1;
+    }
+
+    start = now_ns();
+    do
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            if (patch_telemetry(&t))
+            {
+                fprintf(stderr, "%s: patch failed\n", name);
+                return -1;
+            }
+        }
+        iterations += 100;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_runtime_ns);
+
+    report(name, JTemplate_getLen(&t), iterations, elapsed, NULL);
+    return 0;
+}
+
+static int bench_encoder(void)
+{
+    return bench_encode("encode telemetry", encode_telemetry, false, false) ||
+           bench_encode("encode iot_telemetry generated", encode_telemetry_generated, false, false) ||
+           bench_encode("encode strings", encode_strings, false, false) ||
+           bench_encode("encode numbers", encode_numbers, false, false) ||
+           bench_encode("encode telemetry cbor", encode_telemetry, true, false) ||
+           bench_encode("encode strings cbor", encode_strings, true, false) ||
+           bench_encode("encode numbers cbor", encode_numbers, true, false) ||
+           bench_encode("encode log", encode_log, false, false) ||
+           bench_encode("encode log writev", encode_log, false, true) ||
+           bench_encode("encode log cbor", encode_log, true, false) ||
+           bench_encode("encode log cbor writev", encode_log, true, true) ||
+           bench_template("encode telemetry template", false) ||
+           bench_template("encode telemetry template cbor", true);
+}
+
+/* --------------------------------------------------------------------------
+ * CBOR parser benchmarks
+ * ------------------------------------------------------------------------*/
+
+static char captured[MAX_PAYLOAD];
+
+static int capture_flush(BufPrint *o, int sizeRequired)
+{
+    (void)sizeRequired;
+    if (encoded_size + o->cursor > sizeof(captured))
+        return -1;
+    memcpy(captured + encoded_size, o->buf, o->cursor);
+    encoded_size += o->cursor;
+    o->cursor = 0;
+    return 0;
+}
+
+/* Parse the CBOR encoding of 'encode' in CHUNK_SIZE chunks. The size
+   column shows the CBOR message size; compare time per message with
+   the JSON "parse <name> zerocopy" results.
+ */
+static int bench_cbor_parse(const char *name, int (*encode)(JEncoder *e))
+{
+    char buf[512];
+    char memberName[64];
+    BufPrint out;
+    JErr err;
+    JEncoder encoder;
+    CBORParser parser;
+    counting_intf_t intf;
+    tracking_alloc_t alloc;
+    unsigned long iterations = 0;
+    uint64_t start, elapsed;
+    int status = 0;
+
+    BufPrint_constructor2(&out, buf, sizeof(buf), 0, capture_flush);
+    JErr_constructor(&err);
+    JEncoder_constructor(&encoder, &err, &out);
+    JEncoder_setCBOR(&encoder, true);
+    encoded_size = 0;
+    if (encode(&encoder))
+    {
+        fprintf(stderr, "%s: encode failed\n", name);
+        return -1;
+    }
+
+    tracking_alloc_constructor(&alloc);
+    JParserIntf_constructor((JParserIntf *)&intf, counting_intf_service);
+    intf.values = 0;
+    CBORParser_constructor(&parser, (JParserIntf *)&intf, memberName, sizeof(memberName),
+                           &alloc.super, 0);
+    CBORParser_setZeroCopy(&parser, true);
+
+    start = now_ns();
+    do
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            for (size_t off = 0; off < encoded_size; off += CHUNK_SIZE)
+            {
+                size_t n = encoded_size - off < CHUNK_SIZE ? encoded_size - off : CHUNK_SIZE;
+                status = CBORParser_parse(&parser, (const U8 *)captured + off, (U32)n);
+                if (status < 0)
+                    break;
+            }
+            if (status <= 0)
+            {
+                fprintf(stderr, "%s: parse failed: %d\n", name, CBORParser_getStatus(&parser));
+                CBORParser_destructor(&parser);
+                return -1;
+            }
+        }
+        iterations += 100;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_runtime_ns);
+
+    report(name, encoded_size, iterations, elapsed, &alloc);
+    CBORParser_destructor(&parser);
+    return 0;
+}
+
+static int bench_cbor(void)
+{
+    return bench_cbor_parse("parse cbor telemetry", encode_telemetry) ||
+           bench_cbor_parse("parse cbor strings", encode_strings) ||
+           bench_cbor_parse("parse cbor numbers", encode_numbers);
+}
+
+/* --------------------------------------------------------------------------
+ * Base64 benchmarks
+ * ------------------------------------------------------------------------*/
+
+#define B64_DATA_SIZE 3072
+
+static int bench_b64(void)
+{
+    static U8 data[B64_DATA_SIZE], decoded[B64_DATA_SIZE];
+    char buf[512];
+    BufPrint out;
+    B64Decoder decoder;
+    unsigned long iterations = 0;
+    uint64_t start, elapsed;
+    size_t text_size;
+    int len;
+
+    for (int i = 0; i < B64_DATA_SIZE; i++)
+        data[i] = (U8)(i * 7 + (i >> 5));
+
+    /* Encode into a 512 byte buffer, as JEncoder::b64enc does */
+    BufPrint_constructor2(&out, buf, sizeof(buf), 0, counting_flush);
+    start = now_ns();
+    do
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            encoded_size = 0;
+            if (BufPrint_b64Encode(&out, data, B64_DATA_SIZE) || BufPrint_flush(&out))
+            {
+                fprintf(stderr, "b64 encode failed\n");
+                return -1;
+            }
+        }
+        iterations += 100;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_runtime_ns);
+    report("b64 encode 3k", B64_DATA_SIZE, iterations, elapsed, NULL);
+
+    /* Decode the text in CHUNK_SIZE pieces, as received from the socket */
+    BufPrint_constructor2(&out, captured, sizeof(captured), 0, NULL);
+    BufPrint_b64Encode(&out, data, B64_DATA_SIZE);
+    text_size = out.cursor;
+    B64Decoder_constructor(&decoder);
+    iterations = 0;
+    start = now_ns();
+    do
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            U8 *d = decoded;
+            for (size_t off = 0; off < text_size; off += CHUNK_SIZE)
+            {
+                size_t n = text_size - off < CHUNK_SIZE ? text_size - off : CHUNK_SIZE;
+                if ((len = B64Decoder_decode(&decoder, captured + off, (int)n, d)) < 0)
+                    break;
+                d += len;
+            }
+            if (len < 0 || B64Decoder_end(&decoder, d) < 0 ||
+                memcmp(decoded, data, B64_DATA_SIZE))
+            {
+                fprintf(stderr, "b64 decode failed\n");
+                return -1;
+            }
+        }
+        iterations += 100;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_runtime_ns);
+    report("b64 decode 3k", text_size, iterations, elapsed, NULL);
+    return 0;
+}
+
+/* --------------------------------------------------------------------------
+ * Framing benchmarks, a burst of commands received in CHUNK_SIZE pieces
+ * ------------------------------------------------------------------------*/
+
+#define FRAME_MSGS 64
+#define FRAME_BUF_SIZE 128 /* Same as TCP_MAX_FRAME_SIZE */
+#define FLOOD_SIZE 1024
+
+static U8 frame_stream[FRAME_MSGS * (FLOOD_SIZE + 32)];
+
+/* Commands without framing (0), newline delimited (1), or length
+   prefixed (2). Every fourth command is preceded by an unwanted
+   FLOOD_SIZE message if 'flood' is set.
+ */
+static size_t make_stream(int framing, bool flood)
+{
+    char msg[FLOOD_SIZE];
+    size_t size = 0;
+    for (int i = 0; i < FRAME_MSGS; i++)
+    {
+        for (int m = flood && i % 4 == 0 ? 0 : 1; m < 2; m++)
+        {
+            int len;
+            if (m == 0)
+            {
+                len = snprintf(msg, sizeof(msg), "{\"log\":\"");
+                memset(msg + len, 'x', FLOOD_SIZE - len - 2);
+                memcpy(msg + FLOOD_SIZE - 2, "\"}", 2);
+                len = FLOOD_SIZE;
+            }
+            else
+                len = (int)make_command(msg, sizeof(msg));
+            if (framing == 2)
+            {
+                JFramer_setHeader(frame_stream + size, len);
+                size += JFRAMER_HDR_SIZE;
+            }
+            memcpy(frame_stream + size, msg, len);
+            size += len;
+            if (framing == 1)
+                frame_stream[size++] = '\n';
+        }
+    }
+    return size;
+}
+
+static int frame_parse(JFramer *framer, const U8 *frame, U32 len)
+{
+    JParser *parser = (JParser *)framer->userData;
+    if (JParser_parse(parser, frame, len) <= 0 || JParser_getStatus(parser) != JParsStat_DoneEOS)
+    {
+        JParser_reset(parser);
+        return -1;
+    }
+    return 0;
+}
+
+static int bench_stream(const char *name, int framing, bool flood)
+{
+    char memberName[16];
+    U8 frameBuf[FRAME_BUF_SIZE];
+    counting_intf_t intf;
+    tracking_alloc_t alloc;
+    JParser parser;
+    JFramer framer;
+    unsigned long iterations = 0;
+    uint64_t start, elapsed;
+    size_t size = make_stream(framing, flood);
+
+    JParserIntf_constructor((JParserIntf *)&intf, counting_intf_service);
+    tracking_alloc_constructor(&alloc);
+    JParser_constructor(&parser, (JParserIntf *)&intf, memberName, sizeof(memberName),
+                        &alloc.super, 0);
+    JParser_setZeroCopy(&parser, TRUE);
+    if (framing)
+        JFramer_constructor(&framer, framing == 2 ? JFramerT_Length : JFramerT_Newline, frameBuf,
+                            sizeof(frameBuf), &parser, frame_parse);
+    start = now_ns();
+    do
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            for (size_t off = 0; off < size; off += CHUNK_SIZE)
+            {
+                size_t n = size - off < CHUNK_SIZE ? size - off : CHUNK_SIZE;
+                int status;
+                memcpy(recv_buf, frame_stream + off, n);
+                /* As TCP_manage: the parser finds the message boundaries */
+                status = framing ? JFramer_feed(&framer, recv_buf, (U32)n) : JParser_parse(&parser, recv_buf, (U32)n);
+                while (!framing && status > 0 && JParser_getStatus(&parser) == JParsStat_Done)
+                    status = JParser_parse(&parser, recv_buf, (U32)n);
+                if (status < 0)
+                {
+                    fprintf(stderr, "%s: parse failed\n", name);
+                    JParser_destructor(&parser);
+                    return -1;
+                }
+            }
+        }
+        iterations += 100;
+        elapsed = now_ns() - start;
+    } while (elapsed < min_runtime_ns);
+    report(name, size, iterations, elapsed, &alloc);
+    JParser_destructor(&parser);
+    return 0;
+}
+
+static int bench_framing(void)
+{
+    return bench_stream("stream commands", 0, false) || bench_stream("ndjson commands", 1, false) ||
+           bench_stream("length commands", 2, false) || bench_stream("stream flood", 0, true) ||
+           bench_stream("ndjson flood", 1, true) || bench_stream("length flood", 2, true);
+}
+
+/* --------------------------------------------------------------------------
+ * Self checks, run before the benchmarks and by ctest (-k)
+ * ------------------------------------------------------------------------*/
+
+#define CHECK_BUF_SIZE 128
+
+typedef struct
+{
+    JParserIntf super;
+    char trace[512];
+    size_t len;
+} trace_intf_t;
+
+/* Record each value as "name:type:value;" */
+static int trace_intf_service(JParserIntf *super, JParserVal *v, int recLevel)
+{
+    trace_intf_t *o = (trace_intf_t *)super;
+    char *ptr = o->trace + o->len;
+    size_t left = sizeof(o->trace) - o->len;
+    int n;
+    (void)recLevel;
+    switch (v->t)
+    {
+        case JParserT_String:
+            n = snprintf(ptr, left, "%s:s:%.*s;", v->memberName, (int)v->len, v->v.s);
+            break;
+        case JParserT_Int:
+            n = snprintf(ptr, left, "%s:d:%d;", v->memberName, (int)v->v.d);
+            break;
+        case JParserT_Long:
+            n = snprintf(ptr, left, "%s:l:%lld;", v->memberName, (long long)v->v.l);
+            break;
+        case JParserT_Double:
+            n = snprintf(ptr, left, "%s:f:%.17g;", v->memberName, v->v.f);
+            break;
+        case JParserT_Boolean:
+            n = snprintf(ptr, left, "%s:b:%d;", v->memberName, v->v.b ? 1 : 0);
+            break;
+        default:
+            n = snprintf(ptr, left, "%s:%c;", v->memberName, v->t == JParserT_Null ? 'n' : (char)v->t);
+    }
+    if (n < 0 || (size_t)n >= left)
+        return -1;
+    o->len += n;
+    return 0;
+}
+
+/* Copy 'data' to the start of 'buf', as recv() would, and parse it.
+   The rest of 'buf' is overwritten so that a stale pointer into a
+   previous chunk shows.
+ */
+static int recv_parse(JParser *parser, U8 *buf, const char *data, size_t size)
+{
+    memset(buf, '#', CHECK_BUF_SIZE);
+    memcpy(buf, data, size);
+    return JParser_parse(parser, buf, (U32)size);
+}
+
+/* Parse 'msg' in two chunks split at every offset, the way TCP_manage
+   receives it: both chunks are read into the same buffer, so a value
+   spanning the split must be copied before the buffer is reused. The
+   split right after an opening '"' or a '-' leaves the lexer with a
+   token started at the very end of the first chunk.
+ */
+static int check_split(const char *msg, bool zeroCopy, AllocatorIntf *alloc)
+{
+    static const char *mode[] = {"copy", "zerocopy"};
+    char memberName[16];
+    char expected[sizeof(((trace_intf_t *)0)->trace)];
+    U8 buf[CHECK_BUF_SIZE];
+    trace_intf_t intf;
+    JParser parser;
+    size_t size = strlen(msg);
+    int status = 0;
+
+    JParserIntf_constructor((JParserIntf *)&intf, trace_intf_service);
+    JParser_constructor(&parser, (JParserIntf *)&intf, memberName, sizeof(memberName), alloc, 0);
+    JParser_setZeroCopy(&parser, zeroCopy);
+    for (size_t split = 0; split < size && status >= 0; split++)
+    {
+        intf.len = 0;
+        status = split ? recv_parse(&parser, buf, msg, split) : 0;
+        if (status == 0)
+            status = recv_parse(&parser, buf, msg + split, size - split);
+        intf.trace[intf.len] = 0;
+        if (status <= 0 || JParser_getStatus(&parser) != JParsStat_DoneEOS)
+        {
+            fprintf(stderr, "split check %s: status %d at split %zu\n", mode[zeroCopy], JParser_getStatus(&parser),
+                    split);
+            status = -1;
+        }
+        else if (!split)
+            strcpy(expected, intf.trace);
+        else if (strcmp(expected, intf.trace))
+        {
+            fprintf(stderr, "split check %s: split %zu\n  %s\n  %s\n", mode[zeroCopy], split, expected,
+                    intf.trace);
+            status = -1;
+        }
+    }
+    JParser_destructor(&parser);
+    return status < 0 ? -1 : 0;
+}
+
+/* Returns 'ret' for the value of member "r" */
+typedef struct
+{
+    JParserIntf super;
+    int ret;
+} return_intf_t;
+
+static int return_intf_service(JParserIntf *super, JParserVal *v, int recLevel)
+{
+    (void)recLevel;
+    return strcmp(v->memberName, "r") ? 0 : ((return_intf_t *)super)->ret;
+}
+
+/* JPARSER_SKIP is only valid for an object or array; other non zero
+   callback returns stop the parser with JParsStat_IntfErr.
+ */
+static int check_intf_return(void)
+{
+    static const struct
+    {
+        const char *msg;
+        int ret;
+        JParsStat status;
+    } cases[] = {
+        {"{\"r\":{\"a\":1},\"b\":2}", JPARSER_SKIP, JParsStat_DoneEOS},
+        {"{\"r\":[1,2],\"b\":2}", JPARSER_SKIP, JParsStat_DoneEOS},
+        {"{\"r\":1,\"b\":2}", JPARSER_SKIP, JParsStat_IntfErr},
+        {"{\"r\":{},\"b\":2}", 2, JParsStat_IntfErr},
+        {"{\"r\":\"x\",\"b\":2}", -1, JParsStat_IntfErr},
+    };
+    char memberName[16];
+    return_intf_t intf;
+    JParser parser;
+    int status = 0;
+
+    JParserIntf_constructor((JParserIntf *)&intf, return_intf_service);
+    JParser_constructor(&parser, (JParserIntf *)&intf, memberName, sizeof(memberName), AllocatorIntf_getDefault(),
+                        0);
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        intf.ret = cases[i].ret;
+        JParser_parse(&parser, (const U8 *)cases[i].msg, (U32)strlen(cases[i].msg));
+        if (JParser_getStatus(&parser) != cases[i].status)
+        {
+            fprintf(stderr, "callback return check: %s returning %d gives status %d\n", cases[i].msg, cases[i].ret,
+                    JParser_getStatus(&parser));
+            status = -1;
+        }
+        JParser_reset(&parser);
+    }
+    JParser_destructor(&parser);
+    return status;
+}
+
+typedef struct
+{
+    JParserIntf super;
+    const double *expected;
+    int count;
+    int errors;
+} double_intf_t;
+
+static int double_intf_service(JParserIntf *super, JParserVal *v, int recLevel)
+{
+    double_intf_t *o = (double_intf_t *)super;
+    (void)recLevel;
+    if (v->t == JParserT_Double)
+    {
+        if (memcmp(&v->v.f, &o->expected[o->count], sizeof(double)) && o->errors++ < 4)
+            fprintf(stderr, "double check: value %d is %.17g, strtod gives %.17g\n", o->count, v->v.f,
+                    o->expected[o->count]);
+        o->count++;
+    }
+    return 0;
+}
+
+#define CHECK_DOUBLES 4000
+
+static uint32_t check_rand_state = 1;
+
+static uint32_t check_rand(void)
+{
+    /* xorshift32, the same sequence on every run */
+    check_rand_state ^= check_rand_state << 13;
+    check_rand_state ^= check_rand_state >> 17;
+    check_rand_state ^= check_rand_state << 5;
+    return check_rand_state;
+}
+
+/* Parse an array of random decimals in random size chunks, each read
+   into the same buffer, and compare every value bit for bit with
+   strtod.
+ */
+static int check_doubles(bool zeroCopy)
+{
+    static double expected[CHECK_DOUBLES];
+    char memberName[16];
+    char *msg = malloc(CHECK_DOUBLES * 32);
+    U8 buf[CHECK_BUF_SIZE];
+    double_intf_t intf;
+    JParser parser;
+    size_t size = 0;
+    int status = 0;
+
+    if (!msg)
+        return -1;
+    msg[size++] = '[';
+    for (int i = 0; i < CHECK_DOUBLES; i++)
+    {
+        char *start = msg + size;
+        /* d.ddd with 1 to 20 fraction digits and an optional exponent */
+        int digits = 1 + check_rand() % 20;
+        if (check_rand() % 2)
+            msg[size++] = '-';
+        msg[size++] = (char)('0' + check_rand() % 10);
+        msg[size++] = '.';
+        while (digits--)
+            msg[size++] = (char)('0' + check_rand() % 10);
+        if (check_rand() % 2)
+            size += sprintf(msg + size, "e%d", (int)(check_rand() % 620) - 310);
+        msg[size++] = ',';
+        expected[i] = strtod(start, NULL);
+    }
+    msg[size - 1] = ']';
+
+    JParserIntf_constructor((JParserIntf *)&intf, double_intf_service);
+    intf.expected = expected;
+    intf.count = intf.errors = 0;
+    JParser_constructor(&parser, (JParserIntf *)&intf, memberName, sizeof(memberName), AllocatorIntf_getDefault(),
+                        0);
+    JParser_setZeroCopy(&parser, zeroCopy);
+    for (size_t off = 0; off < size && status == 0; )
+    {
+        size_t n = 1 + check_rand() % CHECK_BUF_SIZE;
+        if (n > size - off)
+            n = size - off;
+        status = recv_parse(&parser, buf, msg + off, n);
+        off += n;
+    }
+    if (status <= 0 || intf.count != CHECK_DOUBLES || intf.errors)
+    {
+        fprintf(stderr, "double check %s: status %d, %d values, %d errors\n", zeroCopy ? "zerocopy" : "copy",
+                JParser_getStatus(&parser), intf.count, intf.errors);
+        status = -1;
+    }
+    JParser_destructor(&parser);
+    free(msg);
+    return status < 0 ? -1 : 0;
+}
+
+/* ArenaAllocator on its own, and as the parser allocator of the TCP
+   client: a block with room for one 256 byte token.
+ */
+static int check_arena(const char *msg)
+{
+    U64 block[ArenaAllocator_blockSize(256) / sizeof(U64)];
+    ArenaAllocator arena;
+    AllocatorIntf *a = (AllocatorIntf *)&arena;
+    size_t size = 10;
+    U8 *p1, *p2;
+    int status = 0;
+
+    ArenaAllocator_constructor(&arena, block, sizeof(block));
+    p1 = AllocatorIntf_malloc(a, &size);
+    if (!p1 || size != ArenaAllocator_align(10))
+        status = -1;
+    /* The most recent allocation grows in place */
+    size = 100;
+    if (!status && AllocatorIntf_realloc(a, p1, &size) != p1)
+        status = -1;
+    size = 8;
+    p2 = status ? 0 : AllocatorIntf_malloc(a, &size);
+    /* Freeing an older allocation is a no-op, the most recent one is returned */
+    if (p2)
+    {
+        size_t used = ArenaAllocator_getUsed(&arena);
+        AllocatorIntf_free(a, p1);
+        if (ArenaAllocator_getUsed(&arena) != used)
+            status = -1;
+        AllocatorIntf_free(a, p2);
+        if (ArenaAllocator_getUsed(&arena) != ArenaAllocator_blockSize(100))
+            status = -1;
+    }
+    else
+        status = -1;
+    size = sizeof(block);
+    if (AllocatorIntf_malloc(a, &size))
+        status = -1; /* Exhausted */
+    ArenaAllocator_reset(&arena);
+    size = 256;
+    if (ArenaAllocator_getUsed(&arena) || !AllocatorIntf_malloc(a, &size) ||
+        ArenaAllocator_getPeak(&arena) != sizeof(block))
+    {
+        status = -1;
+    }
+    if (status)
+    {
+        fprintf(stderr, "arena check: allocator\n");
+        return -1;
+    }
+    ArenaAllocator_reset(&arena);
+    return check_split(msg, false, a) || check_split(msg, true, a);
+}
+
+/* Decodes the parts of member "b" as they arrive */
+typedef struct
+{
+    JParserIntf super;
+    B64Decoder decoder;
+    U8 *out;
+    U32 parts;
+    U32 maxPart;
+    bool done;
+} b64_intf_t;
+
+static int b64_intf_service(JParserIntf *super, JParserVal *v, int recLevel)
+{
+    b64_intf_t *o = (b64_intf_t *)super;
+    int len;
+    (void)recLevel;
+    if (strcmp(v->memberName, "b"))
+        return v->more ? -1 : 0;
+    if (v->t != JParserT_String || o->done)
+        return -1;
+    o->parts++;
+    if (v->len > o->maxPart)
+        o->maxPart = v->len;
+    if ((len = B64Decoder_decode(&o->decoder, v->v.s, (int)v->len, o->out)) < 0)
+        return -1;
+    o->out += len;
+    if (!v->more)
+    {
+        if ((len = B64Decoder_end(&o->decoder, o->out)) < 0)
+            return -1;
+        o->out += len;
+        o->done = true;
+    }
+    return 0;
+}
+
+/* A Base64 value much larger than the 256 byte arena of the TCP
+   client, parsed in random size chunks with string chunks enabled and
+   decoded part by part. Every '/' is sent as the escape "\/".
+ */
+static int check_b64_chunks(bool zeroCopy)
+{
+    static U8 data[B64_DATA_SIZE], decoded[B64_DATA_SIZE];
+    static char text[B64_DATA_SIZE * 3], msg[B64_DATA_SIZE * 3];
+    U64 block[ArenaAllocator_blockSize(256) / sizeof(U64)];
+    ArenaAllocator arena;
+    char memberName[16];
+    U8 buf[CHECK_BUF_SIZE];
+    b64_intf_t intf;
+    JParser parser;
+    BufPrint out;
+    size_t size, off, n;
+    int status = 0;
+
+    for (int i = 0; i < B64_DATA_SIZE; i++)
+        data[i] = (U8)(check_rand() >> 7);
+    BufPrint_constructor2(&out, text, sizeof(text), 0, NULL);
+    BufPrint_b64Encode(&out, data, B64_DATA_SIZE);
+    size = (size_t)sprintf(msg, "{\"a\":1,\"b\":\"");
+    for (int i = 0; i < out.cursor; i++)
+    {
+        if (text[i] == '/')
+            msg[size++] = '\\';
+        msg[size++] = text[i];
+    }
+    size += (size_t)sprintf(msg + size, "\",\"c\":[\"x\"]}");
+
+    ArenaAllocator_constructor(&arena, block, sizeof(block));
+    JParserIntf_constructor((JParserIntf *)&intf, b64_intf_service);
+    B64Decoder_constructor(&intf.decoder);
+    intf.out = decoded;
+    intf.parts = intf.maxPart = 0;
+    intf.done = false;
+    JParser_constructor(&parser, (JParserIntf *)&intf, memberName, sizeof(memberName),
+                        (AllocatorIntf *)&arena, 0);
+    JParser_setZeroCopy(&parser, zeroCopy);
+    JParser_setStringChunks(&parser, true);
+    for (off = 0; off < size && status == 0; off += n)
+    {
+        n = 1 + check_rand() % CHECK_BUF_SIZE;
+        if (n > size - off)
+            n = size - off;
+        status = recv_parse(&parser, buf, msg + off, n);
+    }
+    if (status <= 0 || JParser_getStatus(&parser) != JParsStat_DoneEOS || !intf.done ||
+        intf.out != decoded + B64_DATA_SIZE || memcmp(decoded, data, B64_DATA_SIZE) ||
+        intf.parts < B64_DATA_SIZE / 256 || intf.maxPart > 256)
+    {
+        fprintf(stderr, "b64 chunk check %s: status %d, %u parts\n", zeroCopy ? "zerocopy" : "copy",
+                JParser_getStatus(&parser), (unsigned)intf.parts);
+        status = -1;
+    }
+    JParser_destructor(&parser);
+    return status < 0 ? -1 : 0;
+}
+
+static int run_checks(void)
+{
+    static const char msg[] = "{\"s\":\"ab\",\"e\":\"\",\"q\":\"x\\\"y\",\"i\":-12,\"n\":-3.25,"
+                              "\"a\":[\"c\",-7,-1e3,-9007199254740993],\"t\":true,\"z\":null}";
+    AllocatorIntf *alloc = AllocatorIntf_getDefault();
+    return check_split(msg, false, alloc) || check_split(msg, true, alloc) || check_doubles(false) ||
+           check_doubles(true) || check_intf_return() || check_arena(msg) || check_b64_chunks(false) ||
+           check_b64_chunks(true);
+}
+
+int main(int ac, char *as[])
+{
+    bool checks_only = false;
+    make_corpus();
+    for (int i = 1; i < ac; i++)
+    {
+        if (!strcmp(as[i], "-c"))
+            csv_output = true;
+        else if (!strcmp(as[i], "-k"))
+            checks_only = true;
+        else if (!strcmp(as[i], "-b") && i + 1 < ac)
+        {
+            if (load_baseline(as[++i]))
+                return EXIT_FAILURE;
+        }
+        else if (!strcmp(as[i], "-f") && i + 1 < ac)
+        {
+            if (load_file(as[++i]))
+                return EXIT_FAILURE;
+        }
+        else if (!strcmp(as[i], "-t") && i + 1 < ac)
+            min_runtime_ns = strtoull(as[++i], NULL, 10) * 1000000ULL;
+        else
+        {
+            fprintf(stderr,
+                    "Usage: %s [-c] [-k] [-b baseline.csv] [-f payload.json]... [-t ms]\n"
+                    "  -c  CSV output, suitable as a baseline\n"
+                    "  -k  Run the self checks only\n"
+                    "  -b  Compare time per message with a saved baseline\n"
+                    "  -f  Add a payload file to the parser corpus\n"
+                    "  -t  Minimum run time per benchmark in milliseconds (default 200)\n",
+                    as[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (run_checks())
+        return EXIT_FAILURE;
+    if (checks_only)
+        return EXIT_SUCCESS;
+    print_header();
+    if (bench_parser() || bench_filter() || bench_dom() || bench_decoder() || bench_encoder() || bench_cbor() ||
+        bench_b64() || bench_framing())
+        return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}